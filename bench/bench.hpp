@@ -0,0 +1,95 @@
+/**
+ * the timing helpers shared by the benchmarks in this directory
+ *
+ * each benchmark is one program that includes the headers from the parent
+ *   directory and prints a table, e.g.
+ *     g++ -std=c++14 -O2 -DNDEBUG -I.. map_alloc_bench.cpp && ./a.out
+ *   the multi-threaded ones also need -pthread. The sizes can be changed on
+ *   the command line; each file says how.
+ *
+ * a time is the best of a few runs, so a busy machine mostly makes the
+ *   numbers noisier, not slower. Compare rows of one run with each other
+ *   rather than with another machine.
+ */
+#ifndef SJTU_BENCH_BENCH_HPP
+#define SJTU_BENCH_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <unistd.h>
+
+namespace bench {
+
+// seconds since an arbitrary point.
+inline double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * the shortest of runs timings of f(), in seconds; setup() runs before each
+ *   one, untimed.
+ */
+template<class Setup, class F>
+double best_of(int runs, Setup setup, F f)
+{
+	double best = 1e30;
+	for (int i = 0; i < runs; ++i)
+	{
+		setup();
+		double t = now();
+		f();
+		best = std::min(best, now() - t);
+	}
+	return best;
+}
+template<class F>
+double best_of(int runs, F f)
+{
+	return best_of(runs, []() {}, f);
+}
+
+// a result the compiler has to compute, since it may be read back.
+inline void keep(size_t x)
+{
+	static volatile size_t sink;
+	sink = sink + x;
+}
+
+// 0 .. n - 1 in random order.
+inline std::vector<int> shuffled(int n, unsigned seed)
+{
+	std::vector<int> v(n);
+	for (int i = 0; i < n; ++i)
+		v[i] = i;
+	std::mt19937 rng(seed);
+	std::shuffle(v.begin(), v.end(), rng);
+	return v;
+}
+
+// the resident set of this process in bytes, 0 where /proc is not there.
+inline size_t resident_bytes()
+{
+	std::FILE *f = std::fopen("/proc/self/statm", "r");
+	if (f == NULL)
+		return 0;
+	long pages = 0, resident = 0;
+	int got = std::fscanf(f, "%ld %ld", &pages, &resident);
+	std::fclose(f);
+	return got == 2 ? static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE)) : 0;
+}
+
+// argv[i] as a number, or fallback when it is not given.
+inline long arg(int argc, char **argv, int i, long fallback)
+{
+	return argc > i ? std::atol(argv[i]) : fallback;
+}
+
+}
+
+#endif
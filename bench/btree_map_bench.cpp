@@ -0,0 +1,92 @@
+/**
+ * btree_map against the red-black map and std::map, for uint64_t to
+ *   uint64_t with n random keys:
+ *   - insert: building the map in random order;
+ *   - lookup: finding random keys, half of them missing;
+ *   - scan: summing every value in order;
+ *   - erase: erasing every key in another random order.
+ *   also the growth of the resident set while the map is built. Each map
+ *   runs in a child process of its own, so that none finds pages another
+ *   freed.
+ *
+ * usage: btree_map_bench [n = 4000000]
+ */
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+#include <sys/wait.h>
+#include "bench.hpp"
+#include "../btree_map.hpp"
+#include "../map.hpp"
+
+template<class Map>
+static void run(const char *name, const std::vector<uint64_t> &keys, const std::vector<uint64_t> &probes,
+	const std::vector<uint64_t> &erase_order)
+{
+	std::fflush(stdout);
+	pid_t child = fork();
+	if (child != 0)
+	{
+		int status = 0;
+		waitpid(child, &status, 0);
+		return;
+	}
+	double n = static_cast<double>(keys.size());
+	Map m;
+	size_t before = bench::resident_bytes();
+	double t = bench::now();
+	for (size_t i = 0; i < keys.size(); ++i)
+		m.insert(typename Map::value_type(keys[i], i));
+	double t_insert = bench::now() - t;
+	size_t grown = bench::resident_bytes() - before;
+
+	const Map &c = m;
+	t = bench::now();
+	size_t hits = 0;
+	for (size_t i = 0; i < probes.size(); ++i)
+		hits += c.find(probes[i]) != c.cend();
+	double t_lookup = bench::now() - t;
+	bench::keep(hits);
+
+	t = bench::now();
+	uint64_t sum = 0;
+	for (typename Map::const_iterator it = c.cbegin(); it != c.cend(); ++it)
+		sum += it->second;
+	double t_scan = bench::now() - t;
+	bench::keep(static_cast<size_t>(sum));
+
+	t = bench::now();
+	for (size_t i = 0; i < erase_order.size(); ++i)
+		m.erase(erase_order[i]);
+	double t_erase = bench::now() - t;
+	bench::keep(m.size());
+
+	std::printf("%-10s %10.1f %10.1f %10.2f %10.1f %14.1f\n", name, t_insert * 1e9 / n, t_lookup * 1e9 / probes.size(),
+		t_scan * 1e9 / n, t_erase * 1e9 / n, grown / n);
+	std::fflush(stdout);
+	_exit(0);
+}
+
+int main(int argc, char **argv)
+{
+	long n = bench::arg(argc, argv, 1, 4000000);
+	std::mt19937_64 rng(21);
+	std::vector<uint64_t> keys(n);
+	for (long i = 0; i < n; ++i)
+		keys[i] = rng() << 1; // even, so odd probes miss
+	std::vector<uint64_t> probes(n);
+	for (long i = 0; i < n; ++i)
+		probes[i] = keys[rng() % n] | (rng() & 1);
+	std::vector<uint64_t> erase_order(keys);
+	std::shuffle(erase_order.begin(), erase_order.end(), rng);
+
+	typedef sjtu::btree_map<uint64_t, uint64_t> btree_type;
+	std::printf("n = %ld, btree_map holds %zu values per node; ns per element\n", n, btree_type::max_values);
+	std::printf("%-10s %10s %10s %10s %10s %14s\n", "", "insert", "lookup", "scan", "erase", "bytes/element");
+	run<btree_type>("btree_map", keys, probes, erase_order);
+	run<sjtu::map<uint64_t, uint64_t> >("map", keys, probes, erase_order);
+	run<std::map<uint64_t, uint64_t> >("std::map", keys, probes, erase_order);
+	return 0;
+}
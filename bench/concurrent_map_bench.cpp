@@ -0,0 +1,128 @@
+/**
+ * a read-mostly mix on 1 to 64 threads: 95% lookups, 5% writes (half
+ *   insert_or_assign, half erase) of random keys in [0, 2n), on a map
+ *   preloaded with n keys. The same total number of operations is split
+ *   between the threads. Compares
+ *   - concurrent_map: readers take no lock;
+ *   - map behind one std::mutex;
+ *   - map behind a std::shared_timed_mutex, readers shared.
+ *   printed as millions of operations per second, all threads together.
+ *   With fewer cores than threads the rows past the core count measure
+ *   oversubscription, not scaling.
+ *
+ * usage: concurrent_map_bench [n = 100000] [ops = 2000000] [max threads = 64]
+ *   build with -pthread.
+ */
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include "bench.hpp"
+#include "../concurrent_map.hpp"
+#include "../map.hpp"
+
+struct lock_free_reads
+{
+	sjtu::concurrent_map<int, int> m;
+	bool find(int k)
+	{
+		int v;
+		return m.find(k, v);
+	}
+	void assign(int k, int v)
+	{
+		m.insert_or_assign(k, v);
+	}
+	void erase(int k)
+	{
+		m.erase(k);
+	}
+};
+
+struct one_mutex
+{
+	sjtu::map<int, int> m;
+	std::mutex lock;
+	bool find(int k)
+	{
+		std::lock_guard<std::mutex> g(lock);
+		return m.find(k) != m.end();
+	}
+	void assign(int k, int v)
+	{
+		std::lock_guard<std::mutex> g(lock);
+		m.insert_or_assign(k, v);
+	}
+	void erase(int k)
+	{
+		std::lock_guard<std::mutex> g(lock);
+		m.erase(k);
+	}
+};
+
+struct shared_mutex
+{
+	sjtu::map<int, int> m;
+	std::shared_timed_mutex lock;
+	bool find(int k)
+	{
+		std::shared_lock<std::shared_timed_mutex> g(lock);
+		return m.find(k) != m.end();
+	}
+	void assign(int k, int v)
+	{
+		std::lock_guard<std::shared_timed_mutex> g(lock);
+		m.insert_or_assign(k, v);
+	}
+	void erase(int k)
+	{
+		std::lock_guard<std::shared_timed_mutex> g(lock);
+		m.erase(k);
+	}
+};
+
+// millions of operations per second.
+template<class Map>
+static double run(int n, long ops, int threads)
+{
+	Map m;
+	for (int i = 0; i < n; ++i)
+		m.assign(2 * i, i);
+	std::vector<std::thread> pool;
+	double t = bench::now();
+	for (int id = 0; id < threads; ++id)
+		pool.push_back(std::thread([&m, n, ops, threads, id]() {
+			std::mt19937 rng(id);
+			size_t hits = 0;
+			for (long i = id; i < ops; i += threads)
+			{
+				int k = static_cast<int>(rng() % (2 * static_cast<unsigned>(n)));
+				unsigned r = rng() % 40;
+				if (r == 0)
+					m.assign(k, static_cast<int>(i));
+				else if (r == 1)
+					m.erase(k);
+				else
+					hits += m.find(k);
+			}
+			bench::keep(hits);
+		}));
+	for (size_t i = 0; i < pool.size(); ++i)
+		pool[i].join();
+	return ops / (bench::now() - t) / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 100000));
+	long ops = bench::arg(argc, argv, 2, 2000000);
+	int max_threads = static_cast<int>(bench::arg(argc, argv, 3, 64));
+	std::printf("n = %d, %ld operations, 95%% reads, %u hardware threads, Mops/s\n", n, ops, std::thread::hardware_concurrency());
+	std::printf("%-8s %16s %16s %16s\n", "threads", "concurrent_map", "map + mutex", "map + shared");
+	for (int threads = 1; threads <= max_threads; threads *= 2)
+		std::printf("%-8d %16.2f %16.2f %16.2f\n", threads,
+			run<lock_free_reads>(n, ops, threads), run<one_mutex>(n, ops, threads), run<shared_mutex>(n, ops, threads));
+	return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * where flat_map and map cross over, for map<int, int> of n from 8 to 2M:
+ *   - lookup: find of random keys, half of them missing;
+ *   - insert: building the map by inserts in random order, so flat_map
+ *     moves half its array each time (stopped past 64K, where that takes
+ *     minutes), and by one insert_batch;
+ *   - scan: summing every value in order.
+ *   small maps are built and searched many times over, so every row does
+ *   about the same work.
+ *
+ * usage: flat_map_bench [largest n = 2097152] [runs = 3]
+ */
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "bench.hpp"
+#include "../flat_map.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<int, int> map_type;
+typedef sjtu::flat_map<int, int> flat_type;
+
+// ns per insert, building the map copies times.
+template<class Map>
+static double build_time(const std::vector<int> &keys, long copies, int runs)
+{
+	double t = bench::best_of(runs, [&]() {
+		for (long c = 0; c < copies; ++c)
+		{
+			Map m;
+			for (size_t i = 0; i < keys.size(); ++i)
+				m.insert(typename Map::value_type(keys[i], static_cast<int>(i)));
+			bench::keep(m.size());
+		}
+	});
+	return t * 1e9 / (copies * keys.size());
+}
+
+// ns per lookup.
+template<class Map>
+static double lookup_time(const Map &m, const std::vector<int> &probes, int runs)
+{
+	double t = bench::best_of(runs, [&]() {
+		size_t hits = 0;
+		for (size_t i = 0; i < probes.size(); ++i)
+			hits += m.find(probes[i]) != m.cend();
+		bench::keep(hits);
+	});
+	return t * 1e9 / probes.size();
+}
+
+// ns per element scanned.
+template<class Map>
+static double scan_time(const Map &m, long rounds, int runs)
+{
+	double t = bench::best_of(runs, [&]() {
+		size_t sum = 0;
+		for (long r = 0; r < rounds; ++r)
+			for (typename Map::const_iterator it = m.cbegin(); it != m.cend(); ++it)
+				sum += it->second;
+		bench::keep(sum);
+	});
+	return t * 1e9 / (rounds * m.size());
+}
+
+int main(int argc, char **argv)
+{
+	long largest = bench::arg(argc, argv, 1, 1L << 21);
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 3));
+	std::printf("ns per lookup, insert and scanned element, flat_map / map\n");
+	std::printf("%-9s %17s %17s %17s %17s\n", "n", "lookup", "insert", "insert_batch", "scan");
+	for (long n = 8; n <= largest; n *= 4)
+	{
+		std::vector<int> keys = bench::shuffled(static_cast<int>(n), 24);
+		for (long i = 0; i < n; ++i)
+			keys[i] *= 2;
+		long copies = std::max(1L, (1L << 20) / n);
+		std::mt19937 rng(static_cast<unsigned>(n));
+		std::vector<int> probes(1000000);
+		for (size_t i = 0; i < probes.size(); ++i)
+			probes[i] = static_cast<int>(rng() % (2 * static_cast<unsigned>(n)));
+
+		map_type m;
+		for (long i = 0; i < n; ++i)
+			m.insert(map_type::value_type(keys[i], static_cast<int>(i)));
+		flat_type f(m);
+
+		double flat_insert = n <= 65536 ? build_time<flat_type>(keys, copies, runs) : 0;
+		std::vector<sjtu::pair<int, int> > batch;
+		for (long i = 0; i < n; ++i)
+			batch.push_back(sjtu::pair<int, int>(keys[i], static_cast<int>(i)));
+		double flat_batch = bench::best_of(runs, [&]() {
+			for (long c = 0; c < copies; ++c)
+			{
+				flat_type g;
+				bench::keep(g.insert_batch(batch.begin(), batch.end()));
+			}
+		}) * 1e9 / (copies * n);
+		double map_batch = bench::best_of(runs, [&]() {
+			for (long c = 0; c < copies; ++c)
+			{
+				map_type g;
+				bench::keep(g.insert_batch(batch.begin(), batch.end()));
+			}
+		}) * 1e9 / (copies * n);
+
+		char insert[32];
+		if (n <= 65536)
+			std::snprintf(insert, sizeof(insert), "%7.1f / %7.1f", flat_insert, build_time<map_type>(keys, copies, runs));
+		else
+			std::snprintf(insert, sizeof(insert), "      - / %7.1f", build_time<map_type>(keys, copies, runs));
+		std::printf("%-9ld %7.1f / %7.1f %17s %7.1f / %7.1f %7.2f / %7.2f\n", n,
+			lookup_time(f, probes, runs), lookup_time(m, probes, runs), insert, flat_batch, map_batch,
+			scan_time(f, copies, runs), scan_time(m, copies, runs));
+		std::fflush(stdout);
+	}
+	return 0;
+}
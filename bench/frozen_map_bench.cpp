@@ -0,0 +1,97 @@
+/**
+ * lookups of random keys (half of them missing) in a map<int, int> and in
+ *   its freeze(), for working sets sized for L2, for the last level cache
+ *   and for DRAM. The sizes are counted in the live tree's heap, about 48
+ *   bytes a node, and are given as cache sizes so that they can be set for
+ *   the machine (lscpu):
+ *   - map::find;
+ *   - frozen_map::find and lower_bound;
+ *   - std::lower_bound on a sorted vector of the keys, the layout freeze()
+ *     improves on.
+ *   also the time freeze() takes.
+ *
+ * usage: frozen_map_bench [L2 KiB = 2048] [LLC MiB = 32] [runs = 3]
+ *   the DRAM row is 4 times the LLC.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "bench.hpp"
+#include "../frozen_map.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<int, int> map_type;
+typedef sjtu::frozen_map<int, int> frozen_type;
+
+static void row(const char *name, long n, int runs)
+{
+	std::vector<int> keys = bench::shuffled(static_cast<int>(n), 23);
+	map_type m;
+	for (long i = 0; i < n; ++i)
+		m.insert(map_type::value_type(2 * keys[i], keys[i]));
+	frozen_type f = m.freeze();
+	double t_freeze = bench::best_of(runs, [&]() {
+		frozen_type g = m.freeze();
+		bench::keep(g.size());
+	});
+	std::vector<int> sorted;
+	sorted.reserve(n);
+	for (map_type::const_iterator it = m.cbegin(); it != m.cend(); ++it)
+		sorted.push_back(it->first);
+
+	long lookups = 1000000;
+	std::mt19937 rng(static_cast<unsigned>(n));
+	std::vector<int> probes(lookups);
+	for (long i = 0; i < lookups; ++i)
+		probes[i] = static_cast<int>(rng() % (2 * static_cast<unsigned>(n)));
+	const map_type &c = m;
+	double t_map = bench::best_of(runs, [&]() {
+		size_t hits = 0;
+		for (long i = 0; i < lookups; ++i)
+			hits += c.find(probes[i]) != c.cend();
+		bench::keep(hits);
+	});
+	double t_find = bench::best_of(runs, [&]() {
+		size_t hits = 0;
+		for (long i = 0; i < lookups; ++i)
+			hits += f.find(probes[i]) != f.cend();
+		bench::keep(hits);
+	});
+	double t_lower = bench::best_of(runs, [&]() {
+		size_t sum = 0;
+		for (long i = 0; i < lookups; ++i)
+		{
+			frozen_type::const_iterator it = f.lower_bound(probes[i]);
+			sum += it != f.cend() ? static_cast<size_t>(it->second) : 0;
+		}
+		bench::keep(sum);
+	});
+	double t_vector = bench::best_of(runs, [&]() {
+		size_t hits = 0;
+		for (long i = 0; i < lookups; ++i)
+		{
+			std::vector<int>::const_iterator it = std::lower_bound(sorted.begin(), sorted.end(), probes[i]);
+			hits += it != sorted.end() && *it == probes[i];
+		}
+		bench::keep(hits);
+	});
+	std::printf("%-6s %10ld %10.1f %12.1f %14.1f %16.1f %12.1f\n", name, n, t_map * 1e9 / lookups, t_find * 1e9 / lookups,
+		t_lower * 1e9 / lookups, t_vector * 1e9 / lookups, t_freeze * 1e9 / n);
+	std::fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	long l2 = bench::arg(argc, argv, 1, 2048) << 10;
+	long llc = bench::arg(argc, argv, 2, 32) << 20;
+	int runs = static_cast<int>(bench::arg(argc, argv, 3, 3));
+	const long node_bytes = 48;
+	std::printf("ns per lookup; freeze() in ns per element\n");
+	std::printf("%-6s %10s %10s %12s %14s %16s %12s\n", "", "n", "map find", "frozen find", "frozen lower", "vector lower", "freeze()");
+	// half of each cache, so that the set stays in it alongside the rest.
+	row("L2", l2 / 2 / node_bytes, runs);
+	row("LLC", llc / 2 / node_bytes, runs);
+	row("DRAM", 4 * llc / node_bytes, runs);
+	return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * lookup throughput by key type (int32_t, uint32_t, float, int64_t,
+ *   double), with std::less, which key_rank vectorizes, against a
+ *   comparator of its own type that does the same comparison, which it
+ *   cannot:
+ *   - key_rank::count_less on packed arrays of 16 and 64 keys, as in a
+ *     node;
+ *   - btree_map::count of random keys in a map of 10000, which stays in
+ *     cache, and in a map of n, which does not. Only 4 byte keys are kept
+ *     packed in the nodes, so the 8 byte rows are expected level.
+ *
+ * usage: key_rank_bench [n = 1000000] [runs = 3]
+ */
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "bench.hpp"
+#include "../btree_map.hpp"
+#include "../key_rank.hpp"
+
+// the comparison of std::less, in a type key_rank does not know.
+template<class Key>
+struct plain_less
+{
+	bool operator()(const Key &a, const Key &b) const
+	{
+		return a < b;
+	}
+};
+
+// ns per count_less of width keys.
+template<class Key, class Compare>
+static double count_time(int width, int runs)
+{
+	std::mt19937 rng(22);
+	std::vector<Key> keys(width);
+	for (int i = 0; i < width; ++i)
+		keys[i] = static_cast<Key>(rng() % 100000);
+	std::vector<Key> probes(4096);
+	for (size_t i = 0; i < probes.size(); ++i)
+		probes[i] = static_cast<Key>(rng() % 100000);
+	const char *first = reinterpret_cast<const char*>(keys.data());
+	const int rounds = 200;
+	double t = bench::best_of(runs, [&]() {
+		size_t r = 0;
+		for (int k = 0; k < rounds; ++k)
+			for (size_t i = 0; i < probes.size(); ++i)
+				r += sjtu::key_rank<Key, Compare>::count_less(first, width, probes[i], Compare());
+		bench::keep(r);
+	});
+	return t * 1e9 / (rounds * probes.size());
+}
+
+// ns per btree_map::count.
+template<class Key, class Compare>
+static double lookup_time(int n, int runs)
+{
+	sjtu::btree_map<Key, int, Compare> m;
+	std::vector<int> keys = bench::shuffled(n, 22);
+	for (int i = 0; i < n; ++i)
+		m.insert(typename sjtu::btree_map<Key, int, Compare>::value_type(static_cast<Key>(2 * keys[i]), i));
+	std::mt19937 rng(23);
+	std::vector<Key> probes(1000000);
+	for (size_t i = 0; i < probes.size(); ++i)
+		probes[i] = static_cast<Key>(rng() % (2 * static_cast<unsigned>(n)));
+	double t = bench::best_of(runs, [&]() {
+		size_t hits = 0;
+		for (size_t i = 0; i < probes.size(); ++i)
+			hits += m.count(probes[i]);
+		bench::keep(hits);
+	});
+	return t * 1e9 / probes.size();
+}
+
+template<class Key>
+static void row(const char *name, int n, int runs)
+{
+	std::printf("%-10s %9.2f %9.2f %9.2f %9.2f %9.1f %9.1f %9.1f %9.1f\n", name,
+		count_time<Key, std::less<Key> >(16, runs), count_time<Key, plain_less<Key> >(16, runs),
+		count_time<Key, std::less<Key> >(64, runs), count_time<Key, plain_less<Key> >(64, runs),
+		lookup_time<Key, std::less<Key> >(10000, runs), lookup_time<Key, plain_less<Key> >(10000, runs),
+		lookup_time<Key, std::less<Key> >(n, runs), lookup_time<Key, plain_less<Key> >(n, runs));
+}
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 1000000));
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 3));
+	std::printf("ns per count_less of 16 and 64 keys, and per btree_map::count in a map of 10000 and of %d\n", n);
+	std::printf("%-10s %19s %19s %19s %19s\n", "", "count_less 16", "count_less 64", "count, 10000", "count, n");
+	std::printf("%-10s %9s %9s %9s %9s %9s %9s %9s %9s\n", "key", "less", "scalar", "less", "scalar", "less", "scalar", "less", "scalar");
+	row<int32_t>("int32_t", n, runs);
+	row<uint32_t>("uint32_t", n, runs);
+	row<float>("float", n, runs);
+	row<int64_t>("int64_t", n, runs);
+	row<double>("double", n, runs);
+	return 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * the sum of the values with keys in [lo, hi), for ranges of 1 to n keys
+ *   at random places in a map of n keys inserted in random order:
+ *   - aggregate(lo, hi) on a map augmented with a sum monoid, O(log n);
+ *   - for_each_in_range on the same map, O(log n + width);
+ *   - for_each_in_range on a plain map, whose smaller nodes are the
+ *     baseline the summaries have to pay for.
+ *   also times the inserts, which keep the summaries up to date.
+ *
+ * usage: map_aggregate_bench [n = 1000000] [runs = 3]
+ */
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+
+struct sum_monoid
+{
+	typedef long value_type;
+	static long identity()
+	{
+		return 0;
+	}
+	static long lift(const int &, const int &value)
+	{
+		return value;
+	}
+	static long combine(const long &a, const long &b)
+	{
+		return a + b;
+	}
+};
+
+typedef sjtu::map<int, int> plain_map;
+typedef sjtu::map<int, int, std::less<int>, std::allocator<sjtu::pair<const int, int> >, sjtu::monoid_augment<sum_monoid> > sum_map;
+
+template<class Map>
+static double fill(Map &m, const std::vector<int> &keys, int runs)
+{
+	double t = bench::best_of(runs, [&]() { m.clear(); }, [&]() {
+		for (size_t i = 0; i < keys.size(); ++i)
+			m.insert(typename Map::value_type(keys[i], keys[i] % 1000));
+	});
+	return t * 1e9 / keys.size();
+}
+
+template<class Map>
+static double walk(const Map &m, const std::vector<int> &lo, int width, int runs)
+{
+	double t = bench::best_of(runs, [&]() {
+		long sum = 0;
+		for (size_t i = 0; i < lo.size(); ++i)
+			m.for_each_in_range(lo[i], lo[i] + width, [&](const typename Map::value_type &v) { sum += v.second; });
+		bench::keep(static_cast<size_t>(sum));
+	});
+	return t * 1e9 / lo.size();
+}
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 1000000));
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 3));
+	std::vector<int> keys = bench::shuffled(n, 13);
+	plain_map plain;
+	sum_map summed;
+	double t_plain = fill(plain, keys, runs);
+	double t_summed = fill(summed, keys, runs);
+	std::printf("n = %d, node_size() plain %zu, with a sum %zu; ns per insert plain %.1f, with a sum %.1f\n",
+		n, plain_map::node_size(), sum_map::node_size(), t_plain, t_summed);
+	std::printf("ns per range\n%-10s %14s %18s %18s\n", "width", "aggregate", "walk, summed map", "walk, plain map");
+	for (int width = 1; ; width *= 16)
+	{
+		width = std::min(width, n);
+		// fewer ranges as they grow, so that a row takes about the same time.
+		int queries = std::max(4, std::min(200000, 2000000 / width));
+		std::mt19937 rng(width);
+		std::vector<int> lo(queries);
+		for (int i = 0; i < queries; ++i)
+			lo[i] = static_cast<int>(rng() % static_cast<unsigned>(n - width + 1));
+		double t_agg = bench::best_of(runs, [&]() {
+			long sum = 0;
+			for (int i = 0; i < queries; ++i)
+				sum += summed.aggregate(lo[i], lo[i] + width);
+			bench::keep(static_cast<size_t>(sum));
+		}) * 1e9 / queries;
+		std::printf("%-10d %14.1f %18.1f %18.1f\n", width, t_agg, walk(summed, lo, width, runs), walk(plain, lo, width, runs));
+		if (width == n)
+			break;
+	}
+	return 0;
+}
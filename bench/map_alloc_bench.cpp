@@ -0,0 +1,76 @@
+/**
+ * map with the default allocator (one new / delete per node) against
+ *   pool_allocator, with and without reserve(), and std::map:
+ *   - fill: insert n keys in random order into an empty map, then clear it;
+ *   - churn: on a map of n keys, erase a random key and insert a new one, n times.
+ *
+ * usage: map_alloc_bench [n = 1000000] [runs = 5]
+ */
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+#include "../pool_allocator.hpp"
+
+typedef sjtu::map<int, int> plain_map;
+typedef sjtu::map<int, int, std::less<int>, sjtu::pool_allocator<sjtu::pair<const int, int> > > pool_map;
+
+template<class Map, class Value>
+static void fill(Map &m, const std::vector<int> &keys)
+{
+	for (size_t i = 0; i < keys.size(); ++i)
+		m.insert(Value(keys[i], keys[i]));
+}
+
+// erase keys[i] and insert keys[i] + n, for every i: the size stays n.
+template<class Map, class Value>
+static void churn(Map &m, const std::vector<int> &keys)
+{
+	int n = static_cast<int>(keys.size());
+	for (int i = 0; i < n; ++i)
+	{
+		m.erase(keys[i]);
+		m.insert(Value(keys[i] + n, i));
+	}
+}
+
+// prepare(m) runs on the empty map before it is filled, and is timed with the fill.
+template<class Map, class Value, class Prepare>
+static void row(const char *name, const std::vector<int> &keys, int runs, Prepare prepare)
+{
+	size_t n = keys.size();
+	double t_fill = bench::best_of(runs, [&]() {
+		Map m;
+		prepare(m);
+		fill<Map, Value>(m, keys);
+		bench::keep(m.size());
+		m.clear();
+	});
+	double t_churn = 1e30;
+	for (int r = 0; r < runs; ++r)
+	{
+		Map m;
+		fill<Map, Value>(m, keys);
+		double t = bench::now();
+		churn<Map, Value>(m, keys);
+		t_churn = std::min(t_churn, bench::now() - t);
+		bench::keep(m.size());
+	}
+	std::printf("%-28s %12.1f %12.1f\n", name, t_fill * 1e9 / n, t_churn * 1e9 / n);
+}
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 1000000));
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 5));
+	std::vector<int> keys = bench::shuffled(n, 1);
+	std::printf("n = %d, ns per element\n", n);
+	std::printf("%-28s %12s %12s\n", "", "fill+clear", "churn");
+	row<plain_map, plain_map::value_type>("map, std::allocator", keys, runs, [](plain_map &) {});
+	row<pool_map, pool_map::value_type>("map, pool_allocator", keys, runs, [](pool_map &) {});
+	row<pool_map, pool_map::value_type>("map, pool + reserve(n)", keys, runs, [n](pool_map &m) { m.reserve(n); });
+	row<std::map<int, int>, std::pair<const int, int> >("std::map", keys, runs, [](std::map<int, int> &) {});
+	return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * applying a batch of k new random keys to a map of n, then taking it out
+ *   again, for k from 100 up to 2n:
+ *   - insert / erase(key) in a loop;
+ *   - insert_batch / erase_batch, which sort the batch first;
+ *   - insert_batch / erase_batch with sorted_unique, for a batch that
+ *     comes sorted.
+ *   every erase restores the map the next insert starts from.
+ *
+ * usage: map_batch_bench [n = 1000000] [runs = 3]
+ */
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<int, int> map_type;
+typedef sjtu::pair<int, int> entry;
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 1000000));
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 3));
+	std::vector<int> keys = bench::shuffled(n, 20);
+	map_type m;
+	// the map holds the even keys, a batch odd ones.
+	for (int i = 0; i < n; ++i)
+		m.insert(map_type::value_type(2 * keys[i], i));
+	std::printf("n = %d, ns per key, insert / erase\n", n);
+	std::printf("%-10s %20s %20s %20s\n", "k", "loop", "batch", "sorted batch");
+	for (long k = 100; ; k *= 10)
+	{
+		k = std::min(k, 2L * n);
+		std::vector<int> odd = bench::shuffled(static_cast<int>(k), static_cast<unsigned>(k));
+		std::vector<entry> batch;
+		std::vector<int> batch_keys(k);
+		for (long i = 0; i < k; ++i)
+		{
+			batch_keys[i] = 2 * odd[i] + 1;
+			batch.push_back(entry(batch_keys[i], static_cast<int>(i)));
+		}
+		std::vector<int> sorted_keys(batch_keys);
+		std::sort(sorted_keys.begin(), sorted_keys.end());
+		std::vector<entry> sorted_batch;
+		for (long i = 0; i < k; ++i)
+			sorted_batch.push_back(entry(sorted_keys[i], static_cast<int>(i)));
+
+		double t[3][2] = { { 1e30, 1e30 }, { 1e30, 1e30 }, { 1e30, 1e30 } };
+		for (int r = 0; r < runs; ++r)
+		{
+			double s = bench::now();
+			for (long i = 0; i < k; ++i)
+				m.insert(map_type::value_type(batch[i].first, batch[i].second));
+			t[0][0] = std::min(t[0][0], bench::now() - s);
+			s = bench::now();
+			for (long i = 0; i < k; ++i)
+				m.erase(batch_keys[i]);
+			t[0][1] = std::min(t[0][1], bench::now() - s);
+
+			s = bench::now();
+			bench::keep(m.insert_batch(batch.begin(), batch.end()));
+			t[1][0] = std::min(t[1][0], bench::now() - s);
+			s = bench::now();
+			bench::keep(m.erase_batch(batch_keys.begin(), batch_keys.end()));
+			t[1][1] = std::min(t[1][1], bench::now() - s);
+
+			s = bench::now();
+			bench::keep(m.insert_batch(sjtu::sorted_unique, sorted_batch.begin(), sorted_batch.end()));
+			t[2][0] = std::min(t[2][0], bench::now() - s);
+			s = bench::now();
+			bench::keep(m.erase_batch(sjtu::sorted_unique, sorted_keys.begin(), sorted_keys.end()));
+			t[2][1] = std::min(t[2][1], bench::now() - s);
+		}
+		std::printf("%-10ld", k);
+		for (int i = 0; i < 3; ++i)
+			std::printf(" %9.1f / %8.1f", t[i][0] * 1e9 / k, t[i][1] * 1e9 / k);
+		std::printf("\n");
+		bench::keep(m.size());
+		if (k == 2L * n)
+			break;
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * loading n sorted elements, as from a checkpoint: n plain inserts, n
+ *   inserts hinted at end(), the sorted_unique constructor (a balanced
+ *   tree built bottom-up in O(n)) and assign_sorted into a used map.
+ *
+ * usage: map_bulk_build_bench [n = 10000000] [runs = 3]
+ */
+#include <cstdio>
+#include <map>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<int, int> map_type;
+
+int main(int argc, char **argv)
+{
+	long n = bench::arg(argc, argv, 1, 10000000);
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 3));
+	std::vector<sjtu::pair<int, int> > sorted;
+	sorted.reserve(n);
+	for (long i = 0; i < n; ++i)
+		sorted.push_back(sjtu::pair<int, int>(static_cast<int>(2 * i), static_cast<int>(i)));
+
+	double t_insert = bench::best_of(runs, [&]() {
+		map_type m;
+		for (size_t i = 0; i < sorted.size(); ++i)
+			m.insert(map_type::value_type(sorted[i]));
+		bench::keep(m.size());
+	});
+	double t_hint = bench::best_of(runs, [&]() {
+		map_type m;
+		for (size_t i = 0; i < sorted.size(); ++i)
+			m.insert(m.cend(), map_type::value_type(sorted[i]));
+		bench::keep(m.size());
+	});
+	double t_build = bench::best_of(runs, [&]() {
+		map_type m(sjtu::sorted_unique, sorted.begin(), sorted.end());
+		bench::keep(m.size());
+	});
+	map_type used;
+	for (int i = 0; i < 1000; ++i)
+		used.insert(map_type::value_type(-i, i));
+	double t_assign = bench::best_of(runs, [&]() {
+		used.assign_sorted(sorted.begin(), sorted.end());
+		bench::keep(used.size());
+	});
+	double t_std = bench::best_of(runs, [&]() {
+		std::map<int, int> m;
+		for (size_t i = 0; i < sorted.size(); ++i)
+			m.insert(std::pair<const int, int>(sorted[i].first, sorted[i].second));
+		bench::keep(m.size());
+	});
+	// every row but assign_sorted also destroys the map it built; assign_sorted clears the one it loaded last time.
+	std::printf("n = %ld, loading sorted elements (ms, ns per element)\n", n);
+	std::printf("%-32s %10.1f %8.1f\n", "insert(value)", t_insert * 1e3, t_insert * 1e9 / n);
+	std::printf("%-32s %10.1f %8.1f\n", "insert(cend(), value)", t_hint * 1e3, t_hint * 1e9 / n);
+	std::printf("%-32s %10.1f %8.1f\n", "map(sorted_unique, first, last)", t_build * 1e3, t_build * 1e9 / n);
+	std::printf("%-32s %10.1f %8.1f\n", "assign_sorted(first, last)", t_assign * 1e3, t_assign * 1e9 / n);
+	std::printf("%-32s %10.1f %8.1f\n", "std::map insert(value)", t_std * 1e3, t_std * 1e9 / n);
+	return 0;
+}
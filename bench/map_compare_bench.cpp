@@ -0,0 +1,102 @@
+/**
+ * lookups with an expensive comparator: string keys of 64 bytes that
+ *   differ only in their last 8, compared by a stateful comparator that
+ *   counts its calls. Prints comparisons and time per find and per count,
+ *   against log2(n) and std::map with the same comparator.
+ *   the search before this comparator was stored compared up to three
+ *   times per level (less, greater, equal); now there is one comparison per
+ *   level and one at the end.
+ *
+ * usage: map_compare_bench [n = 1000000] [runs = 3]
+ */
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+
+struct counting_less
+{
+	size_t *calls;
+	explicit counting_less(size_t *c) : calls(c) {}
+	bool operator()(const std::string &a, const std::string &b) const
+	{
+		++*calls;
+		return a < b;
+	}
+};
+
+typedef sjtu::map<std::string, int, counting_less> map_type;
+typedef std::map<std::string, int, counting_less> std_map_type;
+
+static std::string key(int i)
+{
+	char tail[16];
+	std::snprintf(tail, sizeof(tail), "%08d", i);
+	return std::string(56, 'k') + tail;
+}
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 1000000));
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 3));
+	std::vector<int> order = bench::shuffled(n, 9);
+	std::vector<std::string> keys(n);
+	for (int i = 0; i < n; ++i)
+		keys[i] = key(order[i]);
+	size_t calls = 0, std_calls = 0;
+	map_type m{counting_less(&calls)};
+	std_map_type s{counting_less(&std_calls)};
+	for (int i = 0; i < n; ++i)
+	{
+		m.insert(map_type::value_type(keys[i], i));
+		s.emplace(keys[i], i);
+	}
+	// half hits, half misses (a key past the 8 digits sorts between two stored ones).
+	int lookups = std::min(n, 1000000);
+	std::vector<std::string> probes(lookups);
+	for (int i = 0; i < lookups; ++i)
+		probes[i] = i % 2 == 0 ? keys[i] : keys[i] + "x";
+
+	double t_find = bench::best_of(runs, [&]() {
+		size_t hits = 0;
+		for (int i = 0; i < lookups; ++i)
+			hits += m.find(probes[i]) != m.end();
+		bench::keep(hits);
+	});
+	calls = 0;
+	for (int i = 0; i < lookups; ++i)
+		bench::keep(m.find(probes[i]) != m.end());
+	double c_find = static_cast<double>(calls) / lookups;
+	double t_count = bench::best_of(runs, [&]() {
+		size_t hits = 0;
+		for (int i = 0; i < lookups; ++i)
+			hits += m.count(probes[i]);
+		bench::keep(hits);
+	});
+	calls = 0;
+	for (int i = 0; i < lookups; ++i)
+		bench::keep(m.count(probes[i]));
+	double c_count = static_cast<double>(calls) / lookups;
+	double t_std = bench::best_of(runs, [&]() {
+		size_t hits = 0;
+		for (int i = 0; i < lookups; ++i)
+			hits += s.find(probes[i]) != s.end();
+		bench::keep(hits);
+	});
+	std_calls = 0;
+	for (int i = 0; i < lookups; ++i)
+		bench::keep(s.find(probes[i]) != s.end());
+	double c_std = static_cast<double>(std_calls) / lookups;
+
+	std::printf("n = %d, %d lookups, log2(n) = %.1f\n", n, lookups, std::log2(static_cast<double>(n)));
+	std::printf("%-16s %16s %12s\n", "", "compares/lookup", "ns/lookup");
+	std::printf("%-16s %16.2f %12.1f\n", "find", c_find, t_find * 1e9 / lookups);
+	std::printf("%-16s %16.2f %12.1f\n", "count", c_count, t_count * 1e9 / lookups);
+	std::printf("%-16s %16.2f %12.1f\n", "std::map find", c_std, t_std * 1e9 / lookups);
+	std::printf("sizeof(map<string, int, counting_less>) = %zu, with std::less = %zu\n",
+		sizeof(map_type), sizeof(sjtu::map<std::string, int>));
+	return 0;
+}
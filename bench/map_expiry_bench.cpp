@@ -0,0 +1,81 @@
+/**
+ * TTL expiry: a map of n entries keyed by insertion time, where each tick
+ *   appends k new entries and drops every entry older than the k-th, i.e.
+ *   the prefix [begin(), lower_bound(T)). Only the drop is timed, done as
+ *   - erase(begin(), lower_bound(T)), which cuts large ranges out whole;
+ *   - erase(it) in a loop, using the iterator it returns;
+ *   - erase(begin()->first) in a loop, by key;
+ *   - std::map erase(begin(), lower_bound(T)).
+ *   erase(first, last) first walks the range to count it, and only rebuilds
+ *   the tree when the range holds more than half the map.
+ *
+ * usage: map_expiry_bench [n = 1000000] [ticks = 20]
+ */
+#include <cstdio>
+#include <map>
+#include "bench.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<long, int> map_type;
+
+enum method { range, by_iterator, by_key };
+
+static void drop(map_type &m, long t, method how)
+{
+	if (how == range)
+		m.erase(m.begin(), m.lower_bound(t));
+	else if (how == by_iterator)
+		for (map_type::iterator it = m.begin(); it != m.end() && it->first < t; )
+			it = m.erase(it);
+	else
+		while (!m.empty() && m.begin()->first < t)
+			m.erase(m.begin()->first);
+}
+
+static void drop(std::map<long, int> &m, long t, method)
+{
+	m.erase(m.begin(), m.lower_bound(t));
+}
+
+// ns per dropped entry over ticks ticks of k.
+template<class Map>
+static double run(long n, long k, int ticks, method how)
+{
+	Map m;
+	long next = 0;
+	for (; next < n; ++next)
+		m.emplace_hint(m.end(), next, 0);
+	double spent = 0;
+	for (int i = 0; i < ticks; ++i)
+	{
+		for (long j = 0; j < k; ++j, ++next)
+			m.emplace_hint(m.end(), next, 0);
+		double t = bench::now();
+		drop(m, next - n, how);
+		spent += bench::now() - t;
+	}
+	bench::keep(m.size());
+	return spent * 1e9 / (static_cast<double>(k) * ticks);
+}
+
+int main(int argc, char **argv)
+{
+	long n = bench::arg(argc, argv, 1, 1000000);
+	int ticks = static_cast<int>(bench::arg(argc, argv, 2, 20));
+	std::printf("n = %ld, %d ticks, ns per expired entry\n", n, ticks);
+	std::printf("%-10s %14s %14s %14s %14s\n", "k", "erase(range)", "erase(it)", "erase(key)", "std::map");
+	// the last row is a burst: 2n arrive at once and the prefix dropped is two thirds of the map.
+	const long ks[5] = { 1, 100, 10000, n / 2, 2 * n };
+	for (int i = 0; i < 5; ++i)
+	{
+		long k = std::max(ks[i], 1L);
+		// about the same number of entries expired in every row.
+		int t = static_cast<int>(std::max(1L, std::min<long>(ticks * 10000L / k, ticks)));
+		if (k < 100)
+			t = ticks * 1000;
+		std::printf("%-10ld %14.1f %14.1f %14.1f %14.1f\n", k,
+			run<map_type>(n, k, t, range), run<map_type>(n, k, t, by_iterator),
+			run<map_type>(n, k, t, by_key), run<std::map<long, int> >(n, k, t, range));
+	}
+	return 0;
+}
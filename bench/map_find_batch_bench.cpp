@@ -0,0 +1,87 @@
+/**
+ * lookups of random keys, in batches of 256, in maps of n int pairs from
+ *   one that fits in L2 to one several times the size of the last level
+ *   cache (a node takes 48 bytes of heap):
+ *   - find in a loop;
+ *   - find_batch, which walks the searches in lockstep and prefetches;
+ *   - count_batch;
+ *   - std::map find in a loop.
+ *   half the keys are there, half are not.
+ *
+ * usage: map_find_batch_bench [largest n = 16777216] [lookups = 1000000] [runs = 3]
+ */
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<int, int> map_type;
+
+static const size_t batch = 256;
+
+int main(int argc, char **argv)
+{
+	long largest = bench::arg(argc, argv, 1, 1L << 24);
+	long lookups = bench::arg(argc, argv, 2, 1000000);
+	int runs = static_cast<int>(bench::arg(argc, argv, 3, 3));
+	std::printf("batches of %zu, ns per lookup\n", batch);
+	std::printf("%-10s %10s %12s %12s %12s %10s\n", "n", "find", "find_batch", "count_batch", "std::map", "speedup");
+	for (long n = 1L << 12; n <= largest; n *= 16)
+	{
+		std::vector<int> keys = bench::shuffled(static_cast<int>(n), 19);
+		map_type m;
+		std::map<int, int> s;
+		for (long i = 0; i < n; ++i)
+		{
+			m.insert(map_type::value_type(2 * keys[i], keys[i]));
+			s.emplace(2 * keys[i], keys[i]);
+		}
+		std::mt19937 rng(static_cast<unsigned>(n));
+		std::vector<int> probes(lookups);
+		for (long i = 0; i < lookups; ++i)
+			probes[i] = static_cast<int>(rng() % (2 * static_cast<unsigned>(n)));
+		const map_type &c = m;
+
+		double t_find = bench::best_of(runs, [&]() {
+			size_t hits = 0;
+			for (long i = 0; i < lookups; ++i)
+				hits += c.find(probes[i]) != c.cend();
+			bench::keep(hits);
+		});
+		std::vector<map_type::const_iterator> found(batch);
+		double t_batch = bench::best_of(runs, [&]() {
+			size_t hits = 0;
+			for (long i = 0; i < lookups; i += batch)
+			{
+				long e = std::min<long>(i + batch, lookups);
+				c.find_batch(probes.begin() + i, probes.begin() + e, found.begin());
+				for (long j = 0; j < e - i; ++j)
+					hits += found[j] != c.cend();
+			}
+			bench::keep(hits);
+		});
+		std::vector<size_t> counts(batch);
+		double t_count = bench::best_of(runs, [&]() {
+			size_t hits = 0;
+			for (long i = 0; i < lookups; i += batch)
+			{
+				long e = std::min<long>(i + batch, lookups);
+				c.count_batch(probes.begin() + i, probes.begin() + e, counts.begin());
+				for (long j = 0; j < e - i; ++j)
+					hits += counts[j];
+			}
+			bench::keep(hits);
+		});
+		double t_std = bench::best_of(runs, [&]() {
+			size_t hits = 0;
+			for (long i = 0; i < lookups; ++i)
+				hits += s.find(probes[i]) != s.cend();
+			bench::keep(hits);
+		});
+		std::printf("%-10ld %10.1f %12.1f %12.1f %12.1f %9.2fx\n", n, t_find * 1e9 / lookups, t_batch * 1e9 / lookups,
+			t_count * 1e9 / lookups, t_std * 1e9 / lookups, t_find / t_batch);
+	}
+	return 0;
+}
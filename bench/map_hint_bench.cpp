@@ -0,0 +1,96 @@
+/**
+ * hinted insert against plain insert for three key streams:
+ *   - monotonic: 0, 1, 2, ...
+ *   - nearly sorted: monotonic, with one key in eight swapped with a key
+ *     up to 16 places later;
+ *   - random: a shuffle.
+ * the hint is either end() (right for appends) or the element inserted
+ *   last (right for every key that goes next to the previous one: map also
+ *   takes a hint that the new key follows).
+ *
+ * usage: map_hint_bench [n = 2000000] [runs = 3]
+ */
+#include <cstdio>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<int, int> map_type;
+
+static std::vector<int> nearly_sorted(int n, unsigned seed)
+{
+	std::vector<int> v(n);
+	for (int i = 0; i < n; ++i)
+		v[i] = i;
+	std::mt19937 rng(seed);
+	for (int i = 0; i + 16 < n; ++i)
+		if (rng() % 8 == 0)
+			std::swap(v[i], v[i + 1 + rng() % 16]);
+	return v;
+}
+
+static void plain(const std::vector<int> &keys)
+{
+	map_type m;
+	for (size_t i = 0; i < keys.size(); ++i)
+		m.insert(map_type::value_type(keys[i], 0));
+	bench::keep(m.size());
+}
+
+static void hint_end(const std::vector<int> &keys)
+{
+	map_type m;
+	for (size_t i = 0; i < keys.size(); ++i)
+		m.emplace_hint(m.cend(), keys[i], 0);
+	bench::keep(m.size());
+}
+
+static void hint_last(const std::vector<int> &keys)
+{
+	map_type m;
+	map_type::const_iterator hint = m.cend();
+	for (size_t i = 0; i < keys.size(); ++i)
+		hint = m.emplace_hint(hint, keys[i], 0);
+	bench::keep(m.size());
+}
+
+static void std_hint_end(const std::vector<int> &keys)
+{
+	std::map<int, int> m;
+	for (size_t i = 0; i < keys.size(); ++i)
+		m.emplace_hint(m.cend(), keys[i], 0);
+	bench::keep(m.size());
+}
+
+/**
+ * the variants take turns, so that each one finds the heap as scattered
+ *   as the others do: every map freed leaves it in another order.
+ */
+static void row(const char *stream, const std::vector<int> &keys, int runs)
+{
+	void (*variants[4])(const std::vector<int> &) = { plain, hint_end, hint_last, std_hint_end };
+	double best[4] = { 1e30, 1e30, 1e30, 1e30 };
+	for (int r = 0; r < runs; ++r)
+		for (int v = 0; v < 4; ++v)
+			best[v] = std::min(best[v], bench::best_of(1, [&]() { variants[v](keys); }));
+	double n = static_cast<double>(keys.size());
+	std::printf("%-14s %10.1f %10.1f %10.1f %14.1f\n", stream, best[0] * 1e9 / n, best[1] * 1e9 / n, best[2] * 1e9 / n, best[3] * 1e9 / n);
+}
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 2000000));
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 3));
+	std::vector<int> monotonic(n);
+	for (int i = 0; i < n; ++i)
+		monotonic[i] = i;
+	std::printf("n = %d, ns per insert (each includes destroying the map)\n", n);
+	std::printf("%-14s %10s %10s %10s %14s\n", "", "insert", "hint end", "hint last", "std::map end");
+	row("monotonic", monotonic, runs);
+	row("nearly sorted", nearly_sorted(n, 6), runs);
+	row("random", bench::shuffled(n, 6), runs);
+	return 0;
+}
@@ -0,0 +1,58 @@
+/**
+ * memory of a map<int, int> with n elements: node_size(), and the growth of
+ *   the resident set while the map is filled, for this map and for
+ *   std::map. Each is filled in a child process of its own, so that neither
+ *   finds pages the other freed.
+ *   a node of the layout with an int color and a bool is_end took 40 bytes
+ *   on a 64-bit target; the packed one takes 32. malloc rounds both up to
+ *   48 bytes, so a default allocator sees less of the saving than
+ *   pool_allocator, which takes nodes of exactly node_size().
+ *
+ * usage: map_memory_bench [n = 10000000]   (the request's figure is 100000000, about 5 GB)
+ */
+#include <cstdio>
+#include <map>
+#include <sys/wait.h>
+#include "bench.hpp"
+#include "../map.hpp"
+#include "../pool_allocator.hpp"
+
+template<class Map>
+static void measure(const char *name, long n)
+{
+	std::fflush(stdout);
+	pid_t child = fork();
+	if (child != 0)
+	{
+		int status = 0;
+		waitpid(child, &status, 0);
+		return;
+	}
+	size_t before = bench::resident_bytes();
+	double t = bench::now();
+	{
+		Map m;
+		for (long i = 0; i < n; ++i)
+			m.emplace(static_cast<int>(i), static_cast<int>(i));
+		size_t after = bench::resident_bytes();
+		std::printf("%-28s %12.1f %14.1f %10.1f\n", name, (after - before) / 1048576.0,
+			static_cast<double>(after - before) / n, (bench::now() - t) * 1e9 / n);
+		bench::keep(m.size());
+		std::fflush(stdout);
+	}
+	_exit(0);
+}
+
+int main(int argc, char **argv)
+{
+	long n = bench::arg(argc, argv, 1, 10000000);
+	typedef sjtu::map<int, int> map_type;
+	typedef sjtu::map<int, int, std::less<int>, sjtu::pool_allocator<sjtu::pair<const int, int> > > pool_map_type;
+	std::printf("n = %ld, sizeof(pair<const int, int>) = %zu, map<int, int>::node_size() = %zu\n",
+		n, sizeof(map_type::value_type), map_type::node_size());
+	std::printf("%-28s %12s %14s %10s\n", "", "resident MB", "bytes/element", "ns/insert");
+	measure<map_type>("map", n);
+	measure<pool_map_type>("map, pool_allocator", n);
+	measure<std::map<int, int> >("std::map", n);
+	return 0;
+}
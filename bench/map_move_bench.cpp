@@ -0,0 +1,85 @@
+/**
+ * the cost of handing a map around: a copy walks every node, a move,
+ *   a move assignment and a swap only exchange the roots, so their time
+ *   does not grow with the size.
+ *
+ * usage: map_move_bench [largest size = 10000000]
+ *   the sizes run from 1000 up to the largest by factors of 10.
+ */
+#include <cstdio>
+#include <utility>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<int, int> map_type;
+
+static const int moves = 1000000;
+
+// a map returned by value, as a factory would.
+static map_type pass_through(map_type m)
+{
+	return m;
+}
+
+int main(int argc, char **argv)
+{
+	long largest = bench::arg(argc, argv, 1, 10000000);
+	std::printf("%12s %12s %12s %12s %12s %14s\n", "size", "copy ms", "move ns", "move= ns", "swap ns", "by value ns");
+	for (long n = 1000; n <= largest; n *= 10)
+	{
+		map_type a;
+		for (long i = 0; i < n; ++i)
+			a.insert(a.cend(), map_type::value_type(static_cast<int>(i), 0));
+
+		double t_copy = bench::best_of(n > 1000000 ? 1 : 3, [&]() {
+			map_type c(a);
+			bench::keep(c.size());
+		});
+
+		// each timing moves the map away and back, so a ends up with it again.
+		double t_move = bench::best_of(3, [&]() {
+			for (int i = 0; i < moves; ++i)
+			{
+				map_type b(std::move(a));
+				new (&a) map_type(std::move(b));
+				b.~map_type();
+				new (&b) map_type();
+			}
+		});
+		map_type b;
+		double t_assign = bench::best_of(3, [&]() {
+			for (int i = 0; i < moves / 2; ++i)
+			{
+				b = std::move(a);
+				a = std::move(b);
+			}
+		});
+		double t_swap = bench::best_of(3, [&]() {
+			for (int i = 0; i < moves; ++i)
+				a.swap(b);
+		});
+		if (a.empty())
+			a.swap(b);
+		double t_value = bench::best_of(3, [&]() {
+			for (int i = 0; i < moves / 2; ++i)
+				a = pass_through(std::move(a));
+		});
+		bench::keep(a.size());
+		std::printf("%12ld %12.2f %12.1f %12.1f %12.1f %14.1f\n", n, t_copy * 1e3,
+			t_move * 1e9 / moves, t_assign * 1e9 / moves, t_swap * 1e9 / moves, t_value * 2e9 / moves);
+	}
+
+	// a vector of maps that has to grow moves them (the move is noexcept), it copies no element.
+	std::vector<map_type> v(1000);
+	for (size_t i = 0; i < v.size(); ++i)
+		for (int j = 0; j < 10000; ++j)
+			v[i].insert(v[i].cend(), map_type::value_type(j, j));
+	const map_type::value_type *first = &*v[0].cbegin();
+	double t = bench::now();
+	v.reserve(2 * v.capacity());
+	double t_grow = bench::now() - t;
+	std::printf("\ngrowing a vector of 1000 maps of 10000 elements: %.1f us%s\n", t_grow * 1e6,
+		&*v[0].cbegin() == first ? ", the nodes stayed where they were" : "");
+	return 0;
+}
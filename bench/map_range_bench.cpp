@@ -0,0 +1,86 @@
+/**
+ * summing the values of the keys in [lo, hi), for ranges of 16, 1024 and
+ *   n / 8 keys at random places in a map of n keys inserted in random
+ *   order:
+ *   - full scan: begin() to end(), testing every key, as before there was
+ *     lower_bound;
+ *   - lower_bound(lo), then ++ while the key is less than hi;
+ *   - for_each_in_range(lo, hi, fn);
+ *   - std::map, lower_bound and ++.
+ *
+ * usage: map_range_bench [n = 1000000] [runs = 3]
+ */
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<int, int> map_type;
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 1000000));
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 3));
+	std::vector<int> keys = bench::shuffled(n, 7);
+	map_type m;
+	std::map<int, int> s;
+	for (int i = 0; i < n; ++i)
+	{
+		m.insert(map_type::value_type(keys[i], i));
+		s.emplace(keys[i], i);
+	}
+
+	std::printf("n = %d, us per range (ns per element in it)\n", n);
+	std::printf("%-8s %20s %20s %20s %20s\n", "width", "full scan", "lower_bound, ++", "for_each_in_range", "std::map");
+	const int widths[3] = { 16, 1024, n / 8 };
+	for (int w = 0; w < 3; ++w)
+	{
+		int width = std::max(widths[w], 1);
+		// about as many elements visited per row, and at least a few ranges.
+		int queries = std::max(8, 4000000 / width);
+		// a full scan visits all n keys whatever the width.
+		int scans = std::max(1, 2000000 / std::max(n, 1));
+		std::mt19937 rng(w);
+		std::vector<int> lo(queries);
+		for (int i = 0; i < queries; ++i)
+			lo[i] = static_cast<int>(rng() % static_cast<unsigned>(std::max(n - width, 1)));
+
+		double t_full = bench::best_of(runs, [&]() {
+			size_t sum = 0;
+			for (int i = 0; i < scans; ++i)
+				for (map_type::const_iterator it = m.cbegin(); it != m.cend(); ++it)
+					if (it->first >= lo[i] && it->first < lo[i] + width)
+						sum += it->second;
+			bench::keep(sum);
+		}) / scans;
+		double t_walk = bench::best_of(runs, [&]() {
+			size_t sum = 0;
+			for (int i = 0; i < queries; ++i)
+				for (map_type::const_iterator it = m.lower_bound(lo[i]); it != m.cend() && it->first < lo[i] + width; ++it)
+					sum += it->second;
+			bench::keep(sum);
+		}) / queries;
+		double t_each = bench::best_of(runs, [&]() {
+			size_t sum = 0;
+			const map_type &c = m;
+			for (int i = 0; i < queries; ++i)
+				c.for_each_in_range(lo[i], lo[i] + width, [&](const map_type::value_type &v) { sum += v.second; });
+			bench::keep(sum);
+		}) / queries;
+		double t_std = bench::best_of(runs, [&]() {
+			size_t sum = 0;
+			for (int i = 0; i < queries; ++i)
+				for (std::map<int, int>::const_iterator it = s.lower_bound(lo[i]); it != s.cend() && it->first < lo[i] + width; ++it)
+					sum += it->second;
+			bench::keep(sum);
+		}) / queries;
+		double t[4] = { t_full, t_walk, t_each, t_std };
+		std::printf("%-8d", width);
+		for (int i = 0; i < 4; ++i)
+			std::printf(" %11.1f (%6.1f)", t[i] * 1e6, t[i] * 1e9 / width);
+		std::printf("\n");
+	}
+	return 0;
+}
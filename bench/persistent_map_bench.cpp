@@ -0,0 +1,91 @@
+/**
+ * the cost of a consistent view of a map of n int pairs, in time and in
+ *   resident memory:
+ *   - a full copy of a map, map(const map &);
+ *   - persistent_map::snapshot();
+ *   - then w writes to the live persistent_map while the snapshot is kept,
+ *     which copy the shared nodes on their paths, against the same writes
+ *     with no snapshot alive.
+ *   Each row runs in a child process of its own, after building the map,
+ *   so that the memory it reports is only what the row allocated.
+ *
+ * usage: persistent_map_bench [n = 1000000]
+ */
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <sys/wait.h>
+#include "bench.hpp"
+#include "../map.hpp"
+#include "../persistent_map.hpp"
+
+typedef sjtu::map<int, int> map_type;
+typedef sjtu::persistent_map<int, int> persistent_type;
+
+// prints name, time and resident growth of f(m) in a child process, on a map built from keys.
+template<class Map, class F>
+static void row(const char *name, const std::vector<int> &keys, long per, F f)
+{
+	std::fflush(stdout);
+	pid_t child = fork();
+	if (child != 0)
+	{
+		int status = 0;
+		waitpid(child, &status, 0);
+		return;
+	}
+	Map m;
+	for (size_t i = 0; i < keys.size(); ++i)
+		m.insert(typename Map::value_type(keys[i], keys[i]));
+	size_t before = bench::resident_bytes();
+	double t = bench::now();
+	f(m);
+	t = bench::now() - t;
+	size_t grown = bench::resident_bytes() - before;
+	std::printf("%-36s %14.1f %12.1f %14.1f\n", name, t * 1e6, grown / 1048576.0, t * 1e9 / per);
+	std::fflush(stdout);
+	_exit(0);
+}
+
+template<class Map>
+static void write(Map &m, long w, int n)
+{
+	std::mt19937 rng(18);
+	for (long i = 0; i < w; ++i)
+	{
+		int k = static_cast<int>(rng() % static_cast<unsigned>(n));
+		m.insert_or_assign(k, static_cast<int>(i));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 1000000));
+	std::vector<int> keys = bench::shuffled(n, 18);
+	std::printf("n = %d\n%-36s %14s %12s %14s\n", n, "", "us", "resident MB", "ns per item");
+	row<map_type>("map copy", keys, n, [](map_type &m) {
+		map_type *c = new map_type(m);
+		bench::keep(c->size());
+	});
+	row<persistent_type>("persistent_map snapshot()", keys, 1, [](persistent_type &m) {
+		persistent_type *s = new persistent_type(m.snapshot());
+		bench::keep(s->size());
+	});
+	const long ws[3] = { 1000, 100000, n };
+	for (int i = 0; i < 3; ++i)
+	{
+		long w = ws[i];
+		char name[64];
+		std::snprintf(name, sizeof(name), "%ld writes, no snapshot", w);
+		row<persistent_type>(name, keys, w, [w, n](persistent_type &m) { write(m, w, n); });
+		std::snprintf(name, sizeof(name), "%ld writes, snapshot kept", w);
+		row<persistent_type>(name, keys, w, [w, n](persistent_type &m) {
+			persistent_type *s = new persistent_type(m.snapshot());
+			write(m, w, n);
+			bench::keep(s->size());
+		});
+		std::snprintf(name, sizeof(name), "%ld writes, map", w);
+		row<map_type>(name, keys, w, [w, n](map_type &m) { write(m, w, n); });
+	}
+	return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * write-heavy mixes on 1 to 64 threads, on random keys in [0, 2n) of a map
+ *   preloaded with n keys, split into 16 shards of equal key ranges:
+ *   - insert-heavy: 80% insert_or_assign, 10% erase, 10% find;
+ *   - mixed: 50% find, 25% insert_or_assign, 25% erase.
+ *   The same total number of operations is split between the threads.
+ *   Compares sharded_map with a map behind one std::mutex, in millions of
+ *   operations per second. With fewer cores than threads the rows past the
+ *   core count measure oversubscription, not scaling.
+ *
+ * usage: sharded_map_bench [n = 100000] [ops = 2000000] [max threads = 64]
+ *   build with -pthread.
+ */
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "bench.hpp"
+#include "../map.hpp"
+#include "../sharded_map.hpp"
+
+static const int shards = 16;
+
+struct sharded
+{
+	sjtu::sharded_map<int, int, std::less<int>, shards> m;
+	explicit sharded(const std::vector<int> &bounds) : m(bounds.begin(), bounds.end()) {}
+	bool find(int k)
+	{
+		int v;
+		return m.find(k, v);
+	}
+	void assign(int k, int v)
+	{
+		m.insert_or_assign(k, v);
+	}
+	void erase(int k)
+	{
+		m.erase(k);
+	}
+};
+
+struct one_mutex
+{
+	sjtu::map<int, int> m;
+	std::mutex lock;
+	explicit one_mutex(const std::vector<int> &) {}
+	bool find(int k)
+	{
+		std::lock_guard<std::mutex> g(lock);
+		return m.find(k) != m.end();
+	}
+	void assign(int k, int v)
+	{
+		std::lock_guard<std::mutex> g(lock);
+		m.insert_or_assign(k, v);
+	}
+	void erase(int k)
+	{
+		std::lock_guard<std::mutex> g(lock);
+		m.erase(k);
+	}
+};
+
+// of every 20 operations, inserts are insert_or_assign and erases are erase; the rest are finds.
+template<class Map>
+static double run(int n, long ops, int threads, unsigned inserts, unsigned erases)
+{
+	std::vector<int> bounds;
+	for (int i = 1; i < shards; ++i)
+		bounds.push_back(static_cast<int>(2L * n * i / shards));
+	Map m(bounds);
+	for (int i = 0; i < n; ++i)
+		m.assign(2 * i, i);
+	std::vector<std::thread> pool;
+	double t = bench::now();
+	for (int id = 0; id < threads; ++id)
+		pool.push_back(std::thread([&m, n, ops, threads, id, inserts, erases]() {
+			std::mt19937 rng(id);
+			size_t hits = 0;
+			for (long i = id; i < ops; i += threads)
+			{
+				int k = static_cast<int>(rng() % (2 * static_cast<unsigned>(n)));
+				unsigned r = rng() % 20;
+				if (r < inserts)
+					m.assign(k, static_cast<int>(i));
+				else if (r < inserts + erases)
+					m.erase(k);
+				else
+					hits += m.find(k);
+			}
+			bench::keep(hits);
+		}));
+	for (size_t i = 0; i < pool.size(); ++i)
+		pool[i].join();
+	return ops / (bench::now() - t) / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	int n = static_cast<int>(bench::arg(argc, argv, 1, 100000));
+	long ops = bench::arg(argc, argv, 2, 2000000);
+	int max_threads = static_cast<int>(bench::arg(argc, argv, 3, 64));
+	std::printf("n = %d, %ld operations, %d shards, %u hardware threads, Mops/s\n", n, ops, shards, std::thread::hardware_concurrency());
+	std::printf("%-8s %14s %14s %14s %14s\n", "", "insert-heavy", "", "mixed", "");
+	std::printf("%-8s %14s %14s %14s %14s\n", "threads", "sharded_map", "map + mutex", "sharded_map", "map + mutex");
+	for (int threads = 1; threads <= max_threads; threads *= 2)
+		std::printf("%-8d %14.2f %14.2f %14.2f %14.2f\n", threads,
+			run<sharded>(n, ops, threads, 16, 2), run<one_mutex>(n, ops, threads, 16, 2),
+			run<sharded>(n, ops, threads, 5, 5), run<one_mutex>(n, ops, threads, 5, 5));
+	return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * short-lived tiny maps, as for per-request attribute bags: create a
+ *   map<int, int>, insert k elements, find each of them and destroy it,
+ *   for k from 0 to 8 (what small_map<..., 8> keeps inline) and past it.
+ *   Prints the time per map and what each map takes from the heap, counted
+ *   by the allocator, for small_map, map and std::map, and sizeof of each.
+ *
+ * usage: small_map_bench [maps = 1000000] [runs = 3]
+ */
+#include <cstdio>
+#include <map>
+#include <memory>
+#include "bench.hpp"
+#include "../map.hpp"
+#include "../small_map.hpp"
+
+static size_t heap_calls = 0, heap_bytes = 0;
+
+template<class U>
+struct counting_allocator
+{
+	typedef U value_type;
+	counting_allocator() {}
+	template<class V>
+	counting_allocator(const counting_allocator<V> &) {}
+	U * allocate(size_t n)
+	{
+		++heap_calls;
+		heap_bytes += n * sizeof(U);
+		return std::allocator<U>().allocate(n);
+	}
+	void deallocate(U *p, size_t n)
+	{
+		std::allocator<U>().deallocate(p, n);
+	}
+	template<class V>
+	bool operator==(const counting_allocator<V> &) const
+	{
+		return true;
+	}
+	template<class V>
+	bool operator!=(const counting_allocator<V> &) const
+	{
+		return false;
+	}
+};
+
+typedef sjtu::small_map<int, int, std::less<int>, 8, counting_allocator<sjtu::pair<const int, int> > > small_type;
+typedef sjtu::map<int, int, std::less<int>, counting_allocator<sjtu::pair<const int, int> > > map_type;
+typedef std::map<int, int, std::less<int>, counting_allocator<std::pair<const int, int> > > std_map_type;
+
+// prints ns, heap allocations and heap bytes per map.
+template<class Map>
+static void cell(int k, long maps, int runs)
+{
+	heap_calls = heap_bytes = 0;
+	double t = bench::best_of(runs, [&]() {
+		size_t hits = 0;
+		for (long i = 0; i < maps; ++i)
+		{
+			Map m;
+			for (int j = 0; j < k; ++j)
+				m.emplace(j * 7 % 16, j);
+			for (int j = 0; j < k; ++j)
+				hits += m.count(j * 7 % 16);
+			bench::keep(hits);
+		}
+	});
+	double per = static_cast<double>(maps) * runs;
+	std::printf(" %7.1f %6.1f %6.0f", t * 1e9 / maps, heap_calls / per, heap_bytes / per);
+}
+
+int main(int argc, char **argv)
+{
+	long maps = bench::arg(argc, argv, 1, 1000000);
+	int runs = static_cast<int>(bench::arg(argc, argv, 2, 3));
+	std::printf("%ld maps of k elements: create, insert, find, destroy\n", maps);
+	std::printf("sizeof: small_map %zu, map %zu, std::map %zu\n", sizeof(small_type), sizeof(map_type), sizeof(std_map_type));
+	std::printf("%-4s %21s    %21s    %21s\n", "", "small_map", "map", "std::map");
+	std::printf("%-4s", "k");
+	for (int i = 0; i < 3; ++i)
+		std::printf(" %7s %6s %6s  ", "ns", "allocs", "bytes");
+	std::printf("\n");
+	const int ks[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 16 };
+	for (int i = 0; i < 12; ++i)
+	{
+		std::printf("%-4d", ks[i]);
+		cell<small_type>(ks[i], maps, runs);
+		std::printf("  ");
+		cell<map_type>(ks[i], maps, runs);
+		std::printf("  ");
+		cell<std_map_type>(ks[i], maps, runs);
+		std::printf("\n");
+	}
+	return 0;
+}
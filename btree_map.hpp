@@ -0,0 +1,1345 @@
+/**
+ * implement a container like std::map on a B-tree
+ */
+#ifndef SJTU_BTREE_MAP_HPP
+#define SJTU_BTREE_MAP_HPP
+
+#include <functional>
+#include <iterator>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "map.hpp"
+#include "key_rank.hpp"
+
+namespace sjtu {
+
+/**
+ * btree_map has the interface of map, but keeps up to max_values elements
+ *   in every node, next to each other, so a lookup touches about
+ *   log_{max_values}(n) nodes instead of log2(n) and there are no per
+ *   element links.
+ *
+ * a leaf only holds values; an internal node with k values also holds
+ *   k + 1 children, and every value lies between the subtrees of the
+ *   children on its two sides. All leaves are on the same level. A full
+ *   node is split in the middle, except a leaf overflowing at one of its
+ *   ends, which keeps everything on the other side: keys inserted in order
+ *   then leave full leaves behind. A node left less than half full by an
+ *   erase takes values from a sibling or is merged with it.
+ *
+ * elements move between nodes when the tree changes, so insert and erase
+ *   invalidate all iterators and references, unlike map. Those moves must
+ *   not fail halfway: when moving a Key or a T may throw, every element is
+ *   allocated by itself and the nodes only hold pointers to them.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>,
+	class Allocator = std::allocator<pair<const Key, T> >
+> class btree_map : private compare_holder<Compare>
+{
+	friend class iterator;
+	friend class const_iterator;
+public:
+	typedef pair<const Key, T> value_type;
+
+private:
+	typedef pair<const Key, T> Value;
+	// what a slot holds. Its key is not const, so shifting an element moves the key
+	//   instead of copying it; the element is handed out as a Value (as_const_key).
+	typedef pair<Key, T> Stored;
+	using compare_holder<Compare>::comp;
+
+	static const bool inline_values = std::is_nothrow_move_constructible<Stored>::value;
+	typedef typename std::conditional<inline_values,
+		typename std::aligned_storage<sizeof(Stored), alignof(Stored)>::type, Stored*>::type slot_type;
+
+	/**
+	 * 4 byte keys key_rank can count with SIMD are kept a second time, packed
+	 *   in keys[] apart from the slots, and searched there. They are on top
+	 *   of node_bytes: fewer values per node lost more than SIMD won. 8 byte
+	 *   keys (4 to an instruction) were measured slower packed than counted
+	 *   in the slots.
+	 */
+	static const bool packed_keys = key_rank<Key, Compare>::vectorized && sizeof(Key) == 4;
+
+	// a node is about node_bytes large: the values fill what the link and count fields leave.
+	static const size_t node_bytes = 256;
+	static const size_t fitting_values = (node_bytes - 2 * sizeof(void*)) / sizeof(slot_type);
+public:
+	static const size_t max_values = fitting_values < 3 ? 3 : (fitting_values > 120 ? 120 : fitting_values);
+private:
+	static const size_t min_values = max_values / 2;
+
+	struct key_array
+	{
+		Key keys[max_values];
+	};
+	struct no_key_array
+	{
+	};
+
+	struct internal_node;
+	struct leaf_node : public std::conditional<packed_keys, key_array, no_key_array>::type
+	{
+		internal_node *parent;
+		unsigned char position; // index among the children of parent
+		unsigned char count;
+		bool leaf;
+		slot_type slots[max_values];
+		Stored & stored(size_t i)
+		{
+			return *stored_in(slots[i], std::integral_constant<bool, inline_values>());
+		}
+		Value & value(size_t i)
+		{
+			return as_const_key(stored(i));
+		}
+		const Value & value(size_t i) const
+		{
+			return const_cast<leaf_node*>(this)->value(i);
+		}
+	};
+	struct internal_node : public leaf_node
+	{
+		leaf_node *children[max_values + 1];
+	};
+	typedef leaf_node node;
+
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<leaf_node> leaf_allocator;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<internal_node> internal_allocator;
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Stored> stored_allocator;
+	typedef std::allocator_traits<leaf_allocator> leaf_traits;
+	typedef std::allocator_traits<internal_allocator> internal_traits;
+	typedef std::allocator_traits<stored_allocator> stored_traits;
+	leaf_allocator leaf_alloc;
+	internal_allocator internal_alloc;
+	node *root;
+	size_t node_count;
+
+	static internal_node* as_internal(node *x)
+	{
+		return static_cast<internal_node*>(x);
+	}
+	static const internal_node* as_internal(const node *x)
+	{
+		return static_cast<const internal_node*>(x);
+	}
+	static node* child(const node *x, size_t i)
+	{
+		return as_internal(x)->children[i];
+	}
+	static void set_child(node *x, size_t i, node *c)
+	{
+		as_internal(x)->children[i] = c;
+		c->parent = as_internal(x);
+		c->position = static_cast<unsigned char>(i);
+	}
+
+	// the fields only; the slots stay raw until values are constructed in them.
+	node* new_node(bool leaf)
+	{
+		node *x;
+		if (leaf)
+			x = leaf_traits::allocate(leaf_alloc, 1);
+		else
+			x = internal_traits::allocate(internal_alloc, 1);
+		x->parent = NULL;
+		x->position = 0;
+		x->count = 0;
+		x->leaf = leaf;
+		return x;
+	}
+
+	void delete_node(node *x)
+	{
+		if (x->leaf)
+			leaf_traits::deallocate(leaf_alloc, x, 1);
+		else
+			internal_traits::deallocate(internal_alloc, as_internal(x), 1);
+	}
+
+	static Stored* stored_in(slot_type &s, std::true_type)
+	{
+		return reinterpret_cast<Stored*>(&s);
+	}
+	static Stored* stored_in(slot_type &s, std::false_type)
+	{
+		return s;
+	}
+
+	// build an element in the raw slot i of x.
+	template<class... Args>
+	void construct(node *x, size_t i, Args&&... args)
+	{
+		construct(x, i, std::integral_constant<bool, inline_values>(), std::forward<Args>(args)...);
+	}
+	template<class... Args>
+	void construct(node *x, size_t i, std::true_type, Args&&... args)
+	{
+		::new (static_cast<void*>(&x->slots[i])) Stored(std::forward<Args>(args)...);
+		copy_key(x, i);
+	}
+	template<class... Args>
+	void construct(node *x, size_t i, std::false_type, Args&&... args)
+	{
+		x->slots[i] = make_stored(std::forward<Args>(args)...);
+		copy_key(x, i);
+	}
+
+	// the key in slot i of x, read from keys[] when they are packed so the slots stay untouched.
+	static const Key & key_at(const node *x, size_t i)
+	{
+		return key_at(x, i, std::integral_constant<bool, packed_keys>());
+	}
+	static const Key & key_at(const node *x, size_t i, std::true_type)
+	{
+		return x->keys[i];
+	}
+	static const Key & key_at(const node *x, size_t i, std::false_type)
+	{
+		return x->value(i).first;
+	}
+
+	// bring keys[i] of x up to date with slot i, when the keys are packed.
+	static void copy_key(node *x, size_t i) noexcept
+	{
+		copy_key(x, i, std::integral_constant<bool, packed_keys>());
+	}
+	static void copy_key(node *x, size_t i, std::true_type) noexcept
+	{
+		x->keys[i] = x->stored(i).first;
+	}
+	static void copy_key(node *, size_t, std::false_type) noexcept
+	{
+	}
+
+	// an element allocated by itself, for slots that hold pointers.
+	template<class... Args>
+	Stored* make_stored(Args&&... args)
+	{
+		stored_allocator a(leaf_alloc);
+		Stored *p = stored_traits::allocate(a, 1);
+		try
+		{
+			stored_traits::construct(a, p, std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			stored_traits::deallocate(a, p, 1);
+			throw;
+		}
+		return p;
+	}
+	void drop_stored(Stored *p)
+	{
+		stored_allocator a(leaf_alloc);
+		stored_traits::destroy(a, p);
+		stored_traits::deallocate(a, p, 1);
+	}
+
+	// destroy the element in slot i of x, leaving the slot raw.
+	void destroy(node *x, size_t i)
+	{
+		destroy(x, i, std::integral_constant<bool, inline_values>());
+	}
+	void destroy(node *x, size_t i, std::true_type)
+	{
+		x->stored(i).~Stored();
+	}
+	void destroy(node *x, size_t i, std::false_type)
+	{
+		drop_stored(x->slots[i]);
+	}
+
+	// move the element in slot si of sx into the raw slot di of dx, leaving si raw; never throws.
+	static void relocate(node *dx, size_t di, node *sx, size_t si) noexcept
+	{
+		relocate(dx, di, sx, si, std::integral_constant<bool, inline_values>());
+	}
+	static void relocate(node *dx, size_t di, node *sx, size_t si, std::true_type) noexcept
+	{
+		::new (static_cast<void*>(&dx->slots[di])) Stored(std::move(sx->stored(si)));
+		sx->stored(si).~Stored();
+		copy_key(dx, di);
+	}
+	static void relocate(node *dx, size_t di, node *sx, size_t si, std::false_type) noexcept
+	{
+		dx->slots[di] = sx->slots[si];
+		copy_key(dx, di);
+	}
+
+	// open a raw slot at i by moving the values (and the children right of them) one place right.
+	static void open_slot(node *x, size_t i)
+	{
+		for (size_t j = x->count; j > i; --j)
+			relocate(x, j, x, j - 1);
+		if (!x->leaf)
+			for (size_t j = x->count + 1; j > i + 1; --j)
+				set_child(x, j, child(x, j - 1));
+	}
+
+	// close the raw slot at i (and drop child i + 1), the reverse of open_slot.
+	static void close_slot(node *x, size_t i)
+	{
+		for (size_t j = i; j + 1 < x->count; ++j)
+			relocate(x, j, x, j + 1);
+		if (!x->leaf)
+			for (size_t j = i + 1; j < x->count; ++j)
+				set_child(x, j, child(x, j + 1));
+		--x->count;
+	}
+
+	void clear(node *x)
+	{
+		if (x == NULL)
+			return;
+		if (!x->leaf)
+			for (size_t i = 0; i <= x->count; ++i)
+				clear(child(x, i));
+		for (size_t i = 0; i < x->count; ++i)
+			destroy(x, i);
+		delete_node(x);
+	}
+
+	node* copy_tree(const node *x, internal_node *p)
+	{
+		node *y = new_node(x->leaf);
+		y->parent = p;
+		y->position = x->position;
+		size_t children = 0;
+		try
+		{
+			for (; y->count < x->count; ++y->count)
+				construct(y, y->count, x->value(y->count));
+			if (!x->leaf)
+				for (; children <= x->count; ++children)
+					set_child(y, children, copy_tree(child(x, children), as_internal(y)));
+		}
+		catch (...)
+		{
+			for (size_t i = 0; i < children; ++i)
+				clear(child(y, i));
+			for (size_t i = 0; i < y->count; ++i)
+				destroy(y, i);
+			delete_node(y);
+			throw;
+		}
+		return y;
+	}
+
+	/**
+	 * the first value in x whose key is not less than key,
+	 *   x->count if there is none. Arithmetic keys are cheap to compare, so
+	 *   all of them are counted by key_rank without a branch: from keys[]
+	 *   with SIMD when they are packed, else in the slots. Other keys are
+	 *   binary searched.
+	 */
+	template<class K>
+	size_t lower_bound_in(const node *x, const K &key) const
+	{
+		return lower_bound_in(x, key, std::integral_constant<int,
+			packed_keys ? 2 : (std::is_arithmetic<Key>::value && inline_values ? 1 : 0)>());
+	}
+	template<class K>
+	size_t lower_bound_in(const node *x, const K &key, std::integral_constant<int, 2>) const
+	{
+		return key_rank<Key, Compare>::count_less(reinterpret_cast<const char*>(x->keys), x->count, key, comp());
+	}
+	template<class K>
+	size_t lower_bound_in(const node *x, const K &key, std::integral_constant<int, 1>) const
+	{
+		const char *first = reinterpret_cast<const char*>(&x->value(0).first);
+		return key_rank<Key, Compare, sizeof(slot_type)>::count_less(first, x->count, key, comp());
+	}
+	template<class K>
+	size_t lower_bound_in(const node *x, const K &key, std::integral_constant<int, 0>) const
+	{
+		size_t lo = 0, hi = x->count;
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			if (comp()(x->value(mid).first, key))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	template<class K>
+	size_t upper_bound_in(const node *x, const K &key) const
+	{
+		size_t lo = 0, hi = x->count;
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			if (comp()(key, key_at(x, mid)))
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		return lo;
+	}
+
+	// fetch all the cache lines of a node the search is about to enter.
+	static void prefetch(const node *x)
+	{
+#if defined(__GNUC__)
+		const char *p = reinterpret_cast<const char*>(x);
+		for (size_t off = 0; off < sizeof(leaf_node); off += 64)
+			__builtin_prefetch(p + off);
+#else
+		(void)x;
+#endif
+	}
+
+	/**
+	 * the element with key equivalent to key: on success x / i are its node and index.
+	 */
+	template<class K>
+	bool find_pos(const K &key, node* &x, size_t &i) const
+	{
+		x = root;
+		while (x != NULL)
+		{
+			i = lower_bound_in(x, key);
+			if (i < x->count && !comp()(key, key_at(x, i)))
+				return true;
+			if (x->leaf)
+				return false;
+			x = child(x, i);
+			prefetch(x);
+		}
+		return false;
+	}
+
+	// the in-order position of the first element not less than key (end: NULL).
+	template<class K>
+	void lower_bound_pos(const K &key, node* &y, size_t &j) const
+	{
+		y = NULL;
+		j = 0;
+		for (node *x = root; x != NULL; )
+		{
+			size_t i = lower_bound_in(x, key);
+			if (i < x->count)
+			{
+				y = x;
+				j = i;
+				if (!comp()(key, key_at(x, i)))
+					return;
+			}
+			if (x->leaf)
+				return;
+			x = child(x, i);
+		}
+	}
+
+	template<class K>
+	void upper_bound_pos(const K &key, node* &y, size_t &j) const
+	{
+		y = NULL;
+		j = 0;
+		for (node *x = root; x != NULL; )
+		{
+			size_t i = upper_bound_in(x, key);
+			if (i < x->count)
+			{
+				y = x;
+				j = i;
+			}
+			if (x->leaf)
+				return;
+			x = child(x, i);
+		}
+	}
+
+	/**
+	 * split the full node x in two around a median that moves up into the
+	 *   parent (split first if it is full as well). i is where a value is
+	 *   about to go into x; it is moved to the half that has to take it, and
+	 *   the split point leans so that keys arriving in order fill nodes up.
+	 */
+	void split(node* &x, size_t &i)
+	{
+		size_t mid = max_values / 2;
+		if (x->leaf && i == max_values)
+			mid = max_values - 1;
+		else if (x->leaf && i == 0)
+			mid = 0;
+		node *y = new_node(x->leaf);
+		if (x == root)
+		{
+			node *p;
+			try
+			{
+				p = new_node(false);
+			}
+			catch (...)
+			{
+				delete_node(y);
+				throw;
+			}
+			set_child(p, 0, x);
+			root = p;
+		}
+		else if (x->parent->count == max_values)
+		{
+			node *p = x->parent;
+			size_t pos = x->position;
+			try
+			{
+				split(p, pos);
+			}
+			catch (...)
+			{
+				delete_node(y);
+				throw;
+			}
+		}
+		node *p = x->parent;
+		size_t pos = x->position;
+		for (size_t j = mid + 1; j < x->count; ++j)
+			relocate(y, j - mid - 1, x, j);
+		if (!x->leaf)
+			for (size_t j = mid + 1; j <= x->count; ++j)
+				set_child(y, j - mid - 1, child(x, j));
+		y->count = static_cast<unsigned char>(x->count - mid - 1);
+		open_slot(p, pos);
+		relocate(p, pos, x, mid);
+		set_child(p, pos + 1, y);
+		++p->count;
+		x->count = static_cast<unsigned char>(mid);
+		if (i > mid)
+		{
+			x = y;
+			i -= mid + 1;
+		}
+	}
+
+	/**
+	 * put a value built from args at (x, i) of a leaf, where it keeps the order;
+	 *   x / i are left at the new element. If building it throws, the tree
+	 *   is left as it was.
+	 */
+	template<class... Args>
+	void insert_at(node* &x, size_t &i, Args&&... args)
+	{
+		insert_at(x, i, std::integral_constant<bool, inline_values>(), std::forward<Args>(args)...);
+	}
+	template<class... Args>
+	void insert_at(node* &x, size_t &i, std::true_type, Args&&... args)
+	{
+		if (x == NULL)
+		{
+			x = root = new_node(true);
+			i = 0;
+		}
+		if (x->count == max_values)
+		{
+			// build the value before the tree changes; moving it in cannot throw.
+			Stored tmp(std::forward<Args>(args)...);
+			split(x, i);
+			open_slot(x, i);
+			construct(x, i, std::move(tmp));
+		}
+		else
+		{
+			open_slot(x, i);
+			try
+			{
+				construct(x, i, std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				for (size_t j = i; j < x->count; ++j)
+					relocate(x, j, x, j + 1);
+				if (x->count == 0 && x == root)
+				{
+					delete_node(x);
+					root = NULL;
+				}
+				throw;
+			}
+		}
+		++x->count;
+		++node_count;
+	}
+	template<class... Args>
+	void insert_at(node* &x, size_t &i, std::false_type, Args&&... args)
+	{
+		Stored *p = make_stored(std::forward<Args>(args)...);
+		try
+		{
+			if (x == NULL)
+			{
+				x = root = new_node(true);
+				i = 0;
+			}
+			if (x->count == max_values)
+				split(x, i);
+		}
+		catch (...)
+		{
+			drop_stored(p);
+			throw;
+		}
+		open_slot(x, i);
+		x->slots[i] = p;
+		copy_key(x, i);
+		++x->count;
+		++node_count;
+	}
+
+	/**
+	 * the leaf position where key goes, or false with x / i at the element holding it.
+	 */
+	bool get_insert_pos(const Key &key, node* &x, size_t &i) const
+	{
+		if (find_pos(key, x, i))
+			return false;
+		// find_pos stops at a leaf (or an empty tree) when the key is not there.
+		return true;
+	}
+
+	// the element at (tx, ti) was moved to (x, i): follow it.
+	static void follow(node* &tx, size_t &ti, node *from, size_t fi, node *x, size_t i)
+	{
+		if (tx == from && ti == fi)
+		{
+			tx = x;
+			ti = i;
+		}
+	}
+
+	/**
+	 * x is less than half full (the root: empty); move values over from
+	 *   a sibling, or merge with one, up the tree as far as needed.
+	 *   (tx, ti) is kept on the element it points to (tx may be NULL).
+	 */
+	void rebalance(node *x, node* &tx, size_t &ti)
+	{
+		while (x != root && x->count < min_values)
+		{
+			node *p = x->parent;
+			size_t k = x->position;
+			node *l = (k > 0) ? child(p, k - 1) : NULL;
+			node *r = (k < p->count) ? child(p, k + 1) : NULL;
+			if (l != NULL && l->count > min_values)
+			{
+				// the separator comes down to the front of x, the last value of l goes up.
+				open_slot(x, 0);
+				if (tx == x)
+					++ti;
+				if (!x->leaf)
+				{
+					// open_slot(x, 0) moved children 1.. right; child 0 comes from l.
+					set_child(x, 1, child(x, 0));
+					set_child(x, 0, child(l, l->count));
+				}
+				relocate(x, 0, p, k - 1);
+				follow(tx, ti, p, k - 1, x, 0);
+				++x->count;
+				relocate(p, k - 1, l, l->count - 1);
+				follow(tx, ti, l, l->count - 1, p, k - 1);
+				--l->count;
+				return;
+			}
+			if (r != NULL && r->count > min_values)
+			{
+				relocate(x, x->count, p, k);
+				follow(tx, ti, p, k, x, x->count);
+				if (!x->leaf)
+					set_child(x, x->count + 1, child(r, 0));
+				++x->count;
+				relocate(p, k, r, 0);
+				follow(tx, ti, r, 0, p, k);
+				if (!r->leaf)
+					set_child(r, 0, child(r, 1));
+				// child 1 of r is still linked at 0, close_slot(r, 0) shifts the rest over it.
+				for (size_t j = 0; j + 1 < r->count; ++j)
+					relocate(r, j, r, j + 1);
+				if (tx == r)
+					--ti;
+				if (!r->leaf)
+					for (size_t j = 1; j < r->count; ++j)
+						set_child(r, j, child(r, j + 1));
+				--r->count;
+				return;
+			}
+			if (l != NULL)
+				merge(p, k - 1, tx, ti);
+			else
+				merge(p, k, tx, ti);
+			x = p;
+		}
+		if (x == root && x->count == 0)
+		{
+			if (x->leaf)
+				root = NULL;
+			else
+			{
+				root = child(x, 0);
+				root->parent = NULL;
+				root->position = 0;
+			}
+			delete_node(x);
+		}
+	}
+
+	// fold child k + 1 of p and the separator k into child k.
+	void merge(node *p, size_t k, node* &tx, size_t &ti)
+	{
+		node *l = child(p, k);
+		node *r = child(p, k + 1);
+		relocate(l, l->count, p, k);
+		follow(tx, ti, p, k, l, l->count);
+		for (size_t j = 0; j < r->count; ++j)
+			relocate(l, l->count + 1 + j, r, j);
+		if (tx == r)
+		{
+			tx = l;
+			ti += l->count + 1;
+		}
+		if (!l->leaf)
+			for (size_t j = 0; j <= r->count; ++j)
+				set_child(l, l->count + 1 + j, child(r, j));
+		l->count = static_cast<unsigned char>(l->count + 1 + r->count);
+		r->count = 0;
+		delete_node(r);
+		close_slot(p, k);
+		if (tx == p && ti > k)
+			--ti;
+	}
+
+	/**
+	 * remove the element at (x, i). An element of an internal node is
+	 *   replaced by its predecessor, which always sits in a leaf.
+	 *   (tx, ti) is kept on the element it points to, if it is another one.
+	 */
+	void erase_at(node *x, size_t i, node* &tx, size_t &ti)
+	{
+		destroy(x, i);
+		if (!x->leaf)
+		{
+			node *y = child(x, i);
+			while (!y->leaf)
+				y = child(y, y->count);
+			relocate(x, i, y, y->count - 1);
+			follow(tx, ti, y, y->count - 1, x, i);
+			--y->count;
+			x = y;
+		}
+		else
+		{
+			for (size_t j = i; j + 1 < x->count; ++j)
+				relocate(x, j, x, j + 1);
+			if (tx == x && ti > i)
+				--ti;
+			--x->count;
+		}
+		--node_count;
+		rebalance(x, tx, ti);
+	}
+	void erase_at(node *x, size_t i)
+	{
+		node *tx = NULL;
+		size_t ti = 0;
+		erase_at(x, i, tx, ti);
+	}
+
+	node* leftmost() const
+	{
+		node *x = root;
+		if (x != NULL)
+			while (!x->leaf)
+				x = child(x, 0);
+		return x;
+	}
+
+	node* rightmost() const
+	{
+		node *x = root;
+		if (x != NULL)
+			while (!x->leaf)
+				x = child(x, x->count);
+		return x;
+	}
+
+	// step (x, i) to the next element; x becomes NULL past the last one.
+	static void next_pos(node* &x, size_t &i)
+	{
+		if (!x->leaf)
+		{
+			x = child(x, i + 1);
+			while (!x->leaf)
+				x = child(x, 0);
+			i = 0;
+			return;
+		}
+		++i;
+		while (i == x->count)
+		{
+			if (x->parent == NULL)
+			{
+				x = NULL;
+				i = 0;
+				return;
+			}
+			i = x->position;
+			x = x->parent;
+		}
+	}
+
+	// step (x, i) to the previous element; false if it is the first one.
+	bool prev_pos(node* &x, size_t &i) const
+	{
+		if (x == NULL)
+		{
+			x = rightmost();
+			if (x == NULL)
+				return false;
+			i = x->count - 1;
+			return true;
+		}
+		if (!x->leaf)
+		{
+			x = child(x, i);
+			while (!x->leaf)
+				x = child(x, x->count);
+			i = x->count - 1;
+			return true;
+		}
+		node *y = x;
+		size_t j = i;
+		while (j == 0)
+		{
+			if (y->parent == NULL)
+				return false;
+			j = y->position;
+			y = y->parent;
+		}
+		x = y;
+		i = j - 1;
+		return true;
+	}
+
+public:
+	/**
+	 * see BidirectionalIterator at CppReference for help.
+	 *
+	 * if there is anything wrong throw invalid_iterator.
+	 *     like it = map.begin(); --it;
+	 *       or it = map.end(); ++end();
+	 */
+	class const_iterator;
+	class iterator {
+		friend class btree_map;
+		friend class const_iterator;
+	private:
+		node *ptr; // NULL at end()
+		size_t pos;
+		const btree_map *container;
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef typename btree_map::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef value_type* pointer;
+		typedef value_type& reference;
+
+		iterator(node *p = NULL, size_t i = 0, const btree_map *c = NULL) : ptr(p), pos(i), container(c) {}
+		iterator(const iterator &other) = default;
+		iterator(const const_iterator &other) : ptr(other.ptr), pos(other.pos), container(other.container) {}
+		iterator & operator=(const iterator &rhs) = default;
+		iterator operator++(int)
+		{
+			iterator itr(*this);
+			++*this;
+			return itr;
+		}
+		iterator & operator++()
+		{
+			if (ptr == NULL)
+				throw invalid_iterator();
+			next_pos(ptr, pos);
+			return *this;
+		}
+		iterator operator--(int)
+		{
+			iterator itr(*this);
+			--*this;
+			return itr;
+		}
+		iterator & operator--()
+		{
+			if (container == NULL || !container->prev_pos(ptr, pos))
+				throw invalid_iterator();
+			return *this;
+		}
+		value_type & operator*() const
+		{
+			if (ptr == NULL)
+				throw invalid_iterator();
+			return ptr->value(pos);
+		}
+		value_type* operator->() const noexcept
+		{
+			return &ptr->value(pos);
+		}
+		bool operator==(const iterator &rhs) const
+		{
+			return ptr == rhs.ptr && pos == rhs.pos && container == rhs.container;
+		}
+		bool operator==(const const_iterator &rhs) const
+		{
+			return ptr == rhs.ptr && pos == rhs.pos && container == rhs.container;
+		}
+		bool operator!=(const iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+		bool operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+	class const_iterator {
+		friend class btree_map;
+		friend class iterator;
+	private:
+		node *ptr;
+		size_t pos;
+		const btree_map *container;
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef typename btree_map::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		const_iterator(node *p = NULL, size_t i = 0, const btree_map *c = NULL) : ptr(p), pos(i), container(c) {}
+		const_iterator(const const_iterator &other) = default;
+		const_iterator(const iterator &other) : ptr(other.ptr), pos(other.pos), container(other.container) {}
+		const_iterator & operator=(const const_iterator &rhs) = default;
+		const_iterator operator++(int)
+		{
+			const_iterator itr(*this);
+			++*this;
+			return itr;
+		}
+		const_iterator & operator++()
+		{
+			if (ptr == NULL)
+				throw invalid_iterator();
+			next_pos(ptr, pos);
+			return *this;
+		}
+		const_iterator operator--(int)
+		{
+			const_iterator itr(*this);
+			--*this;
+			return itr;
+		}
+		const_iterator & operator--()
+		{
+			if (container == NULL || !container->prev_pos(ptr, pos))
+				throw invalid_iterator();
+			return *this;
+		}
+		const value_type & operator*() const
+		{
+			if (ptr == NULL)
+				throw invalid_iterator();
+			return ptr->value(pos);
+		}
+		const value_type* operator->() const noexcept
+		{
+			return &ptr->value(pos);
+		}
+		bool operator==(const iterator &rhs) const
+		{
+			return ptr == rhs.ptr && pos == rhs.pos && container == rhs.container;
+		}
+		bool operator==(const const_iterator &rhs) const
+		{
+			return ptr == rhs.ptr && pos == rhs.pos && container == rhs.container;
+		}
+		bool operator!=(const iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+		bool operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+
+	btree_map() : compare_holder<Compare>(), leaf_alloc(), internal_alloc(), root(NULL), node_count(0) {}
+	explicit btree_map(const Compare &c, const Allocator &a = Allocator())
+		: compare_holder<Compare>(c), leaf_alloc(a), internal_alloc(a), root(NULL), node_count(0) {}
+	explicit btree_map(const Allocator &a) : compare_holder<Compare>(), leaf_alloc(a), internal_alloc(a), root(NULL), node_count(0) {}
+	btree_map(const btree_map &other)
+		: compare_holder<Compare>(other.comp()),
+		leaf_alloc(leaf_traits::select_on_container_copy_construction(other.leaf_alloc)),
+		internal_alloc(internal_traits::select_on_container_copy_construction(other.internal_alloc)),
+		root(NULL), node_count(0)
+	{
+		if (other.root != NULL)
+			root = copy_tree(other.root, NULL);
+		node_count = other.node_count;
+	}
+	btree_map & operator=(const btree_map &other)
+	{
+		if (this == &other)
+			return *this;
+		btree_map tmp(other);
+		swap(tmp);
+		return *this;
+	}
+	btree_map(btree_map &&other) noexcept(std::is_nothrow_copy_constructible<Compare>::value)
+		: compare_holder<Compare>(other.comp()), leaf_alloc(std::move(other.leaf_alloc)), internal_alloc(std::move(other.internal_alloc)),
+		root(other.root), node_count(other.node_count)
+	{
+		other.root = NULL;
+		other.node_count = 0;
+	}
+	btree_map & operator=(btree_map &&other) noexcept(std::is_nothrow_copy_assignable<Compare>::value)
+	{
+		if (this == &other)
+			return *this;
+		clear();
+		comp() = other.comp();
+		leaf_alloc = std::move(other.leaf_alloc);
+		internal_alloc = std::move(other.internal_alloc);
+		root = other.root;
+		node_count = other.node_count;
+		other.root = NULL;
+		other.node_count = 0;
+		return *this;
+	}
+	void swap(btree_map &other) noexcept(adl_swap::is_nothrow_swappable<Compare>::value)
+	{
+		using std::swap;
+		swap(comp(), other.comp());
+		swap(leaf_alloc, other.leaf_alloc);
+		swap(internal_alloc, other.internal_alloc);
+		swap(root, other.root);
+		swap(node_count, other.node_count);
+	}
+	~btree_map()
+	{
+		clear(root);
+	}
+
+	/**
+	 * access specified element with bounds checking
+	 * Returns a reference to the mapped value of the element with key equivalent to key.
+	 * If no such element exists, an exception of type `index_out_of_bound'
+	 */
+	T & at(const Key &key)
+	{
+		node *x;
+		size_t i;
+		if (!find_pos(key, x, i))
+			throw index_out_of_bound();
+		return x->value(i).second;
+	}
+	const T & at(const Key &key) const
+	{
+		node *x;
+		size_t i;
+		if (!find_pos(key, x, i))
+			throw index_out_of_bound();
+		return x->value(i).second;
+	}
+	/**
+	 * access specified element
+	 * Returns a reference to the value that is mapped to a key equivalent to key,
+	 *   performing an insertion if such key does not already exist.
+	 */
+	T & operator[](const Key &key)
+	{
+		return try_emplace(key).first->second;
+	}
+	T & operator[](Key &&key)
+	{
+		return try_emplace(std::move(key)).first->second;
+	}
+
+	iterator begin()
+	{
+		return iterator(leftmost(), 0, this);
+	}
+	const_iterator cbegin() const
+	{
+		return const_iterator(leftmost(), 0, this);
+	}
+	iterator end()
+	{
+		return iterator(NULL, 0, this);
+	}
+	const_iterator cend() const
+	{
+		return const_iterator(NULL, 0, this);
+	}
+	bool empty() const
+	{
+		return node_count == 0;
+	}
+	size_t size() const
+	{
+		return node_count;
+	}
+	void clear()
+	{
+		clear(root);
+		root = NULL;
+		node_count = 0;
+	}
+
+	/**
+	 * insert an element.
+	 * return a pair, the first of the pair is
+	 *   the iterator to the new element (or the element that prevented the insertion),
+	 *   the second one is true if insert successfully, or false.
+	 */
+	pair<iterator, bool> insert(const value_type &value)
+	{
+		return try_emplace(value.first, value.second);
+	}
+	pair<iterator, bool> insert(value_type &&value)
+	{
+		node *x;
+		size_t i;
+		if (!get_insert_pos(value.first, x, i))
+			return pair<iterator, bool>(iterator(x, i, this), false);
+		insert_at(x, i, std::move(value));
+		return pair<iterator, bool>(iterator(x, i, this), true);
+	}
+	template<class... Args>
+	pair<iterator, bool> emplace(Args&&... args)
+	{
+		Value tmp(std::forward<Args>(args)...);
+		return insert(std::move(tmp));
+	}
+	template<class... Args>
+	pair<iterator, bool> try_emplace(const Key &key, Args&&... args)
+	{
+		node *x;
+		size_t i;
+		if (!get_insert_pos(key, x, i))
+			return pair<iterator, bool>(iterator(x, i, this), false);
+		insert_at(x, i, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+		return pair<iterator, bool>(iterator(x, i, this), true);
+	}
+	template<class... Args>
+	pair<iterator, bool> try_emplace(Key &&key, Args&&... args)
+	{
+		node *x;
+		size_t i;
+		if (!get_insert_pos(key, x, i))
+			return pair<iterator, bool>(iterator(x, i, this), false);
+		insert_at(x, i, std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+		return pair<iterator, bool>(iterator(x, i, this), true);
+	}
+	template<class M>
+	pair<iterator, bool> insert_or_assign(const Key &key, M &&obj)
+	{
+		node *x;
+		size_t i;
+		if (!get_insert_pos(key, x, i))
+		{
+			x->value(i).second = std::forward<M>(obj);
+			return pair<iterator, bool>(iterator(x, i, this), false);
+		}
+		insert_at(x, i, key, std::forward<M>(obj));
+		return pair<iterator, bool>(iterator(x, i, this), true);
+	}
+
+	/**
+	 * erase the element at pos and return the iterator to the one after it.
+	 *
+	 * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+	 */
+	iterator erase(iterator pos)
+	{
+		if (pos.ptr == NULL || pos.container != this)
+			throw invalid_iterator();
+		node *x = pos.ptr;
+		size_t i = pos.pos;
+		next_pos(x, i);
+		// the successor may move while the tree is rebalanced; erase_at follows it.
+		erase_at(pos.ptr, pos.pos, x, i);
+		if (x == NULL)
+			return end();
+		return iterator(x, i, this);
+	}
+	/**
+	 * erase the element with key equivalent to key, if any.
+	 * return the number of elements removed (0 or 1).
+	 */
+	size_t erase(const Key &key)
+	{
+		node *x;
+		size_t i;
+		if (!find_pos(key, x, i))
+			return 0;
+		erase_at(x, i);
+		return 1;
+	}
+
+	/**
+	 * Returns the number of elements with key
+	 *   that compares equivalent to the specified argument,
+	 *   which is either 1 or 0
+	 *     since this container does not allow duplicates.
+	 */
+	size_t count(const Key &key) const
+	{
+		node *x;
+		size_t i;
+		return find_pos(key, x, i) ? 1 : 0;
+	}
+	bool contains(const Key &key) const
+	{
+		return count(key) != 0;
+	}
+	/**
+	 * Finds an element with key equivalent to key.
+	 *   If no such element is found, past-the-end (see end()) iterator is returned.
+	 */
+	iterator find(const Key &key)
+	{
+		node *x;
+		size_t i;
+		if (!find_pos(key, x, i))
+			return end();
+		return iterator(x, i, this);
+	}
+	const_iterator find(const Key &key) const
+	{
+		node *x;
+		size_t i;
+		if (!find_pos(key, x, i))
+			return cend();
+		return const_iterator(x, i, this);
+	}
+	iterator lower_bound(const Key &key)
+	{
+		node *x;
+		size_t i;
+		lower_bound_pos(key, x, i);
+		return iterator(x, i, this);
+	}
+	const_iterator lower_bound(const Key &key) const
+	{
+		node *x;
+		size_t i;
+		lower_bound_pos(key, x, i);
+		return const_iterator(x, i, this);
+	}
+	iterator upper_bound(const Key &key)
+	{
+		node *x;
+		size_t i;
+		upper_bound_pos(key, x, i);
+		return iterator(x, i, this);
+	}
+	const_iterator upper_bound(const Key &key) const
+	{
+		node *x;
+		size_t i;
+		upper_bound_pos(key, x, i);
+		return const_iterator(x, i, this);
+	}
+
+	Compare key_comp() const
+	{
+		return comp();
+	}
+	Allocator get_allocator() const
+	{
+		return Allocator(leaf_alloc);
+	}
+
+	/**
+	 * check the B-tree properties; throw runtime_error on the first one broken.
+	 */
+	void check_invariants() const
+	{
+		if (root == NULL)
+		{
+			if (node_count != 0)
+				throw runtime_error("btree_map: size of an empty tree");
+			return;
+		}
+		if (root->parent != NULL)
+			throw runtime_error("btree_map: root has a parent");
+		size_t n = 0;
+		int leaf_depth = -1;
+		check_subtree(root, 0, leaf_depth, n);
+		if (n != node_count)
+			throw runtime_error("btree_map: size does not match");
+	}
+
+private:
+	void check_subtree(const node *x, int depth, int &leaf_depth, size_t &n) const
+	{
+		if (x->count == 0 || x->count > max_values)
+			throw runtime_error("btree_map: bad node size");
+		for (size_t i = 1; i < x->count; ++i)
+			if (!comp()(x->value(i - 1).first, x->value(i).first))
+				throw runtime_error("btree_map: keys out of order in a node");
+		if (!keys_match(x, std::integral_constant<bool, packed_keys>()))
+			throw runtime_error("btree_map: packed keys differ from the slots");
+		n += x->count;
+		if (x->leaf)
+		{
+			if (leaf_depth == -1)
+				leaf_depth = depth;
+			else if (leaf_depth != depth)
+				throw runtime_error("btree_map: leaves on different levels");
+			return;
+		}
+		for (size_t i = 0; i <= x->count; ++i)
+		{
+			const node *c = child(x, i);
+			if (c->parent != x || c->position != i)
+				throw runtime_error("btree_map: bad parent link");
+			if (i > 0 && !comp()(x->value(i - 1).first, c->value(0).first))
+				throw runtime_error("btree_map: child below its separator");
+			if (i < x->count && !comp()(c->value(c->count - 1).first, x->value(i).first))
+				throw runtime_error("btree_map: child above its separator");
+			check_subtree(c, depth + 1, leaf_depth, n);
+		}
+	}
+	static bool keys_match(const node *x, std::true_type)
+	{
+		for (size_t i = 0; i < x->count; ++i)
+			if (x->keys[i] != x->value(i).first)
+				return false;
+		return true;
+	}
+	static bool keys_match(const node *, std::false_type)
+	{
+		return true;
+	}
+};
+
+template<class Key, class T, class Compare, class Allocator>
+void swap(btree_map<Key, T, Compare, Allocator> &lhs, btree_map<Key, T, Compare, Allocator> &rhs)
+	noexcept(noexcept(lhs.swap(rhs)))
+{
+	lhs.swap(rhs);
+}
+
+}
+
+#endif
@@ -0,0 +1,287 @@
+/**
+ * a map for many reader threads and a few writers
+ */
+#ifndef SJTU_CONCURRENT_MAP_HPP
+#define SJTU_CONCURRENT_MAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "persistent_tree.hpp"
+#include "persistent_map.hpp"
+
+namespace sjtu {
+
+/**
+ * concurrent_map keeps its elements in a persistent_tree and publishes the
+ *   current version through an atomic root pointer.
+ *
+ * readers never lock and never write to the tree: they announce themselves
+ *   in the current epoch, load the root and search an immutable version.
+ * writers take a mutex, build the next version by path copying and publish
+ *   it. The replaced versions are retired, and a batch of them is released
+ *   once every reader that entered before the last epoch flip has left.
+ *
+ * there are no iterators, since an element may be gone as soon as the read
+ *   ends: lookups copy the mapped value out, or hand it to a callback while
+ *   the version is pinned. snapshot() gives an iterable version.
+ *
+ * a write whose copy of a key or value throws publishes nothing and leaves
+ *   the map as it was.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>
+> class concurrent_map
+{
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+
+private:
+	typedef persistent_tree<Key, T, Compare> tree_type;
+	typedef typename tree_type::node node;
+
+	static const size_t slot_count = 64;
+	static const size_t retire_limit = 64;
+
+	// readers of even and odd epochs, one cache line per slot.
+	struct alignas(64) reader_slot
+	{
+		std::atomic<size_t> active[2];
+	};
+
+	tree_type tree;
+	std::atomic<node*> root;
+	std::atomic<size_t> elements;
+	std::atomic<size_t> epoch;
+	mutable reader_slot readers[slot_count];
+	mutable std::mutex write_lock;
+	std::vector<node*> retired;
+
+	static size_t thread_slot()
+	{
+		static std::atomic<size_t> next(0);
+		thread_local size_t slot = next.fetch_add(1, std::memory_order_relaxed) % slot_count;
+		return slot;
+	}
+
+	/**
+	 * a reader inside the current epoch; the version it loads stays alive until it leaves.
+	 */
+	class read_guard
+	{
+		std::atomic<size_t> *counter;
+	public:
+		explicit read_guard(const concurrent_map &m)
+		{
+			reader_slot &s = m.readers[thread_slot()];
+			while (true)
+			{
+				size_t e = m.epoch.load();
+				counter = &s.active[e & 1];
+				counter->fetch_add(1);
+				if (m.epoch.load() == e)
+					break;
+				counter->fetch_sub(1, std::memory_order_release);
+			}
+		}
+		read_guard(const read_guard &) = delete;
+		read_guard & operator=(const read_guard &) = delete;
+		~read_guard()
+		{
+			counter->fetch_sub(1, std::memory_order_release);
+		}
+	};
+
+	/**
+	 * flip the epoch, wait for the readers of the old one to leave,
+	 *   and release the versions retired before the flip.
+	 */
+	void synchronize()
+	{
+		size_t e = epoch.fetch_add(1);
+		for (size_t i = 0; i < slot_count; ++i)
+			while (readers[i].active[e & 1].load() != 0)
+				std::this_thread::yield();
+		for (size_t i = 0; i < retired.size(); ++i)
+			tree_type::release(retired[i]);
+		retired.clear();
+	}
+
+	// called with write_lock held.
+	void publish(node *old, node *r)
+	{
+		root.store(r, std::memory_order_release);
+		if (old == NULL)
+			return;
+		retired.push_back(old);
+		if (retired.size() >= retire_limit)
+			synchronize();
+	}
+
+public:
+	concurrent_map() : concurrent_map(Compare()) {}
+	explicit concurrent_map(const Compare &c) : tree(c), root(NULL), elements(0), epoch(0), retired()
+	{
+		// publish() runs after the new version is built and must not throw.
+		retired.reserve(retire_limit);
+		for (size_t i = 0; i < slot_count; ++i)
+		{
+			readers[i].active[0].store(0, std::memory_order_relaxed);
+			readers[i].active[1].store(0, std::memory_order_relaxed);
+		}
+	}
+	concurrent_map(const concurrent_map &) = delete;
+	concurrent_map & operator=(const concurrent_map &) = delete;
+	/**
+	 * no reader or writer may still be running.
+	 */
+	~concurrent_map()
+	{
+		for (size_t i = 0; i < retired.size(); ++i)
+			tree_type::release(retired[i]);
+		tree_type::release(root.load(std::memory_order_relaxed));
+	}
+
+	/**
+	 * a copy of the value mapped to key.
+	 * If no such element exists, an exception of type `index_out_of_bound'
+	 */
+	T at(const Key &key) const
+	{
+		read_guard guard(*this);
+		node *x = tree.find(root.load(std::memory_order_acquire), key);
+		if (x == NULL)
+			throw index_out_of_bound();
+		return x->data.second;
+	}
+
+	/**
+	 * copy the value mapped to key into value; false (value untouched) if key is not there.
+	 */
+	bool find(const Key &key, T &value) const
+	{
+		read_guard guard(*this);
+		node *x = tree.find(root.load(std::memory_order_acquire), key);
+		if (x == NULL)
+			return false;
+		value = x->data.second;
+		return true;
+	}
+
+	/**
+	 * call fn(const value_type &) on the element with key, if there is one,
+	 *   without copying it. fn runs inside the read: keep it short, and
+	 *   do not write to this map from it.
+	 */
+	template<class F>
+	bool visit(const Key &key, F fn) const
+	{
+		read_guard guard(*this);
+		node *x = tree.find(root.load(std::memory_order_acquire), key);
+		if (x == NULL)
+			return false;
+		fn(static_cast<const value_type &>(x->data));
+		return true;
+	}
+
+	size_t count(const Key &key) const
+	{
+		read_guard guard(*this);
+		return tree.find(root.load(std::memory_order_acquire), key) != NULL ? 1 : 0;
+	}
+
+	bool contains(const Key &key) const
+	{
+		return count(key) != 0;
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	size_t size() const
+	{
+		return elements.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * the current version as a persistent_map, in O(1): it can be iterated
+	 *   and read from any thread while writers go on.
+	 */
+	persistent_map<Key, T, Compare> snapshot() const
+	{
+		std::lock_guard<std::mutex> lock(write_lock);
+		return persistent_map<Key, T, Compare>(tree.key_comp(), tree_type::share(root.load(std::memory_order_relaxed)), elements.load(std::memory_order_relaxed));
+	}
+
+	/**
+	 * insert value unless its key is already there; true if it was inserted.
+	 */
+	bool insert(const value_type &value)
+	{
+		std::lock_guard<std::mutex> lock(write_lock);
+		node *old = root.load(std::memory_order_relaxed);
+		bool inserted;
+		node *r = tree.insert(old, false, inserted, value.first, value.second);
+		if (!inserted)
+			return false;
+		publish(old, r);
+		elements.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/**
+	 * map key to obj, replacing the old value if any; true if key was not there.
+	 */
+	bool insert_or_assign(const Key &key, const T &obj)
+	{
+		std::lock_guard<std::mutex> lock(write_lock);
+		node *old = root.load(std::memory_order_relaxed);
+		bool inserted;
+		node *r = tree.insert(old, true, inserted, key, obj);
+		publish(old, r);
+		if (inserted)
+			elements.fetch_add(1, std::memory_order_relaxed);
+		return inserted;
+	}
+
+	/**
+	 * erase the element with key; the number of elements erased (0 or 1).
+	 */
+	size_t erase(const Key &key)
+	{
+		std::lock_guard<std::mutex> lock(write_lock);
+		node *old = root.load(std::memory_order_relaxed);
+		bool erased;
+		node *r = tree.erase(old, key, erased);
+		if (!erased)
+			return 0;
+		publish(old, r);
+		elements.fetch_sub(1, std::memory_order_relaxed);
+		return 1;
+	}
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(write_lock);
+		node *old = root.load(std::memory_order_relaxed);
+		if (old == NULL)
+			return;
+		publish(old, NULL);
+		elements.store(0, std::memory_order_relaxed);
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,1094 @@
+/**
+ * a map kept in one sorted array
+ */
+#ifndef SJTU_FLAT_MAP_HPP
+#define SJTU_FLAT_MAP_HPP
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * flat_map has the interface of map, but keeps its elements in one array
+ *   sorted by key. A lookup is a branch-free binary search over the array
+ *   and a scan reads it front to back, so for small or read-mostly maps
+ *   both beat any node-based tree, and there is no allocation (or link)
+ *   per element.
+ *
+ * insert and erase move every element after the position, O(n); a batch
+ *   (insert_batch / erase_batch) is merged in one pass instead.
+ *
+ * elements move when the array changes, so insert and erase invalidate all
+ *   iterators and references, unlike map.
+ *
+ * the elements are built as pair<Key, T>, so moving one along the array
+ *   moves its key instead of copying it. When that move may throw, the
+ *   array is not changed in place: insert and erase copy it into a new one
+ *   and a throw leaves the map as it was.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>,
+	class Allocator = std::allocator<pair<const Key, T> >
+> class flat_map : private compare_holder<Compare>
+{
+	friend class iterator;
+	friend class const_iterator;
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+
+private:
+	typedef pair<const Key, T> Value;
+	// what a slot holds; it is handed out as a Value (as_mutable_key).
+	typedef pair<Key, T> Stored;
+	using compare_holder<Compare>::comp;
+
+	static const bool shift_in_place = std::is_nothrow_move_constructible<Stored>::value;
+
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Value> value_allocator;
+	typedef std::allocator_traits<value_allocator> value_traits;
+	value_allocator alloc;
+	Value *data;
+	size_t n;
+	size_t cap;
+
+	static Stored & stored(Value &v)
+	{
+		return as_mutable_key(v);
+	}
+
+	// build an element in the raw slot at.
+	template<class... Args>
+	static void construct(Value *at, Args&&... args)
+	{
+		::new (static_cast<void*>(at)) Stored(std::forward<Args>(args)...);
+	}
+	static void destroy(Value &v)
+	{
+		stored(v).~Stored();
+	}
+
+	// move the value in src into the raw slot dst, leaving src raw; only when shift_in_place.
+	static void relocate(Value *dst, Value &src) noexcept
+	{
+		construct(dst, std::move(stored(src)));
+		destroy(src);
+	}
+
+	void destroy_all()
+	{
+		for (size_t i = 0; i < n; ++i)
+			destroy(data[i]);
+		n = 0;
+	}
+
+	/**
+	 * a new array of c slots, filled front to back. It replaces the array of
+	 *   the map on take(); until then a throw frees it and what it holds.
+	 */
+	class fresh_array
+	{
+	private:
+		flat_map &m;
+		Value *p;
+		size_t c;
+		size_t k;
+
+	public:
+		fresh_array(flat_map &m, size_t c) : m(m), p(c == 0 ? NULL : value_traits::allocate(m.alloc, c)), c(c), k(0) {}
+		fresh_array(const fresh_array &) = delete;
+		fresh_array & operator=(const fresh_array &) = delete;
+		~fresh_array()
+		{
+			while (k > 0)
+				destroy(p[--k]);
+			if (p != NULL)
+				value_traits::deallocate(m.alloc, p, c);
+		}
+		template<class... Args>
+		void push(Args&&... args)
+		{
+			construct(p + k, std::forward<Args>(args)...);
+			++k;
+		}
+		// a copy of the old elements at [first, last), moved when that cannot throw.
+		void push_old(size_t first, size_t last)
+		{
+			for (; first < last; ++first)
+				push(std::move_if_noexcept(stored(m.data[first])));
+		}
+		void take()
+		{
+			m.destroy_all();
+			if (m.data != NULL)
+				value_traits::deallocate(m.alloc, m.data, m.cap);
+			m.data = p;
+			m.n = k;
+			m.cap = c;
+			p = NULL;
+			k = 0;
+		}
+	};
+
+	// move the elements into a new array of c slots (c >= n).
+	void reallocate(size_t c)
+	{
+		reallocate(c, std::integral_constant<bool, shift_in_place>());
+	}
+	void reallocate(size_t c, std::true_type)
+	{
+		Value *p = c == 0 ? NULL : value_traits::allocate(alloc, c);
+		for (size_t i = 0; i < n; ++i)
+			relocate(p + i, data[i]);
+		if (data != NULL)
+			value_traits::deallocate(alloc, data, cap);
+		data = p;
+		cap = c;
+	}
+	void reallocate(size_t c, std::false_type)
+	{
+		fresh_array a(*this, c);
+		a.push_old(0, n);
+		a.take();
+	}
+
+	// the capacity after growing to hold need elements.
+	size_t grown(size_t need) const
+	{
+		if (need <= cap)
+			return cap;
+		size_t c = cap < 4 ? 4 : cap * 2;
+		return c < need ? need : c;
+	}
+
+	void grow(size_t need)
+	{
+		if (need > cap)
+			reallocate(grown(need));
+	}
+
+	/**
+	 * the number of the len values at a whose key is less than key. The range
+	 *   is halved without a branch: the compare only decides which half's
+	 *   start becomes base, which the compiler turns into a conditional move.
+	 */
+	template<class K>
+	size_t lower_bound_in(const Value *a, size_t len, const K &key) const
+	{
+		if (len == 0)
+			return 0;
+		const Value *base = a;
+		while (len > 1)
+		{
+			size_t half = len / 2;
+			base = comp()(base[half].first, key) ? base + half : base;
+			len -= half;
+		}
+		return (base - a) + (comp()(base->first, key) ? 1 : 0);
+	}
+	template<class K>
+	size_t upper_bound_in(const Value *a, size_t len, const K &key) const
+	{
+		if (len == 0)
+			return 0;
+		const Value *base = a;
+		while (len > 1)
+		{
+			size_t half = len / 2;
+			base = comp()(key, base[half].first) ? base : base + half;
+			len -= half;
+		}
+		return (base - a) + (comp()(key, base->first) ? 0 : 1);
+	}
+
+	/**
+	 * the first index from lo on whose key is not less than key, found by
+	 *   doubling steps from lo and then a binary search: O(log d) for a
+	 *   distance d, so a sorted batch is placed in O(m log(n / m)).
+	 */
+	size_t gallop(size_t lo, const Key &key) const
+	{
+		size_t hi = lo, step = 1;
+		while (hi < n && comp()(data[hi].first, key))
+		{
+			lo = hi + 1;
+			hi += step;
+			step *= 2;
+		}
+		if (hi > n)
+			hi = n;
+		return lo + lower_bound_in(data + lo, hi - lo, key);
+	}
+
+	// the element with key, or NULL.
+	Value * find_value(const Key &key) const
+	{
+		size_t i = lower_bound_in(data, n, key);
+		if (i == n || comp()(key, data[i].first))
+			return NULL;
+		return data + i;
+	}
+
+	/**
+	 * put a value built from args at i, where it keeps the order. If
+	 *   building it throws, the map is left as it was.
+	 */
+	template<class... Args>
+	void insert_at(size_t i, Args&&... args)
+	{
+		insert_at(i, std::integral_constant<bool, shift_in_place>(), std::forward<Args>(args)...);
+	}
+	template<class... Args>
+	void insert_at(size_t i, std::true_type, Args&&... args)
+	{
+		if (n == cap)
+		{
+			// build the value before the array changes; moving it in cannot throw.
+			Stored tmp(std::forward<Args>(args)...);
+			grow(n + 1);
+			for (size_t j = n; j > i; --j)
+				relocate(data + j, data[j - 1]);
+			construct(data + i, std::move(tmp));
+		}
+		else
+		{
+			for (size_t j = n; j > i; --j)
+				relocate(data + j, data[j - 1]);
+			try
+			{
+				construct(data + i, std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				for (size_t j = i; j < n; ++j)
+					relocate(data + j, data[j + 1]);
+				throw;
+			}
+		}
+		++n;
+	}
+	template<class... Args>
+	void insert_at(size_t i, std::false_type, Args&&... args)
+	{
+		fresh_array a(*this, grown(n + 1));
+		a.push_old(0, i);
+		a.push(std::forward<Args>(args)...);
+		a.push_old(i, n);
+		a.take();
+	}
+
+	// erase the elements at [first, last).
+	void erase_range(size_t first, size_t last)
+	{
+		if (first != last)
+			erase_range(first, last, std::integral_constant<bool, shift_in_place>());
+	}
+	void erase_range(size_t first, size_t last, std::true_type)
+	{
+		for (size_t j = first; j < last; ++j)
+			destroy(data[j]);
+		for (size_t j = last; j < n; ++j)
+			relocate(data + first + (j - last), data[j]);
+		n -= last - first;
+	}
+	void erase_range(size_t first, size_t last, std::false_type)
+	{
+		fresh_array a(*this, cap);
+		a.push_old(0, first);
+		a.push_old(last, n);
+		a.take();
+	}
+
+	/**
+	 * merge the values get(it) of a sorted run [first, last) into the array.
+	 *   The new values (those whose key is not there and does not repeat in
+	 *   the run) are copied out first, so a throw leaves the map as it was;
+	 *   then the array is merged from the back, touching only the elements
+	 *   after the first new one (or, unless shift_in_place, into a new array).
+	 */
+	template<class ForwardIt, class Get>
+	size_t insert_sorted_run(ForwardIt first, ForwardIt last, size_t m, Get get)
+	{
+		if (m == 0)
+			return 0;
+		value_allocator fresh_alloc(alloc);
+		Value *fresh = value_traits::allocate(fresh_alloc, m);
+		std::vector<size_t> at;
+		size_t k = 0, pos = 0;
+		try
+		{
+			for (; first != last; ++first)
+			{
+				// the element as the batch holds it, which need not be a value_type.
+				auto &&v = get(first);
+				// a key repeating in the run: the first one was there or is in fresh.
+				if (k != 0 && !comp()(fresh[k - 1].first, v.first))
+					continue;
+				pos = gallop(pos, v.first);
+				if (pos < n && !comp()(v.first, data[pos].first))
+					continue;
+				construct(fresh + k, v);
+				++k;
+				at.push_back(pos);
+			}
+			if (k != 0)
+				merge_fresh(fresh, at, k, std::integral_constant<bool, shift_in_place>());
+		}
+		catch (...)
+		{
+			while (k > 0)
+				destroy(fresh[--k]);
+			value_traits::deallocate(fresh_alloc, fresh, m);
+			throw;
+		}
+		value_traits::deallocate(fresh_alloc, fresh, m);
+		return k;
+	}
+
+	// move fresh[j] in front of the old element at[j] for every j < k, leaving fresh raw.
+	void merge_fresh(Value *fresh, const std::vector<size_t> &at, size_t k, std::true_type)
+	{
+		grow(n + k);
+		// walk both from the back.
+		size_t i = n, j = k;
+		while (j > 0)
+		{
+			--j;
+			while (i > at[j])
+			{
+				--i;
+				relocate(data + i + j + 1, data[i]);
+			}
+			relocate(data + i + j, fresh[j]);
+		}
+		n += k;
+	}
+	// the same into a new array, copying where a move may throw.
+	void merge_fresh(Value *fresh, const std::vector<size_t> &at, size_t k, std::false_type)
+	{
+		fresh_array a(*this, grown(n + k));
+		size_t i = 0;
+		for (size_t j = 0; j < k; ++j)
+		{
+			a.push_old(i, at[j]);
+			i = at[j];
+			a.push(std::move_if_noexcept(stored(fresh[j])));
+		}
+		a.push_old(i, n);
+		a.take();
+		for (size_t j = 0; j < k; ++j)
+			destroy(fresh[j]);
+	}
+
+	/**
+	 * erase the keys get(it) of a sorted run [first, last) that are there,
+	 *   compacting the array in one pass (unless shift_in_place, copying the
+	 *   rest into a new array).
+	 */
+	template<class ForwardIt, class Get>
+	size_t erase_sorted_run(ForwardIt first, ForwardIt last, Get get)
+	{
+		return erase_sorted_run(first, last, get, std::integral_constant<bool, shift_in_place>());
+	}
+	template<class ForwardIt, class Get>
+	size_t erase_sorted_run(ForwardIt first, ForwardIt last, Get get, std::false_type)
+	{
+		std::vector<size_t> gone;
+		for (size_t pos = 0; first != last && pos < n; ++first)
+		{
+			pos = gallop(pos, get(first));
+			if (pos < n && !comp()(get(first), data[pos].first))
+				gone.push_back(pos++);
+		}
+		if (gone.empty())
+			return 0;
+		fresh_array a(*this, cap);
+		size_t r = 0;
+		for (size_t j = 0; j < gone.size(); ++j)
+		{
+			a.push_old(r, gone[j]);
+			r = gone[j] + 1;
+		}
+		a.push_old(r, n);
+		a.take();
+		return gone.size();
+	}
+	template<class ForwardIt, class Get>
+	size_t erase_sorted_run(ForwardIt first, ForwardIt last, Get get, std::true_type)
+	{
+		size_t pos = 0, w = n, r = 0;
+		// w is where the next kept element goes once the first one is erased, r the next unread.
+		for (; first != last && pos < n; ++first)
+		{
+			pos = gallop(pos, get(first));
+			if (pos == n || comp()(get(first), data[pos].first))
+				continue;
+			if (w == n)
+				w = r = pos;
+			for (; r < pos; ++r, ++w)
+				relocate(data + w, data[r]);
+			destroy(data[pos]);
+			r = ++pos;
+		}
+		if (w == n)
+			return 0;
+		for (; r < n; ++r, ++w)
+			relocate(data + w, data[r]);
+		size_t erased = n - w;
+		n = w;
+		return erased;
+	}
+
+public:
+	class const_iterator;
+	/**
+	 * a random access iterator into the array.
+	 */
+	class iterator {
+		friend class flat_map;
+		friend class const_iterator;
+	private:
+		Value *ptr;
+		const flat_map *container;
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef typename flat_map::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef value_type* pointer;
+		typedef value_type& reference;
+
+		iterator(Value *p = NULL, const flat_map *c = NULL) : ptr(p), container(c) {}
+		iterator(const iterator &other) = default;
+		iterator & operator=(const iterator &rhs) = default;
+		/**
+		 * return a new iterator which pointer n-next elements
+		 *   even if there are not enough elements, just return the answer.
+		 * as well as operator-
+		 */
+		iterator operator+(ptrdiff_t d) const
+		{
+			return iterator(ptr + d, container);
+		}
+		iterator operator-(ptrdiff_t d) const
+		{
+			return iterator(ptr - d, container);
+		}
+		iterator & operator+=(ptrdiff_t d)
+		{
+			ptr += d;
+			return *this;
+		}
+		iterator & operator-=(ptrdiff_t d)
+		{
+			ptr -= d;
+			return *this;
+		}
+		ptrdiff_t operator-(const iterator &rhs) const
+		{
+			return ptr - rhs.ptr;
+		}
+		iterator operator++(int)
+		{
+			iterator itr(*this);
+			++*this;
+			return itr;
+		}
+		iterator & operator++()
+		{
+			if (container == NULL || ptr == container->data + container->n)
+				throw invalid_iterator();
+			++ptr;
+			return *this;
+		}
+		iterator operator--(int)
+		{
+			iterator itr(*this);
+			--*this;
+			return itr;
+		}
+		iterator & operator--()
+		{
+			if (container == NULL || ptr == container->data)
+				throw invalid_iterator();
+			--ptr;
+			return *this;
+		}
+		value_type & operator*() const
+		{
+			if (container == NULL || ptr == container->data + container->n)
+				throw invalid_iterator();
+			return *ptr;
+		}
+		value_type* operator->() const noexcept
+		{
+			return ptr;
+		}
+		value_type & operator[](ptrdiff_t d) const
+		{
+			return *(*this + d);
+		}
+		bool operator==(const iterator &rhs) const
+		{
+			return ptr == rhs.ptr && container == rhs.container;
+		}
+		bool operator==(const const_iterator &rhs) const
+		{
+			return ptr == rhs.ptr && container == rhs.container;
+		}
+		bool operator!=(const iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+		bool operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+		bool operator<(const iterator &rhs) const
+		{
+			return ptr < rhs.ptr;
+		}
+		bool operator>(const iterator &rhs) const
+		{
+			return rhs < *this;
+		}
+		bool operator<=(const iterator &rhs) const
+		{
+			return !(rhs < *this);
+		}
+		bool operator>=(const iterator &rhs) const
+		{
+			return !(*this < rhs);
+		}
+	};
+	class const_iterator {
+		friend class flat_map;
+		friend class iterator;
+	private:
+		const Value *ptr;
+		const flat_map *container;
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef typename flat_map::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		const_iterator(const Value *p = NULL, const flat_map *c = NULL) : ptr(p), container(c) {}
+		const_iterator(const const_iterator &other) = default;
+		const_iterator(const iterator &other) : ptr(other.ptr), container(other.container) {}
+		const_iterator & operator=(const const_iterator &rhs) = default;
+		const_iterator operator+(ptrdiff_t d) const
+		{
+			return const_iterator(ptr + d, container);
+		}
+		const_iterator operator-(ptrdiff_t d) const
+		{
+			return const_iterator(ptr - d, container);
+		}
+		const_iterator & operator+=(ptrdiff_t d)
+		{
+			ptr += d;
+			return *this;
+		}
+		const_iterator & operator-=(ptrdiff_t d)
+		{
+			ptr -= d;
+			return *this;
+		}
+		ptrdiff_t operator-(const const_iterator &rhs) const
+		{
+			return ptr - rhs.ptr;
+		}
+		const_iterator operator++(int)
+		{
+			const_iterator itr(*this);
+			++*this;
+			return itr;
+		}
+		const_iterator & operator++()
+		{
+			if (container == NULL || ptr == container->data + container->n)
+				throw invalid_iterator();
+			++ptr;
+			return *this;
+		}
+		const_iterator operator--(int)
+		{
+			const_iterator itr(*this);
+			--*this;
+			return itr;
+		}
+		const_iterator & operator--()
+		{
+			if (container == NULL || ptr == container->data)
+				throw invalid_iterator();
+			--ptr;
+			return *this;
+		}
+		const value_type & operator*() const
+		{
+			if (container == NULL || ptr == container->data + container->n)
+				throw invalid_iterator();
+			return *ptr;
+		}
+		const value_type* operator->() const noexcept
+		{
+			return ptr;
+		}
+		const value_type & operator[](ptrdiff_t d) const
+		{
+			return *(*this + d);
+		}
+		bool operator==(const iterator &rhs) const
+		{
+			return ptr == rhs.ptr && container == rhs.container;
+		}
+		bool operator==(const const_iterator &rhs) const
+		{
+			return ptr == rhs.ptr && container == rhs.container;
+		}
+		bool operator!=(const iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+		bool operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+		bool operator<(const const_iterator &rhs) const
+		{
+			return ptr < rhs.ptr;
+		}
+		bool operator>(const const_iterator &rhs) const
+		{
+			return rhs < *this;
+		}
+		bool operator<=(const const_iterator &rhs) const
+		{
+			return !(rhs < *this);
+		}
+		bool operator>=(const const_iterator &rhs) const
+		{
+			return !(*this < rhs);
+		}
+	};
+
+	flat_map() : compare_holder<Compare>(), alloc(), data(NULL), n(0), cap(0) {}
+	explicit flat_map(const Compare &c, const Allocator &a = Allocator())
+		: compare_holder<Compare>(c), alloc(a), data(NULL), n(0), cap(0) {}
+	explicit flat_map(const Allocator &a) : compare_holder<Compare>(), alloc(a), data(NULL), n(0), cap(0) {}
+	/**
+	 * build the map from [first, last) in O(n).
+	 *   the range must be sorted by Compare and must not contain equal keys.
+	 */
+	template<class ForwardIt>
+	flat_map(sorted_unique_t, ForwardIt first, ForwardIt last, const Compare &c = Compare(), const Allocator &a = Allocator())
+		: compare_holder<Compare>(c), alloc(a), data(NULL), n(0), cap(0)
+	{
+		assign_sorted(first, last);
+	}
+	/**
+	 * the elements of a map, in O(n).
+	 */
+	template<class A, class Aug>
+	explicit flat_map(const map<Key, T, Compare, A, Aug> &other, const Allocator &a = Allocator())
+		: compare_holder<Compare>(other.key_comp()), alloc(a), data(NULL), n(0), cap(0)
+	{
+		assign_sorted_n(other.cbegin(), other.size());
+	}
+	flat_map(const flat_map &other)
+		: compare_holder<Compare>(other.comp()),
+		alloc(value_traits::select_on_container_copy_construction(other.alloc)),
+		data(NULL), n(0), cap(0)
+	{
+		assign_sorted_n(other.data, other.n);
+	}
+	flat_map & operator=(const flat_map &other)
+	{
+		if (this == &other)
+			return *this;
+		flat_map tmp(other);
+		swap(tmp);
+		return *this;
+	}
+	flat_map(flat_map &&other) noexcept(std::is_nothrow_copy_constructible<Compare>::value)
+		: compare_holder<Compare>(other.comp()), alloc(std::move(other.alloc)), data(other.data), n(other.n), cap(other.cap)
+	{
+		other.data = NULL;
+		other.n = 0;
+		other.cap = 0;
+	}
+	flat_map & operator=(flat_map &&other)
+		noexcept(std::is_nothrow_copy_constructible<Compare>::value && adl_swap::is_nothrow_swappable<Compare>::value)
+	{
+		if (this == &other)
+			return *this;
+		flat_map tmp(std::move(other));
+		swap(tmp);
+		return *this;
+	}
+	void swap(flat_map &other) noexcept(adl_swap::is_nothrow_swappable<Compare>::value)
+	{
+		using std::swap;
+		swap(comp(), other.comp());
+		swap(alloc, other.alloc);
+		swap(data, other.data);
+		swap(n, other.n);
+		swap(cap, other.cap);
+	}
+	~flat_map()
+	{
+		destroy_all();
+		if (data != NULL)
+			value_traits::deallocate(alloc, data, cap);
+	}
+
+	/**
+	 * the elements as a map, in O(n).
+	 */
+	map<Key, T, Compare, Allocator> to_map() const
+	{
+		return map<Key, T, Compare, Allocator>(sorted_unique, cbegin(), cend(), comp(), Allocator(alloc));
+	}
+
+	/**
+	 * access specified element with bounds checking
+	 * Returns a reference to the mapped value of the element with key equivalent to key.
+	 * If no such element exists, an exception of type `index_out_of_bound'
+	 */
+	T & at(const Key &key)
+	{
+		Value *v = find_value(key);
+		if (v == NULL)
+			throw index_out_of_bound();
+		return v->second;
+	}
+	const T & at(const Key &key) const
+	{
+		Value *v = find_value(key);
+		if (v == NULL)
+			throw index_out_of_bound();
+		return v->second;
+	}
+	/**
+	 * access specified element
+	 * Returns a reference to the value that is mapped to a key equivalent to key,
+	 *   performing an insertion if such key does not already exist.
+	 */
+	T & operator[](const Key &key)
+	{
+		return try_emplace(key).first->second;
+	}
+	T & operator[](Key &&key)
+	{
+		return try_emplace(std::move(key)).first->second;
+	}
+
+	iterator begin()
+	{
+		return iterator(data, this);
+	}
+	const_iterator cbegin() const
+	{
+		return const_iterator(data, this);
+	}
+	iterator end()
+	{
+		return iterator(data + n, this);
+	}
+	const_iterator cend() const
+	{
+		return const_iterator(data + n, this);
+	}
+	bool empty() const
+	{
+		return n == 0;
+	}
+	size_t size() const
+	{
+		return n;
+	}
+	size_t capacity() const
+	{
+		return cap;
+	}
+	void clear()
+	{
+		destroy_all();
+	}
+	/**
+	 * make room for c elements, so that inserts up to there do not move the array.
+	 */
+	void reserve(size_t c)
+	{
+		if (c > cap)
+			reallocate(c);
+	}
+	void shrink_to_fit()
+	{
+		if (n < cap)
+			reallocate(n);
+	}
+	/**
+	 * replace the contents with [first, last) in O(n).
+	 *   the range must be sorted by Compare and must not contain equal keys.
+	 *   If copying one throws, the map is left empty.
+	 */
+	template<class ForwardIt>
+	void assign_sorted(ForwardIt first, ForwardIt last)
+	{
+		assign_sorted_n(first, static_cast<size_t>(std::distance(first, last)));
+	}
+private:
+	template<class ForwardIt>
+	void assign_sorted_n(ForwardIt first, size_t count)
+	{
+		clear();
+		reserve(count);
+		try
+		{
+			for (; n < count; ++n, ++first)
+				construct(data + n, *first);
+		}
+		catch (...)
+		{
+			// also give the array back, as a constructor that throws here is not destroyed.
+			destroy_all();
+			reallocate(0);
+			throw;
+		}
+	}
+public:
+
+	/**
+	 * insert an element.
+	 * return a pair, the first of the pair is
+	 *   the iterator to the new element (or the element that prevented the insertion),
+	 *   the second one is true if insert successfully, or false.
+	 */
+	pair<iterator, bool> insert(const value_type &value)
+	{
+		return try_emplace(value.first, value.second);
+	}
+	pair<iterator, bool> insert(value_type &&value)
+	{
+		size_t i = lower_bound_in(data, n, value.first);
+		if (i < n && !comp()(value.first, data[i].first))
+			return pair<iterator, bool>(iterator(data + i, this), false);
+		insert_at(i, std::move(value));
+		return pair<iterator, bool>(iterator(data + i, this), true);
+	}
+	template<class... Args>
+	pair<iterator, bool> emplace(Args&&... args)
+	{
+		Value tmp(std::forward<Args>(args)...);
+		return insert(std::move(tmp));
+	}
+	template<class... Args>
+	pair<iterator, bool> try_emplace(const Key &key, Args&&... args)
+	{
+		size_t i = lower_bound_in(data, n, key);
+		if (i < n && !comp()(key, data[i].first))
+			return pair<iterator, bool>(iterator(data + i, this), false);
+		insert_at(i, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+		return pair<iterator, bool>(iterator(data + i, this), true);
+	}
+	template<class... Args>
+	pair<iterator, bool> try_emplace(Key &&key, Args&&... args)
+	{
+		size_t i = lower_bound_in(data, n, key);
+		if (i < n && !comp()(key, data[i].first))
+			return pair<iterator, bool>(iterator(data + i, this), false);
+		insert_at(i, std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+		return pair<iterator, bool>(iterator(data + i, this), true);
+	}
+	template<class M>
+	pair<iterator, bool> insert_or_assign(const Key &key, M &&obj)
+	{
+		size_t i = lower_bound_in(data, n, key);
+		if (i < n && !comp()(key, data[i].first))
+		{
+			data[i].second = std::forward<M>(obj);
+			return pair<iterator, bool>(iterator(data + i, this), false);
+		}
+		insert_at(i, key, std::forward<M>(obj));
+		return pair<iterator, bool>(iterator(data + i, this), true);
+	}
+
+	/**
+	 * erase the element at pos and return the iterator to the one after it.
+	 *
+	 * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+	 */
+	iterator erase(iterator pos)
+	{
+		if (pos.container != this || pos.ptr == data + n)
+			throw invalid_iterator();
+		size_t i = pos.ptr - data;
+		erase_range(i, i + 1);
+		return iterator(data + i, this);
+	}
+	/**
+	 * erase the elements in [first, last) and return last, which now
+	 *   points where first did.
+	 */
+	iterator erase(const_iterator first, const_iterator last)
+	{
+		if (first.container != this || last.container != this || last < first)
+			throw invalid_iterator();
+		size_t i = first.ptr - data;
+		erase_range(i, last.ptr - data);
+		return iterator(data + i, this);
+	}
+	/**
+	 * erase the element with key equivalent to key, if any.
+	 * return the number of elements removed (0 or 1).
+	 */
+	size_t erase(const Key &key)
+	{
+		Value *v = find_value(key);
+		if (v == NULL)
+			return 0;
+		size_t i = v - data;
+		erase_range(i, i + 1);
+		return 1;
+	}
+
+	/**
+	 * insert the values of [first, last) whose keys are not there yet (the
+	 *   first of equal keys in the batch wins), sorting the batch and merging
+	 *   it into the array in one pass; return the number inserted.
+	 */
+	template<class ForwardIt>
+	size_t insert_batch(ForwardIt first, ForwardIt last)
+	{
+		std::vector<ForwardIt> run;
+		for (; first != last; ++first)
+			run.push_back(first);
+		std::stable_sort(run.begin(), run.end(), [this](const ForwardIt &a, const ForwardIt &b) {
+			return comp()((*a).first, (*b).first);
+		});
+		return insert_sorted_run(run.begin(), run.end(), run.size(),
+			[](typename std::vector<ForwardIt>::iterator it) -> decltype(**it) { return **it; });
+	}
+	/**
+	 * insert_batch for a batch already sorted by strictly increasing key.
+	 */
+	template<class ForwardIt>
+	size_t insert_batch(sorted_unique_t, ForwardIt first, ForwardIt last)
+	{
+		return insert_sorted_run(first, last, static_cast<size_t>(std::distance(first, last)),
+			[](ForwardIt it) -> decltype(*it) { return *it; });
+	}
+	/**
+	 * erase every key of [first, last) that is there, in one pass;
+	 *   return the number of elements erased.
+	 */
+	template<class ForwardIt>
+	size_t erase_batch(ForwardIt first, ForwardIt last)
+	{
+		std::vector<ForwardIt> run;
+		for (; first != last; ++first)
+			run.push_back(first);
+		std::sort(run.begin(), run.end(), [this](const ForwardIt &a, const ForwardIt &b) {
+			return comp()(*a, *b);
+		});
+		return erase_sorted_run(run.begin(), run.end(),
+			[](typename std::vector<ForwardIt>::iterator it) -> decltype(**it) { return **it; });
+	}
+	/**
+	 * erase_batch for keys already sorted in increasing order.
+	 */
+	template<class ForwardIt>
+	size_t erase_batch(sorted_unique_t, ForwardIt first, ForwardIt last)
+	{
+		return erase_sorted_run(first, last, [](ForwardIt it) -> decltype(*it) { return *it; });
+	}
+
+	/**
+	 * Returns the number of elements with key
+	 *   that compares equivalent to the specified argument,
+	 *   which is either 1 or 0
+	 *     since this container does not allow duplicates.
+	 */
+	size_t count(const Key &key) const
+	{
+		return find_value(key) != NULL ? 1 : 0;
+	}
+	bool contains(const Key &key) const
+	{
+		return count(key) != 0;
+	}
+	/**
+	 * Finds an element with key equivalent to key.
+	 *   If no such element is found, past-the-end (see end()) iterator is returned.
+	 */
+	iterator find(const Key &key)
+	{
+		Value *v = find_value(key);
+		return v == NULL ? end() : iterator(v, this);
+	}
+	const_iterator find(const Key &key) const
+	{
+		Value *v = find_value(key);
+		return v == NULL ? cend() : const_iterator(v, this);
+	}
+	iterator lower_bound(const Key &key)
+	{
+		return iterator(data + lower_bound_in(data, n, key), this);
+	}
+	const_iterator lower_bound(const Key &key) const
+	{
+		return const_iterator(data + lower_bound_in(data, n, key), this);
+	}
+	iterator upper_bound(const Key &key)
+	{
+		return iterator(data + upper_bound_in(data, n, key), this);
+	}
+	const_iterator upper_bound(const Key &key) const
+	{
+		return const_iterator(data + upper_bound_in(data, n, key), this);
+	}
+	pair<iterator, iterator> equal_range(const Key &key)
+	{
+		return pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+	}
+	pair<const_iterator, const_iterator> equal_range(const Key &key) const
+	{
+		return pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+	}
+
+	Compare key_comp() const
+	{
+		return comp();
+	}
+	Allocator get_allocator() const
+	{
+		return Allocator(alloc);
+	}
+};
+
+template<class Key, class T, class Compare, class Allocator>
+void swap(flat_map<Key, T, Compare, Allocator> &lhs, flat_map<Key, T, Compare, Allocator> &rhs)
+	noexcept(noexcept(lhs.swap(rhs)))
+{
+	lhs.swap(rhs);
+}
+
+}
+
+#endif
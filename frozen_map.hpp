@@ -0,0 +1,456 @@
+/**
+ * an immutable map laid out for lookups
+ */
+#ifndef SJTU_FROZEN_MAP_HPP
+#define SJTU_FROZEN_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <utility>
+#include "utility.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+ * frozen_map holds a fixed set of elements (see map::freeze()) in
+ *   Eytzinger order: the implicit complete binary search tree whose node k
+ *   has its children at 2k and 2k + 1, stored breadth first in one array.
+ *
+ * the keys have an array of their own, so the top levels of the tree share
+ *   a few cache lines and the search touches nothing else. Each step of the
+ *   search is one compare added to the index, with no branch to mispredict,
+ *   and it prefetches the cache line holding the node's descendants four
+ *   levels down (for keys of 4 bytes; fewer levels for larger keys).
+ *
+ * the elements themselves lie in a second array, in the same order as the
+ *   keys. Iteration walks the implicit tree in order; ++ and -- are O(1)
+ *   amortized.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>
+> class frozen_map
+{
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+
+private:
+	static const size_t line_bytes = 64;
+	// the descendants of k some levels down, b k ... b k + b - 1, fill one line when aligned.
+	static const size_t keys_per_line =
+		sizeof(Key) > 32 ? 1 : sizeof(Key) > 16 ? 2 : sizeof(Key) > 8 ? 4 :
+		sizeof(Key) > 4 ? 8 : sizeof(Key) > 2 ? 16 : sizeof(Key) > 1 ? 32 : 64;
+
+	Compare comp;
+	size_t n;
+	void *key_block;
+	// keys[1 .. n] in Eytzinger order, keys[0] is never built; the array starts a cache line.
+	Key *keys;
+	// values[k - 1] is the element whose key is keys[k].
+	value_type *values;
+
+	// the in-order neighbours of node k in a tree of n nodes; 0 stands for none.
+	static size_t first_index(size_t n)
+	{
+		if (n == 0)
+			return 0;
+		size_t k = 1;
+		while (2 * k <= n)
+			k *= 2;
+		return k;
+	}
+	static size_t last_index(size_t n)
+	{
+		if (n == 0)
+			return 0;
+		size_t k = 1;
+		while (2 * k + 1 <= n)
+			k = 2 * k + 1;
+		return k;
+	}
+	static size_t next_index(size_t k, size_t n)
+	{
+		if (2 * k + 1 <= n)
+		{
+			k = 2 * k + 1;
+			while (2 * k <= n)
+				k *= 2;
+			return k;
+		}
+		// go up past every ancestor whose right subtree k was in.
+		while (k & 1)
+			k >>= 1;
+		return k >> 1;
+	}
+	static size_t prev_index(size_t k, size_t n)
+	{
+		if (2 * k <= n)
+		{
+			k = 2 * k;
+			while (2 * k + 1 <= n)
+				k = 2 * k + 1;
+			return k;
+		}
+		while (k > 1 && !(k & 1))
+			k >>= 1;
+		return k >> 1;
+	}
+
+	/**
+	 * the search walks down to a missing child; the last node where it went
+	 *   left is the answer. Going left appends a 0 bit to k and going right a
+	 *   1 bit, so that node is k with its trailing 1 bits and one 0 dropped.
+	 */
+	static size_t last_left_turn(size_t k)
+	{
+#if defined(__GNUC__)
+		return k >> (__builtin_ctzll(~static_cast<unsigned long long>(k)) + 1);
+#else
+		while (k & 1)
+			k >>= 1;
+		return k >> 1;
+#endif
+	}
+
+	void prefetch(size_t k) const
+	{
+#if defined(__GNUC__)
+		// the line may lie past the array; a prefetch never faults.
+		__builtin_prefetch(reinterpret_cast<const void*>(reinterpret_cast<uintptr_t>(keys) + k * keys_per_line * sizeof(Key)));
+#else
+		(void)k;
+#endif
+	}
+
+	// the index of the first key not less than key, 0 if there is none.
+	size_t lower_bound_index(const Key &key) const
+	{
+		size_t k = 1;
+		while (k <= n)
+		{
+			prefetch(k);
+			k = 2 * k + (comp(keys[k], key) ? 1 : 0);
+		}
+		return last_left_turn(k);
+	}
+	// the index of the first key greater than key, 0 if there is none.
+	size_t upper_bound_index(const Key &key) const
+	{
+		size_t k = 1;
+		while (k <= n)
+		{
+			prefetch(k);
+			k = 2 * k + (comp(key, keys[k]) ? 0 : 1);
+		}
+		return last_left_turn(k);
+	}
+
+	void allocate(size_t count)
+	{
+		n = count;
+		if (n == 0)
+		{
+			key_block = NULL;
+			keys = NULL;
+			values = NULL;
+			return;
+		}
+		key_block = ::operator new((n + 1) * sizeof(Key) + line_bytes);
+		uintptr_t p = reinterpret_cast<uintptr_t>(key_block);
+		keys = reinterpret_cast<Key*>((p + line_bytes - 1) / line_bytes * line_bytes);
+		try
+		{
+			values = static_cast<value_type*>(::operator new(n * sizeof(value_type)));
+		}
+		catch (...)
+		{
+			::operator delete(key_block);
+			throw;
+		}
+	}
+
+	void deallocate()
+	{
+		::operator delete(key_block);
+		::operator delete(values);
+	}
+
+	// destroy the first built elements, in order.
+	void destroy(size_t built)
+	{
+		size_t k = first_index(n);
+		for (size_t i = 0; i < built; ++i, k = next_index(k, n))
+		{
+			values[k - 1].~value_type();
+			keys[k].~Key();
+		}
+	}
+
+	/**
+	 * fill the tree from a sorted range of count elements, visiting the
+	 *   indices in order.
+	 */
+	template<class InputIt>
+	void build(InputIt first, size_t count)
+	{
+		allocate(count);
+		size_t built = 0;
+		try
+		{
+			for (size_t k = first_index(n); k != 0; k = next_index(k, n), ++first)
+			{
+				::new (static_cast<void*>(keys + k)) Key(first->first);
+				try
+				{
+					::new (static_cast<void*>(values + k - 1)) value_type(first->first, first->second);
+				}
+				catch (...)
+				{
+					keys[k].~Key();
+					throw;
+				}
+				++built;
+			}
+		}
+		catch (...)
+		{
+			destroy(built);
+			deallocate();
+			throw;
+		}
+	}
+
+public:
+	/**
+	 * a bidirectional iterator over the elements in key order.
+	 */
+	class const_iterator
+	{
+		friend class frozen_map;
+	private:
+		const frozen_map *container;
+		size_t k; // 0 is end()
+
+		const_iterator(const frozen_map *m, size_t index) : container(m), k(index) {}
+
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef typename frozen_map::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		const_iterator() : container(NULL), k(0) {}
+
+		const value_type & operator*() const
+		{
+			if (container == NULL || k == 0)
+				throw invalid_iterator();
+			return container->values[k - 1];
+		}
+		const value_type * operator->() const noexcept
+		{
+			return &container->values[k - 1];
+		}
+		const_iterator & operator++()
+		{
+			if (container == NULL || k == 0)
+				throw invalid_iterator();
+			k = next_index(k, container->n);
+			return *this;
+		}
+		const_iterator operator++(int)
+		{
+			const_iterator tmp = *this;
+			++*this;
+			return tmp;
+		}
+		/**
+		 * --end() is the last element; --begin() throws `invalid_iterator'.
+		 */
+		const_iterator & operator--()
+		{
+			if (container == NULL)
+				throw invalid_iterator();
+			size_t j = (k == 0) ? last_index(container->n) : prev_index(k, container->n);
+			if (j == 0)
+				throw invalid_iterator();
+			k = j;
+			return *this;
+		}
+		const_iterator operator--(int)
+		{
+			const_iterator tmp = *this;
+			--*this;
+			return tmp;
+		}
+		bool operator==(const const_iterator &rhs) const
+		{
+			return container == rhs.container && k == rhs.k;
+		}
+		bool operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+
+	frozen_map() : comp(), n(0), key_block(NULL), keys(NULL), values(NULL) {}
+	explicit frozen_map(const Compare &c) : comp(c), n(0), key_block(NULL), keys(NULL), values(NULL) {}
+	/**
+	 * build the map from [first, last) in O(n).
+	 *   the range must be sorted by Compare and must not contain equal keys.
+	 */
+	template<class ForwardIt>
+	frozen_map(sorted_unique_t, ForwardIt first, ForwardIt last, const Compare &c = Compare()) : comp(c)
+	{
+		build(first, static_cast<size_t>(std::distance(first, last)));
+	}
+	/**
+	 * the same from the count elements starting at first.
+	 */
+	template<class InputIt>
+	frozen_map(sorted_unique_t, InputIt first, size_t count, const Compare &c = Compare()) : comp(c)
+	{
+		build(first, count);
+	}
+	frozen_map(const frozen_map &other) : comp(other.comp)
+	{
+		build(other.begin(), other.n);
+	}
+	frozen_map(frozen_map &&other) noexcept
+		: comp(other.comp), n(other.n), key_block(other.key_block), keys(other.keys), values(other.values)
+	{
+		other.n = 0;
+		other.key_block = NULL;
+		other.keys = NULL;
+		other.values = NULL;
+	}
+	frozen_map & operator=(const frozen_map &other)
+	{
+		if (this == &other)
+			return *this;
+		frozen_map tmp(other);
+		swap(tmp);
+		return *this;
+	}
+	frozen_map & operator=(frozen_map &&other) noexcept
+	{
+		if (this == &other)
+			return *this;
+		frozen_map tmp(std::move(other));
+		swap(tmp);
+		return *this;
+	}
+	~frozen_map()
+	{
+		destroy(n);
+		deallocate();
+	}
+
+	void swap(frozen_map &other)
+	{
+		std::swap(comp, other.comp);
+		std::swap(n, other.n);
+		std::swap(key_block, other.key_block);
+		std::swap(keys, other.keys);
+		std::swap(values, other.values);
+	}
+
+	/**
+	 * access specified element with bounds checking
+	 * If no such element exists, an exception of type `index_out_of_bound'
+	 */
+	const T & at(const Key &key) const
+	{
+		const_iterator it = find(key);
+		if (it.k == 0)
+			throw index_out_of_bound();
+		return values[it.k - 1].second;
+	}
+
+	const_iterator begin() const
+	{
+		return const_iterator(this, first_index(n));
+	}
+	const_iterator cbegin() const
+	{
+		return begin();
+	}
+	const_iterator end() const
+	{
+		return const_iterator(this, 0);
+	}
+	const_iterator cend() const
+	{
+		return end();
+	}
+
+	bool empty() const
+	{
+		return n == 0;
+	}
+
+	size_t size() const
+	{
+		return n;
+	}
+
+	size_t count(const Key &key) const
+	{
+		return find(key).k != 0 ? 1 : 0;
+	}
+
+	bool contains(const Key &key) const
+	{
+		return count(key) != 0;
+	}
+
+	/**
+	 * the iterator to the element with key, or end() if there is none.
+	 */
+	const_iterator find(const Key &key) const
+	{
+		size_t k = lower_bound_index(key);
+		if (k != 0 && comp(key, keys[k]))
+			k = 0;
+		return const_iterator(this, k);
+	}
+
+	/**
+	 * the first element whose key is not less than key.
+	 */
+	const_iterator lower_bound(const Key &key) const
+	{
+		return const_iterator(this, lower_bound_index(key));
+	}
+
+	/**
+	 * the first element whose key is greater than key.
+	 */
+	const_iterator upper_bound(const Key &key) const
+	{
+		return const_iterator(this, upper_bound_index(key));
+	}
+
+	Compare key_comp() const
+	{
+		return comp;
+	}
+};
+
+template<class Key, class T, class Compare>
+void swap(frozen_map<Key, T, Compare> &lhs, frozen_map<Key, T, Compare> &rhs)
+{
+	lhs.swap(rhs);
+}
+
+}
+
+#endif
@@ -8,59 +8,351 @@
 
 //Red-Black Tree Version
 
+#include <algorithm>
 #include <functional>
+#include <iterator>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "utility.hpp"
 #include "exceptions.hpp"
+#include "frozen_map.hpp"
 
 namespace sjtu {
 
+/**
+ * stores a comparator; an empty one is kept as a base class so that it takes no space.
+ */
+template<class Compare, bool = std::is_empty<Compare>::value && !std::is_final<Compare>::value>
+class compare_holder : private Compare
+{
+protected:
+	compare_holder() : Compare() {}
+	explicit compare_holder(const Compare &c) : Compare(c) {}
+	Compare & comp()
+	{
+		return *this;
+	}
+	const Compare & comp() const
+	{
+		return *this;
+	}
+};
+
+template<class Compare>
+class compare_holder<Compare, false>
+{
+	Compare c;
+protected:
+	compare_holder() : c() {}
+	explicit compare_holder(const Compare &cmp) : c(cmp) {}
+	Compare & comp()
+	{
+		return c;
+	}
+	const Compare & comp() const
+	{
+		return c;
+	}
+};
+
+/**
+ * whether swapping two comparators, the way the containers do it (std::swap
+ *   unless Compare has a swap of its own), cannot throw.
+ */
+namespace adl_swap {
+using std::swap;
+template<class T>
+struct is_nothrow_swappable
+	: std::integral_constant<bool, noexcept(swap(std::declval<T&>(), std::declval<T&>()))> {};
+}
+
+/**
+ * node update policies for map.
+ * every node carries a policy-defined summary of its subtree, which
+ *   update() recomputes from the node's value and its children's summaries
+ *   (NULL for a missing child) whenever the shape below the node changes.
+ *   has_size tells whether the summary has a member size counting the
+ *   nodes of the subtree, which enables the order-statistic operations.
+ */
+struct no_augment
+{
+	struct summary {};
+	static const bool has_size = false;
+	template<class Value>
+	static void update(summary &, const Value &, const summary *, const summary *) {}
+};
+
+/**
+ * keeps subtree sizes: rank, select, distance and iterator + n run in O(log n).
+ */
+struct order_statistic
+{
+	struct summary
+	{
+		size_t size;
+	};
+	static const bool has_size = true;
+	template<class Value>
+	static void update(summary &s, const Value &, const summary *l, const summary *r)
+	{
+		s.size = 1 + (l == NULL ? 0 : l->size) + (r == NULL ? 0 : r->size);
+	}
+};
+
+/**
+ * keeps a user-defined monoid of the elements of every subtree,
+ *   which lets map::aggregate(lo, hi) fold a key range in O(log n).
+ * Monoid has to provide
+ *   typedef ... value_type;
+ *   static value_type identity();
+ *   static value_type lift(const Key &key, const T &value);
+ *   static value_type combine(const value_type &a, const value_type &b); // associative
+ * combine is always applied in key order, so it need not be commutative.
+ * the map cannot see a mapped value being changed through a reference
+ *   (operator[], at, an iterator); call map::refresh(it) afterwards.
+ *   insert_or_assign does this by itself.
+ */
+template<class Monoid>
+struct monoid_augment
+{
+	typedef Monoid monoid;
+	struct summary
+	{
+		typename Monoid::value_type value;
+	};
+	static const bool has_size = false;
+	template<class Value>
+	static void update(summary &s, const Value &v, const summary *l, const summary *r)
+	{
+		s.value = Monoid::lift(v.first, v.second);
+		if (l != NULL)
+			s.value = Monoid::combine(l->value, s.value);
+		if (r != NULL)
+			s.value = Monoid::combine(s.value, r->value);
+	}
+};
+
 template<
 	class Key,
 	class T,
-	class Compare = std::less<Key>
-> class map
+	class Compare = std::less<Key>,
+	class Allocator = std::allocator<pair<const Key, T> >,
+	class Augment = no_augment
+> class map : private compare_holder<Compare>
 {
 	friend class iteraotr;
 	friend class const_iterator;
+	// small_map compares its inline elements with the comparator of the map it spills into.
+	template<class, class, class, size_t, class> friend class small_map;
+	// defined by the tests only, to build shapes that no sequence of inserts can make.
+	friend struct map_test_access;
 private:
 	typedef pair<const Key, T> Value;
-	struct node
+	using compare_holder<Compare>::comp;
+	/**
+	 * the color is kept in the lowest bit of the parent pointer, which is
+	 *   always 0 since nodes are pointer aligned. The header is told apart
+	 *   from the other nodes by its address, so no flag is needed for it.
+	 */
+	typedef typename Augment::summary summary_type;
+	struct node;
+	// the links of a node, all that the header has.
+	struct node_links
 	{
-		Value data;
 		node *left;
 		node *right;
-		node *parent;
-		int color; //red:0, black:1
-		bool is_end;
-		node(const Value &v, node *l = NULL, node *r = NULL,node *p = NULL, int c = 0, bool b = false) :data(v),left(l), right(r), parent(p), color(c), is_end(b) {}
+		uintptr_t parent_color; //red:0, black:1
+		node_links() : left(NULL), right(NULL), parent_color(0) {}
+		node* parent() const
+		{
+			return reinterpret_cast<node*>(parent_color & ~static_cast<uintptr_t>(1));
+		}
+		void set_parent(node *p)
+		{
+			parent_color = reinterpret_cast<uintptr_t>(p) | (parent_color & 1);
+		}
+		int color() const
+		{
+			return static_cast<int>(parent_color & 1);
+		}
+		void set_color(int c)
+		{
+			parent_color = (parent_color & ~static_cast<uintptr_t>(1)) | static_cast<uintptr_t>(c);
+		}
+	};
+	// an empty summary (no_augment) adds nothing to the node.
+	struct node : public node_links, public summary_type
+	{
+		Value data;
+		template<class... Args>
+		node(Args&&... args) : node_links(), summary_type(), data(std::forward<Args>(args)...) {}
 		~node() {}
 	};
+	typedef typename std::allocator_traits<Allocator>::template rebind_alloc<node> node_allocator;
+	typedef std::allocator_traits<node_allocator> node_traits;
+	node_allocator alloc;
 	node *root;
 	node *header;
 	size_t node_count;
+	/**
+	 * the header lives inside the map so that a move never has to allocate a
+	 *   new one. Only its links are ever used, so only they are stored.
+	 */
+	node_links header_storage;
+
+	template<class... Args>
+	node* create_node(Args&&... args)
+	{
+		node *n = node_traits::allocate(alloc, 1);
+		try
+		{
+			node_traits::construct(alloc, n, std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			node_traits::deallocate(alloc, n, 1);
+			throw;
+		}
+		return n;
+	}
 
+	void destroy_node(node *n)
+	{
+		node_traits::destroy(alloc, n);
+		node_traits::deallocate(alloc, n, 1);
+	}
+
+	// the header has no summary and no data; nothing may read them.
 	void init()
 	{
-		void *tmp = operator new(sizeof(node));
-		header = reinterpret_cast<node*>(tmp);
-		header->parent = root;
+		header = static_cast<node*>(&header_storage);
+		header->parent_color = 0;
+		header->set_parent(root);
 		header->left = header;
 		header->right = header;
-		header->is_end = true;
-		header->color = 0;
 	}
 
-	void clear(node *n)
+	/**
+	 * hang the tree r (with the given extreme nodes and size) under this header.
+	 */
+	void set_tree(node *r, node *leftmost, node *rightmost, size_t n)
 	{
-		if (n == NULL)
+		root = r;
+		node_count = n;
+		header->set_parent(r);
+		if (r == NULL)
+		{
+			header->left = header;
+			header->right = header;
+		}
+		else
+		{
+			header->left = leftmost;
+			header->right = rightmost;
+			r->set_parent(header);
+		}
+	}
+
+	// take over the whole tree of other, leaving it empty. this must be empty.
+	void steal(map &other) noexcept
+	{
+		set_tree(other.root, other.header->left, other.header->right, other.node_count);
+		other.set_tree(NULL, NULL, NULL, 0);
+	}
+
+	void move_assign(map &other, std::true_type)
+	{
+		clear();
+		alloc = std::move(other.alloc);
+		steal(other);
+	}
+
+	void move_assign(map &other, std::false_type)
+	{
+		clear();
+		if (alloc == other.alloc)
 		{
+			steal(other);
 			return;
 		}
-		clear(n->left);
-		clear(n->right);
-		delete n;
-		n = NULL;
+		// the nodes belong to an allocator we may not use, so move element by element.
+		for (iterator it = other.begin(); it != other.end(); ++it)
+			insert(std::move(*it));
+		other.clear();
+	}
+
+	static void swap_alloc(node_allocator &a, node_allocator &b, std::true_type)
+	{
+		using std::swap;
+		swap(a, b);
+	}
+	static void swap_alloc(node_allocator &, node_allocator &, std::false_type) {}
+
+	typedef std::integral_constant<bool, !std::is_empty<summary_type>::value> augmented;
+
+	static const summary_type* summary_of(const node *x)
+	{
+		return x == NULL ? NULL : static_cast<const summary_type*>(x);
+	}
+
+	static size_t size_of(const node *x)
+	{
+		return x == NULL ? 0 : static_cast<const summary_type*>(x)->size;
+	}
+
+	void update_summary(node *x)
+	{
+		Augment::update(*static_cast<summary_type*>(x), x->data, summary_of(x->left), summary_of(x->right));
+	}
+
+	// recompute the summaries from x up to the root; nothing to do without augmentation.
+	void update_path(node *x)
+	{
+		update_path(x, augmented());
+	}
+	void update_path(node *x, std::true_type)
+	{
+		for (; x != header; x = x->parent())
+			update_summary(x);
+	}
+	void update_path(node *, std::false_type) {}
+
+	template<class A>
+	static auto reserve_nodes(A &a, size_t n, int) -> decltype(a.reserve(n), void())
+	{
+		a.reserve(n);
+	}
+	template<class A>
+	static void reserve_nodes(A &, size_t, long) {}
+
+	/**
+	 * destroy the subtree n without recursion: whenever the current node has a
+	 *   left child it is rotated up, otherwise the node is freed and we go right.
+	 *   every rotation moves one node off the left spine, so this is O(n).
+	 */
+	void clear(node *n)
+	{
+		while (n != NULL)
+		{
+			if (n->left != NULL)
+			{
+				node *l = n->left;
+				n->left = l->right;
+				l->right = n;
+				n = l;
+			}
+			else
+			{
+				node *r = n->right;
+				destroy_node(n);
+				n = r;
+			}
+		}
 	}
 
 	node* minimum(node *x)
@@ -82,20 +374,22 @@ private:
 		node *y = x->right;
 		x->right = y->left;
 		if (y->left != NULL)
-			y->left->parent = x;
-		y->parent = x->parent;
-		if (x->parent == header)
+			y->left->set_parent(x);
+		y->set_parent(x->parent());
+		if (x->parent() == header)
 		{
 			root = y;
-			header->parent = y;
-			root->parent = header;
+			header->set_parent(y);
+			root->set_parent(header);
 		}
-		else if (x == x->parent->left)
-			x->parent->left = y;
+		else if (x == x->parent()->left)
+			x->parent()->left = y;
 		else
-			x->parent->right = y;
+			x->parent()->right = y;
 		y->left = x;
-		x->parent = y;
+		x->set_parent(y);
+		update_summary(x);
+		update_summary(y);
 	}
 
 	void rightRotate(node *y)
@@ -103,73 +397,78 @@ private:
 		node *x = y->left;
 		y->left = x->right;
 		if (x->right != NULL)
-			x->right->parent = y;
-		x->parent = y->parent;
-		if (y->parent == header)
+			x->right->set_parent(y);
+		x->set_parent(y->parent());
+		if (y->parent() == header)
 		{
 			root = x;
-			header->parent = x;
-			root->parent = header;
+			header->set_parent(x);
+			root->set_parent(header);
 		}
-		else if (y == y->parent->left)
-			y->parent->left = x;
+		else if (y == y->parent()->left)
+			y->parent()->left = x;
 		else
-			y->parent->right = x;
+			y->parent()->right = x;
 		x->right = y;
-		y->parent = x;
+		y->set_parent(x);
+		update_summary(y);
+		update_summary(x);
 	}
 
-	void insert_rebalance(node *x)
+	// returns whether the black height of the tree went up, i.e. the root turned red.
+	bool insert_rebalance(node *x)
 	{
-		x->color = 0;
-		while (x != root && x->parent->color == 0)
+		x->set_color(0);
+		while (x != root && x->parent()->color() == 0)
 		{
-			if (x->parent == x->parent->parent->left)
+			if (x->parent() == x->parent()->parent()->left)
 			{
-				node *y = x->parent->parent->right;
-				if (y != NULL && y->color == 0)
+				node *y = x->parent()->parent()->right;
+				if (y != NULL && y->color() == 0)
 				{
-					x->parent->color = 1;
-					y->color = 1;
-					x->parent->parent->color = 0;
-					x = x->parent->parent;
+					x->parent()->set_color(1);
+					y->set_color(1);
+					x->parent()->parent()->set_color(0);
+					x = x->parent()->parent();
 				}
 				else
 				{
-					if (x == x->parent->right)
+					if (x == x->parent()->right)
 					{
-						x = x->parent;
+						x = x->parent();
 						leftRotate(x);
 					}
-					x->parent->color = 1;
-					x->parent->parent->color = 0;
-					rightRotate(x->parent->parent);
+					x->parent()->set_color(1);
+					x->parent()->parent()->set_color(0);
+					rightRotate(x->parent()->parent());
 				}
 			}
 			else
 			{
-				node *y = x->parent->parent->left;
-				if (y != NULL && y->color == 0)
+				node *y = x->parent()->parent()->left;
+				if (y != NULL && y->color() == 0)
 				{
-					x->parent->color = 1;
-					y->color = 1;
-					x->parent->parent->color = 0;
-					x = x->parent->parent;
+					x->parent()->set_color(1);
+					y->set_color(1);
+					x->parent()->parent()->set_color(0);
+					x = x->parent()->parent();
 				}
 				else
 				{
-					if (x == x->parent->left)
+					if (x == x->parent()->left)
 					{
-						x = x->parent;
+						x = x->parent();
 						rightRotate(x);
 					}
-					x->parent->color = 1;
-					x->parent->parent->color = 0;
-					leftRotate(x->parent->parent);
+					x->parent()->set_color(1);
+					x->parent()->parent()->set_color(0);
+					leftRotate(x->parent()->parent());
 				}
 			}
 		}
-		root->color = 1;
+		bool grew = root->color() == 0;
+		root->set_color(1);
+		return grew;
 	}
 
 	node* erase_rebalance(node* z)
@@ -192,92 +491,99 @@ private:
 			}
 			if (y != z)
 			{
-				z->left->parent = y;
+				z->left->set_parent(y);
 				y->left = z->left;
 				if (y != z->right)
 				{
-					x_parent = y->parent;
-					if (x) x->parent = y->parent;
-					y->parent->left = x;
+					x_parent = y->parent();
+					if (x) x->set_parent(y->parent());
+					y->parent()->left = x;
 					y->right = z->right;
-					z->right->parent = y;
+					z->right->set_parent(y);
 				}
 				else
 					x_parent = y;
 				if (root == z)
+				{
 					root = y;
-				else if (z->parent->left == z)
-					z->parent->left = y;
+					header->set_parent(root);
+				}
+				else if (z->parent()->left == z)
+					z->parent()->left = y;
 				else
-					z->parent->right = y;
-				y->parent = z->parent;
-				tmp = y->color;
-				y->color = z->color;
-				z->color = tmp;
+					z->parent()->right = y;
+				y->set_parent(z->parent());
+				tmp = y->color();
+				y->set_color(z->color());
+				z->set_color(tmp);
 				y = z;
 
 			}
 			else
 			{
-				x_parent = y->parent;
-				if (x) x->parent = y->parent;
+				x_parent = y->parent();
+				if (x) x->set_parent(y->parent());
 				if (root == z)
+				{
 					root = x;
+					header->set_parent(root);
+				}
 				else
-					if (z->parent->left == z)
-						z->parent->left = x;
+					if (z->parent()->left == z)
+						z->parent()->left = x;
 					else
-						z->parent->right = x;
+						z->parent()->right = x;
 				if (header->left == z)
 					if (z->right == NULL)
-						header->left = z->parent;
+						header->left = z->parent();
 
 					else
 						header->left = minimum(x);
 				if (header->right == z)
 					if (z->left == NULL)
-						header->right = z->parent;
+						header->right = z->parent();
 
 					else
 						header->right = maximum(x);
 			}
-			if (y->color != 0)
+			update_path(x_parent);
+			if (y->color() != 0)
 			{
-				while (x != root && (x == NULL || x->color == 1))
+				while (x != root && (x == NULL || x->color() == 1))
 				{
 					if (x == x_parent->left)
 					{
 						node* w = x_parent->right;
-						if (w->color == 0)
+						if (w->color() == 0)
 						{
-							w->color = 1;
-							x_parent->color = 0;
+							w->set_color(1);
+							x_parent->set_color(0);
 							leftRotate(x_parent);
 							w = x_parent->right;
 						}
 						if ((w->left == NULL ||
-							w->left->color == 1) &&
+							w->left->color() == 1) &&
 							(w->right == NULL ||
-								w->right->color == 1))
+								w->right->color() == 1))
 						{
-							w->color = 0;
+							w->set_color(0);
 							x = x_parent;
-							x_parent = x_parent->parent;
+							x_parent = x_parent->parent();
 						}
 						else
 						{
-							if (w->right == NULL || w->right->color == 1)
+							if (w->right == NULL || w->right->color() == 1)
 							{
 								if (w->left != NULL)
-									w->left->color = 1;
-								w->color = 0;
+									w->left->set_color(1);
+								w->set_color(0);
 								rightRotate(w);
 								w = x_parent->right;
 							}
-							w->color = x_parent->color;
-							x_parent->color = 1;
+							w->set_color(x_parent->color());
+							x_parent->set_color(1);
 							if (w->right != NULL)
-								w->right->color = 1;
+								w->right->set_color(1);
 							leftRotate(x_parent);
 							break;
 						}
@@ -285,171 +591,697 @@ private:
 					else
 					{
 						node* w = x_parent->left;
-						if (w->color == 0)
+						if (w->color() == 0)
 						{
-							w->color = 1;
-							x_parent->color = 0;
+							w->set_color(1);
+							x_parent->set_color(0);
 							rightRotate(x_parent);
 							w = x_parent->left;
 						}
-						if ((w->right == NULL || w->right->color == 1) &&
+						if ((w->right == NULL || w->right->color() == 1) &&
 							(w->left == NULL ||
-								w->left->color == 1))
+								w->left->color() == 1))
 						{
-							w->color = 0;
+							w->set_color(0);
 							x = x_parent;
-							x_parent = x_parent->parent;
+							x_parent = x_parent->parent();
 						}
 						else
 						{
-							if (w->left == NULL || w->left->color == 1)
+							if (w->left == NULL || w->left->color() == 1)
 							{
 								if (w->right != NULL)
-									w->right->color = 1;
-								w->color = 0;
+									w->right->set_color(1);
+								w->set_color(0);
 								leftRotate(w);
 								w = x_parent->left;
 							}
-							w->color = x_parent->color;
-							x_parent->color = 1;
+							w->set_color(x_parent->color());
+							x_parent->set_color(1);
 							if (w->left != NULL)
-								w->left->color = 1;
+								w->left->set_color(1);
 							rightRotate(x_parent);
 							break;
 						}
 					}
 				}
 				if (x != NULL)
-					x->color = 1;
+					x->set_color(1);
 			}
 			return y;
 	}
 
-	void copy_tree(node *n, node* &x, node *y)
+	node* clone_node(node *n, node *p)
+	{
+		node *x = create_node(n->data);
+		x->set_parent(p);
+		x->set_color(n->color());
+		*static_cast<summary_type*>(x) = *static_cast<const summary_type*>(n);
+		return x;
+	}
+
+	/**
+	 * copy the subtree n in pre-order, hanging it under p.
+	 *   the walk follows the parent pointers of both trees instead of recursing;
+	 *   a child of the copy that is still NULL marks a side not copied yet.
+	 *   the copies of the nodes first and last are stored in leftmost / rightmost.
+	 */
+	node* copy_tree(node *n, node *p, node *first, node *last, node* &leftmost, node* &rightmost)
 	{
 		if (n == NULL)
+			return NULL;
+		node *top = clone_node(n, p);
+		node *s = n, *d = top;
+		try
 		{
-			return;
+			while (true)
+			{
+				if (s == first)
+					leftmost = d;
+				if (s == last)
+					rightmost = d;
+				if (s->left != NULL && d->left == NULL)
+				{
+					d->left = clone_node(s->left, d);
+					s = s->left;
+					d = d->left;
+				}
+				else if (s->right != NULL && d->right == NULL)
+				{
+					d->right = clone_node(s->right, d);
+					s = s->right;
+					d = d->right;
+				}
+				else
+				{
+					while (s != n && (s == s->parent()->right || s->parent()->right == NULL))
+					{
+						s = s->parent();
+						d = d->parent();
+					}
+					if (s == n)
+						break;
+					s = s->parent();
+					d = d->parent();
+				}
+			}
+		}
+		catch (...)
+		{
+			clear(top);
+			throw;
 		}
-		x = new node(n->data);
-		x->parent = y;
-		x->is_end = n->is_end;
-		x->color = n->color;
-		copy_tree(n->left, x->left, x);
-		copy_tree(n->right, x->right, x);
+		return top;
 	}
 
-public:
-	/**
-	 * the internal type of data.
-	 * it should have a default constructor, a copy constructor.
-	 * You can use sjtu::map as value_type by typedef.
-	 */
-	typedef pair<const Key, T> value_type;
 	/**
-	 * see BidirectionalIterator at CppReference for help.
-	 *
-	 * if there is anything wrong throw invalid_iterator.
-	 *     like it = map.begin(); --it;
-	 *       or it = map.end(); ++end();
+	 * build a balanced tree from the next n elements of it, hanging it under p.
+	 *   the left subtree gets (n - 1) / 2 elements, so all the empty links lie on
+	 *   the two deepest levels; the nodes on level red_depth are the only red ones.
 	 */
-	class const_iterator;
-	class iterator {
-		friend class map;
-		friend class const_iterator;
-	private:
-		/**
-		 * TODO add data members
-		 *   just add whatever you want.
-		 */
-		node *ptr;
-		const map *container;
-	public:
-		iterator(node *p = NULL, const map *c = NULL) :ptr(p), container(c)
+	template<class ForwardIt>
+	node* build_sorted(ForwardIt &it, size_t n, size_t depth, size_t red_depth, node *p)
+	{
+		if (n == 0)
+			return NULL;
+		size_t nl = (n - 1) / 2;
+		node *l = build_sorted(it, nl, depth + 1, red_depth, NULL);
+		node *x;
+		try
 		{
-			// TODO
+			x = create_node(*it);
 		}
-		iterator(const iterator &other)
+		catch (...)
 		{
-			// TODO
-			ptr = other.ptr;
-			container = other.container;
+			clear(l);
+			throw;
 		}
-		iterator(const const_iterator &other)
+		++it;
+		x->set_parent(p);
+		x->set_color((depth == red_depth) ? 0 : 1);
+		x->left = l;
+		if (l != NULL)
+			l->set_parent(x);
+		try
 		{
-			ptr = other.ptr;
-			container = other.container;
+			x->right = build_sorted(it, n - nl - 1, depth + 1, red_depth, x);
 		}
-		~iterator() {}
-		/**
-		 * return a new iterator which pointer n-next elements
-		 *   even if there are not enough elements, just return the answer.
-		 * as well as operator-
-		 */
-		iterator &operator=(const iterator &rhs)
+		catch (...)
 		{
-			if (this == &rhs)
-				return *this;
-			ptr = rhs.ptr;
-			container = rhs.container;
-			return *this;
+			clear(x);
+			throw;
 		}
-		/**
-		 * TODO iter++
-		 */
-		iterator operator++(int)
+		update_summary(x);
+		return x;
+	}
+
+	// the level whose nodes are colored red when n nodes are built by build_sorted / relink_sorted.
+	static size_t red_depth_for(size_t n)
+	{
+		size_t d = 0;
+		while ((static_cast<size_t>(2) << d) <= n + 1)
+			++d;
+		return d;
+	}
+
+	/**
+	 * same shape as build_sorted, but reuses the next n nodes of a chain
+	 *   linked through their left pointers, starting at head.
+	 */
+	node* relink_sorted(node* &head, size_t n, size_t depth, size_t red_depth, node *p)
+	{
+		if (n == 0)
+			return NULL;
+		size_t nl = (n - 1) / 2;
+		node *l = relink_sorted(head, nl, depth + 1, red_depth, NULL);
+		node *x = head;
+		head = head->left;
+		x->left = l;
+		if (l != NULL)
+			l->set_parent(x);
+		x->set_parent(p);
+		x->set_color((depth == red_depth) ? 0 : 1);
+		x->right = relink_sorted(head, n - nl - 1, depth + 1, red_depth, x);
+		update_summary(x);
+		return x;
+	}
+
+	/**
+	 * remove the nodes for which drop(x) holds by walking the whole tree once:
+	 *   the survivors are chained in order and relinked into a balanced tree,
+	 *   so there is no per-node rebalancing. O(n), used when many go.
+	 *   the walk only reads right and parent links of visited nodes,
+	 *   which is why their left pointers can carry the chains.
+	 *   drop is called on every node in increasing order.
+	 */
+	template<class Drop>
+	void rebuild_without(Drop drop_it)
+	{
+		if (node_count == 0)
+			return;
+		node *keep = NULL, *keep_tail = NULL, *drop = NULL, *drop_tail = NULL;
+		size_t m = 0;
+		for (node *x = header->left; x != header; x = next_node(x))
 		{
-			if (ptr == container->header)
-				throw invalid_iterator();
-			else
+			if (drop_it(x))
 			{
-				iterator itr(*this);
-				if (ptr->right != NULL)
-				{
-					ptr = ptr->right;
-					while (ptr->left != NULL)
-						ptr = ptr->left;
-				}
+				if (drop_tail == NULL)
+					drop = x;
 				else
-				{
-					node *tmp = ptr->parent;
-					while (ptr == tmp->right)
-					{
-						ptr = tmp;
-						tmp = tmp->parent;
-					}
-					if (ptr->right != tmp)
-					{
-						ptr = tmp;
-					}
-				}
-				return itr;
+					drop_tail->left = x;
+				drop_tail = x;
 			}
-		}
-		/**
-		 * TODO ++iter
-		 */
-		iterator & operator++()
-		{
-			if (ptr == container->header)
-				throw invalid_iterator();
 			else
 			{
-				if (ptr->right != NULL)
-				{
-					ptr = ptr->right;
-					while (ptr->left != NULL)
-						ptr = ptr->left;
-				}
+				if (keep_tail == NULL)
+					keep = x;
 				else
-				{
-					node *tmp = ptr->parent;
-					while (ptr == tmp->right)
-					{
-						ptr = tmp;
-						tmp = tmp->parent;
-					}
-					if (ptr->right != tmp)
+					keep_tail->left = x;
+				keep_tail = x;
+				++m;
+			}
+		}
+		if (drop_tail != NULL)
+			drop_tail->left = NULL;
+		while (drop != NULL)
+		{
+			node *next = drop->left;
+			destroy_node(drop);
+			drop = next;
+		}
+		if (m == 0)
+		{
+			set_tree(NULL, NULL, NULL, 0);
+			return;
+		}
+		node *leftmost = keep;
+		keep_tail->left = NULL;
+		node *t = relink_sorted(keep, m, 0, red_depth_for(m), header);
+		set_tree(t, leftmost, keep_tail, m);
+	}
+
+	// remove the nodes of [first, last), see rebuild_without.
+	void erase_by_rebuild(node *first, node *last)
+	{
+		bool in_range = false;
+		rebuild_without([&](node *x) {
+			if (x == first)
+				in_range = true;
+			if (x == last)
+				in_range = false;
+			return in_range;
+		});
+	}
+
+	/**
+	 * merge the values get(it) of a sorted run [first, last) into the tree by
+	 *   walking it once, like rebuild_without. All new nodes are created before
+	 *   the tree is touched, so an exception leaves it as it was; a value whose
+	 *   key is already there (or repeats in the run) is dropped again.
+	 */
+	template<class ForwardIt, class Get>
+	size_t insert_by_rebuild(ForwardIt first, ForwardIt last, Get get)
+	{
+		node *fresh = NULL, *fresh_tail = NULL;
+		try
+		{
+			for (; first != last; ++first)
+			{
+				node *z = create_node(get(first));
+				z->left = NULL;
+				if (fresh_tail == NULL)
+					fresh = z;
+				else
+					fresh_tail->left = z;
+				fresh_tail = z;
+			}
+		}
+		catch (...)
+		{
+			while (fresh != NULL)
+			{
+				node *next = fresh->left;
+				destroy_node(fresh);
+				fresh = next;
+			}
+			throw;
+		}
+		size_t old_count = node_count, m = 0;
+		node *head = NULL, *tail = NULL;
+		node *x = (node_count == 0) ? header : header->left;
+		while (x != header || fresh != NULL)
+		{
+			node *take;
+			if (fresh == NULL || (x != header && !comp()(fresh->data.first, x->data.first)))
+			{
+				take = x;
+				x = next_node(x);
+			}
+			else
+			{
+				take = fresh;
+				fresh = fresh->left;
+				if (tail != NULL && !comp()(tail->data.first, take->data.first))
+				{
+					destroy_node(take);
+					continue;
+				}
+			}
+			if (tail == NULL)
+				head = take;
+			else
+				tail->left = take;
+			tail = take;
+			++m;
+		}
+		if (m == 0)
+			return 0;
+		node *leftmost = head;
+		tail->left = NULL;
+		node *t = relink_sorted(head, m, 0, red_depth_for(m), header);
+		set_tree(t, leftmost, tail, m);
+		return m - old_count;
+	}
+
+	/**
+	 * insert the values get(it) of a sorted run one by one, each search
+	 *   starting from the node touched last (see finger_lower_bound);
+	 *   O(k log(n / k)) comparisons for k values spread over n elements.
+	 *   Large runs are merged by insert_by_rebuild instead.
+	 */
+	template<class ForwardIt, class Get>
+	size_t insert_sorted_run(ForwardIt first, ForwardIt last, size_t k, Get get)
+	{
+		if (k > node_count / batch_rebuild_ratio)
+			return insert_by_rebuild(first, last, get);
+		size_t inserted = 0;
+		node *finger = header;
+		for (; first != last; ++first)
+		{
+			// the element as the batch holds it, which need not be a value_type.
+			auto &&value = get(first);
+			node *y = finger_lower_bound(finger, value.first);
+			if (y != header && !comp()(value.first, y->data.first))
+			{
+				finger = y;
+				continue;
+			}
+			finger = insert_before(create_node(value), y);
+			++inserted;
+		}
+		return inserted;
+	}
+
+	// erase the keys get(it) of a sorted run, see insert_sorted_run.
+	template<class ForwardIt, class Get>
+	size_t erase_sorted_run(ForwardIt first, ForwardIt last, size_t k, Get get)
+	{
+		size_t old_count = node_count;
+		if (k > node_count / batch_rebuild_ratio)
+		{
+			rebuild_without([&](node *x) {
+				while (first != last && comp()(get(first), x->data.first))
+					++first;
+				return first != last && !comp()(x->data.first, get(first));
+			});
+			return old_count - node_count;
+		}
+		node *finger = header;
+		for (; first != last; ++first)
+		{
+			node *y = finger_lower_bound(finger, get(first));
+			if (y == header || comp()(get(first), y->data.first))
+				continue;
+			finger = (y == header->left) ? header : prev_node(y);
+			destroy_node(erase_rebalance(y));
+			--node_count;
+		}
+		return old_count - node_count;
+	}
+
+	// number of black nodes on a path from t down to a NULL link.
+	static int black_height(node *t)
+	{
+		int h = 0;
+		for (; t != NULL; t = t->left)
+			if (t->color() == 1)
+				++h;
+		return h;
+	}
+
+	// the black height of t, h as it stands, once its root is made black.
+	static int blackened_height(node *t, int h)
+	{
+		return (t != NULL && t->color() == 0) ? h + 1 : h;
+	}
+
+	node* join_trees(node *l, node *k, node *r)
+	{
+		int h;
+		return join_trees(l, blackened_height(l, black_height(l)), k, r, blackened_height(r, black_height(r)), h);
+	}
+
+	/**
+	 * join the detached red-black trees l and r, with k as the node between
+	 *   them (every key in l < k < every key in r), into one detached tree.
+	 *   hl and hr are the black heights of l and r with their roots made
+	 *   black; the black height of the result is stored in height.
+	 *   k is hung on the spine of the taller tree at the first black node of
+	 *   the same black height as the other tree, and the red-red conflict is
+	 *   fixed by insert_rebalance, so the cost is O(|hl - hr| + 1).
+	 *   this tree must be empty: its header is used to anchor the work.
+	 */
+	node* join_trees(node *l, int hl, node *k, node *r, int hr, int &height)
+	{
+		if (l != NULL)
+		{
+			l->set_parent(NULL);
+			l->set_color(1);
+		}
+		if (r != NULL)
+		{
+			r->set_parent(NULL);
+			r->set_color(1);
+		}
+		k->left = l;
+		k->right = r;
+		k->set_parent(NULL);
+		if (hl == hr)
+		{
+			if (l != NULL)
+				l->set_parent(k);
+			if (r != NULL)
+				r->set_parent(k);
+			k->set_color(1);
+			update_summary(k);
+			height = hl + 1;
+			return k;
+		}
+		node *taller = hl > hr ? l : r;
+		int h = hl > hr ? hl : hr, target = hl > hr ? hr : hl;
+		root = taller;
+		header->set_parent(taller);
+		taller->set_parent(header);
+		node *p = NULL, *x = taller;
+		while (x != NULL && !(x->color() == 1 && h == target))
+		{
+			if (x->color() == 1)
+				--h;
+			p = x;
+			x = hl > hr ? x->right : x->left;
+		}
+		if (hl > hr)
+		{
+			k->left = x;
+			p->right = k;
+			if (r != NULL)
+				r->set_parent(k);
+		}
+		else
+		{
+			k->right = x;
+			p->left = k;
+			if (l != NULL)
+				l->set_parent(k);
+		}
+		if (x != NULL)
+			x->set_parent(k);
+		k->set_parent(p);
+		k->set_color(0);
+		update_path(k);
+		height = (hl > hr ? hl : hr) + (insert_rebalance(k) ? 1 : 0);
+		node *t = root;
+		root = NULL;
+		header->set_parent(NULL);
+		t->set_parent(NULL);
+		return t;
+	}
+
+	/**
+	 * split the detached tree t, of black height h, into l (keys < key) and
+	 *   r (keys >= key), rejoining the pieces of the search path bottom-up
+	 *   with join_trees; hl and hr receive their black heights.
+	 *   the heights are passed down and back up instead of being measured,
+	 *   and the join costs telescope, so the total is O(log n).
+	 */
+	void split_tree(node *t, int h, const Key &key, node* &l, int &hl, node* &r, int &hr)
+	{
+		if (t == NULL)
+		{
+			l = r = NULL;
+			hl = hr = 0;
+			return;
+		}
+		node *tl = t->left, *tr = t->right;
+		int hc = h - t->color();
+		if (!comp()(t->data.first, key))
+		{
+			split_tree(tl, hc, key, l, hl, r, hr);
+			r = join_trees(r, hr, t, tr, blackened_height(tr, hc), hr);
+		}
+		else
+		{
+			split_tree(tr, hc, key, l, hl, r, hr);
+			l = join_trees(tl, blackened_height(tl, hc), t, l, hl, hl);
+		}
+	}
+
+	// take the whole tree out of the map, leaving it empty.
+	node* detach()
+	{
+		node *t = root;
+		set_tree(NULL, NULL, NULL, 0);
+		if (t != NULL)
+			t->set_parent(NULL);
+		return t;
+	}
+
+	// install a detached tree of n nodes.
+	void attach(node *t, size_t n)
+	{
+		if (t == NULL)
+			set_tree(NULL, NULL, NULL, 0);
+		else
+			set_tree(t, minimum(t), maximum(t), n);
+	}
+
+	// unlink the node x (and keep it alive), like erase without destroy_node.
+	node* unlink(node *x)
+	{
+		node *y = erase_rebalance(x);
+		--node_count;
+		y->left = y->right = NULL;
+		y->set_parent(NULL);
+		return y;
+	}
+
+	/**
+	 * the sizes of two maps split from one of n elements: read off the
+	 *   subtree sizes if the policy keeps them, otherwise count the smaller
+	 *   one by walking both in lockstep.
+	 */
+	static size_t left_part_size(map &l, map &r, size_t n, std::true_type)
+	{
+		(void)r;
+		(void)n;
+		return size_of(l.root);
+	}
+	static size_t left_part_size(map &l, map &r, size_t n, std::false_type)
+	{
+		size_t k = 0;
+		node *a = l.header->left, *b = r.header->left;
+		while (a != l.header && b != r.header)
+		{
+			a = l.next_node(a);
+			b = r.next_node(b);
+			++k;
+		}
+		return a == l.header ? k : n - k;
+	}
+
+	// this must be empty.
+	template<class ForwardIt>
+	void build_from_sorted(ForwardIt first, ForwardIt last)
+	{
+		size_t n = std::distance(first, last);
+		if (n == 0)
+			return;
+		reserve(n);
+		node *t = build_sorted(first, n, 0, red_depth_for(n), header);
+		set_tree(t, minimum(t), maximum(t), n);
+	}
+
+	// this must be empty.
+	void copy_from(const map &other)
+	{
+		reserve(other.node_count);
+		node *l = NULL, *r = NULL;
+		node *t = copy_tree(other.root, header, other.header->left, other.header->right, l, r);
+		set_tree(t, l, r, other.node_count);
+	}
+
+public:
+	/**
+	 * the internal type of data.
+	 * it should have a default constructor, a copy constructor.
+	 * You can use sjtu::map as value_type by typedef.
+	 */
+	typedef pair<const Key, T> value_type;
+	typedef Allocator allocator_type;
+	/**
+	 * see BidirectionalIterator at CppReference for help.
+	 *
+	 * if there is anything wrong throw invalid_iterator.
+	 *     like it = map.begin(); --it;
+	 *       or it = map.end(); ++end();
+	 */
+	class const_iterator;
+	class iterator {
+		friend class map;
+		friend class const_iterator;
+	private:
+		/**
+		 * TODO add data members
+		 *   just add whatever you want.
+		 */
+		node *ptr;
+		const map *container;
+	public:
+		iterator(node *p = NULL, const map *c = NULL) :ptr(p), container(c)
+		{
+			// TODO
+		}
+		iterator(const iterator &other)
+		{
+			// TODO
+			ptr = other.ptr;
+			container = other.container;
+		}
+		iterator(const const_iterator &other)
+		{
+			ptr = other.ptr;
+			container = other.container;
+		}
+		~iterator() {}
+		/**
+		 * return a new iterator which pointer n-next elements
+		 *   even if there are not enough elements, just return the answer.
+		 * as well as operator-
+		 */
+		template<class A = Augment, class = typename std::enable_if<A::has_size>::type>
+		iterator operator+(ptrdiff_t n) const
+		{
+			return iterator(container->node_at(container->index_of(ptr) + n), container);
+		}
+		template<class A = Augment, class = typename std::enable_if<A::has_size>::type>
+		iterator operator-(ptrdiff_t n) const
+		{
+			return iterator(container->node_at(container->index_of(ptr) - n), container);
+		}
+		iterator &operator=(const iterator &rhs)
+		{
+			if (this == &rhs)
+				return *this;
+			ptr = rhs.ptr;
+			container = rhs.container;
+			return *this;
+		}
+		/**
+		 * TODO iter++
+		 */
+		iterator operator++(int)
+		{
+			if (ptr == container->header)
+				throw invalid_iterator();
+			else
+			{
+				iterator itr(*this);
+				if (ptr->right != NULL)
+				{
+					ptr = ptr->right;
+					while (ptr->left != NULL)
+						ptr = ptr->left;
+				}
+				else
+				{
+					node *tmp = ptr->parent();
+					while (ptr == tmp->right)
+					{
+						ptr = tmp;
+						tmp = tmp->parent();
+					}
+					if (ptr->right != tmp)
+					{
+						ptr = tmp;
+					}
+				}
+				return itr;
+			}
+		}
+		/**
+		 * TODO ++iter
+		 */
+		iterator & operator++()
+		{
+			if (ptr == container->header)
+				throw invalid_iterator();
+			else
+			{
+				if (ptr->right != NULL)
+				{
+					ptr = ptr->right;
+					while (ptr->left != NULL)
+						ptr = ptr->left;
+				}
+				else
+				{
+					node *tmp = ptr->parent();
+					while (ptr == tmp->right)
+					{
+						ptr = tmp;
+						tmp = tmp->parent();
+					}
+					if (ptr->right != tmp)
 					{
 						ptr = tmp;
 					}
@@ -468,7 +1300,7 @@ public:
 			{
 				node *tmp;
 				iterator itr(*this);
-				if (ptr->is_end)
+				if (ptr == container->header)
 					ptr = ptr->right;
 				else if (ptr->left != NULL)
 				{
@@ -479,11 +1311,11 @@ public:
 				}
 				else
 				{
-					tmp = ptr->parent;
+					tmp = ptr->parent();
 					while (ptr == tmp->left)
 					{
 						ptr = tmp;
-						tmp = tmp->parent;
+						tmp = tmp->parent();
 					}
 					ptr = tmp;
 				}
@@ -500,7 +1332,7 @@ public:
 			else
 			{
 				node *tmp;
-				if (ptr->is_end)
+				if (ptr == container->header)
 					ptr = ptr->right;
 				else if (ptr->left != NULL)
 				{
@@ -511,11 +1343,11 @@ public:
 				}
 				else
 				{
-					tmp = ptr->parent;
+					tmp = ptr->parent();
 					while (ptr == tmp->left)
 					{
 						ptr = tmp;
-						tmp = tmp->parent;
+						tmp = tmp->parent();
 					}
 					ptr = tmp;
 				}
@@ -584,6 +1416,16 @@ public:
 		// And other methods in iterator.
 		// And other methods in iterator.
 		// And other methods in iterator.
+		template<class A = Augment, class = typename std::enable_if<A::has_size>::type>
+		const_iterator operator+(ptrdiff_t n) const
+		{
+			return const_iterator(container->node_at(container->index_of(ptr) + n), container);
+		}
+		template<class A = Augment, class = typename std::enable_if<A::has_size>::type>
+		const_iterator operator-(ptrdiff_t n) const
+		{
+			return const_iterator(container->node_at(container->index_of(ptr) - n), container);
+		}
 		const_iterator &operator=(const const_iterator &rhs)
 		{
 			if (this == &rhs)
@@ -607,11 +1449,11 @@ public:
 				}
 				else
 				{
-					node *tmp = ptr->parent;
+					node *tmp = ptr->parent();
 					while (ptr == tmp->right)
 					{
 						ptr = tmp;
-						tmp = tmp->parent;
+						tmp = tmp->parent();
 					}
 					if (ptr->right != tmp)
 					{
@@ -635,11 +1477,11 @@ public:
 				}
 				else
 				{
-					node *tmp = ptr->parent;
+					node *tmp = ptr->parent();
 					while (ptr == tmp->right)
 					{
 						ptr = tmp;
-						tmp = tmp->parent;
+						tmp = tmp->parent();
 					}
 					if (ptr->right != tmp)
 					{
@@ -657,7 +1499,7 @@ public:
 			{
 				node *tmp;
 				const_iterator itr(*this);
-				if (ptr->is_end)
+				if (ptr == container->header)
 					ptr = ptr->right;
 				else if (ptr->left != NULL)
 				{
@@ -668,11 +1510,11 @@ public:
 				}
 				else
 				{
-					tmp = ptr->parent;
+					tmp = ptr->parent();
 					while (ptr == tmp->left)
 					{
 						ptr = tmp;
-						tmp = tmp->parent;
+						tmp = tmp->parent();
 					}
 					ptr = tmp;
 				}
@@ -686,7 +1528,7 @@ public:
 			else
 			{
 				node *tmp;
-				if (ptr->is_end)
+				if (ptr == container->header)
 					ptr = ptr->right;
 				else if (ptr->left != NULL)
 				{
@@ -697,11 +1539,11 @@ public:
 				}
 				else
 				{
-					tmp = ptr->parent;
+					tmp = ptr->parent();
 					while (ptr == tmp->left)
 					{
 						ptr = tmp;
-						tmp = tmp->parent;
+						tmp = tmp->parent();
 					}
 					ptr = tmp;
 				}
@@ -735,37 +1577,157 @@ public:
 		}
 	};
 	/**
-	 * TODO two constructors
+	 * owns a node taken out of a map by extract(), until it is inserted
+	 *   again (into this map or another one with an equal allocator)
+	 *   or the handle is destroyed. The key can be changed in the meantime.
+	 *   The allocator is only built while there is a node, so an empty handle
+	 *   costs nothing to make (a default-constructed pool_allocator would
+	 *   create a pool).
 	 */
-	map()
-	{
-		root = NULL;
-		init();
-		node_count = 0;
-	}
-	map(const map &other)
-	{
-	    root = NULL;
-		init();
-		node_count = other.node_count;
-		copy_tree(other.root, root, header);
-		if (root != NULL)
+	class node_type {
+		friend class map;
+	private:
+		node *ptr;
+		typename std::aligned_storage<sizeof(node_allocator), alignof(node_allocator)>::type alloc_buf;
+
+		node_allocator & node_alloc()
 		{
-			node *tmp = root;
-			while (tmp->left != NULL)
-			{
-				tmp = tmp->left;
-			}
-			header->left = tmp;
-			node *tmp2 = root;
-			while (tmp2->right != NULL)
-			{
-				tmp2 = tmp2->right;
-			}
-			header->right = tmp2;
+			return *reinterpret_cast<node_allocator*>(&alloc_buf);
 		}
-		header->parent = root;
-	}
+		const node_allocator & node_alloc() const
+		{
+			return *reinterpret_cast<const node_allocator*>(&alloc_buf);
+		}
+		node_type(node *p, const node_allocator &a) : ptr(p)
+		{
+			::new (static_cast<void*>(&alloc_buf)) node_allocator(a);
+		}
+		node* release()
+		{
+			node *tmp = ptr;
+			if (tmp != NULL)
+				node_alloc().~node_allocator();
+			ptr = NULL;
+			return tmp;
+		}
+		void reset()
+		{
+			if (ptr != NULL)
+			{
+				node_traits::destroy(node_alloc(), ptr);
+				node_traits::deallocate(node_alloc(), ptr, 1);
+				release();
+			}
+		}
+		void take(node_type &other) noexcept
+		{
+			if (other.ptr == NULL)
+				return;
+			::new (static_cast<void*>(&alloc_buf)) node_allocator(std::move(other.node_alloc()));
+			ptr = other.release();
+		}
+	public:
+		node_type() : ptr(NULL) {}
+		node_type(node_type &&other) noexcept : ptr(NULL)
+		{
+			take(other);
+		}
+		node_type & operator=(node_type &&other) noexcept
+		{
+			if (this == &other)
+				return *this;
+			reset();
+			take(other);
+			return *this;
+		}
+		node_type(const node_type &) = delete;
+		node_type & operator=(const node_type &) = delete;
+		~node_type()
+		{
+			reset();
+		}
+		bool empty() const noexcept
+		{
+			return ptr == NULL;
+		}
+		explicit operator bool() const noexcept
+		{
+			return ptr != NULL;
+		}
+		Key & key() const
+		{
+			return const_cast<Key&>(ptr->data.first);
+		}
+		T & mapped() const
+		{
+			return ptr->data.second;
+		}
+		/**
+		 * like key() and mapped(), only for a handle that is not empty.
+		 */
+		allocator_type get_allocator() const
+		{
+			return allocator_type(node_alloc());
+		}
+		void swap(node_type &other) noexcept
+		{
+			node_type tmp(std::move(other));
+			other = std::move(*this);
+			*this = std::move(tmp);
+		}
+	};
+	/**
+	 * the result of insert(node_type &&): where the key is now, whether the
+	 *   node was inserted, and the node itself if it was not.
+	 */
+	struct insert_return_type
+	{
+		iterator position;
+		bool inserted;
+		node_type node;
+	};
+	/**
+	 * TODO two constructors
+	 */
+	map()
+	{
+		root = NULL;
+		init();
+		node_count = 0;
+	}
+	explicit map(const Compare &c, const Allocator &a = Allocator()) : compare_holder<Compare>(c), alloc(a)
+	{
+		root = NULL;
+		init();
+		node_count = 0;
+	}
+	explicit map(const Allocator &a) : alloc(a)
+	{
+		root = NULL;
+		init();
+		node_count = 0;
+	}
+	/**
+	 * build the map from [first, last) in O(n).
+	 *   the range must be sorted by Compare and must not contain equal keys.
+	 */
+	template<class ForwardIt>
+	map(sorted_unique_t, ForwardIt first, ForwardIt last, const Compare &c = Compare(), const Allocator &a = Allocator())
+		: compare_holder<Compare>(c), alloc(a)
+	{
+		root = NULL;
+		init();
+		node_count = 0;
+		build_from_sorted(first, last);
+	}
+	map(const map &other)
+		: compare_holder<Compare>(other.comp()), alloc(node_traits::select_on_container_copy_construction(other.alloc))
+	{
+	    root = NULL;
+		init();
+		node_count = 0;
+		copy_from(other);
+	}
 	/**
 	 * TODO assignment operator
 	 */
@@ -774,33 +1736,54 @@ public:
 		if (this == &other)
 			return *this;
 		clear();
-		node_count = other.node_count;
-		copy_tree(other.root, root, header);
-		if (root != NULL)
-		{
-			node *tmp = root;
-			while (tmp->left != NULL)
-			{
-				tmp = tmp->left;
-			}
-			header->left = tmp;
-			node *tmp2 = root;
-			while (tmp2->right != NULL)
-			{
-				tmp2 = tmp2->right;
-			}
-			header->right = tmp2;
-		}
-		header->parent = root;
+		comp() = other.comp();
+		copy_from(other);
+		return *this;
+	}
+	/**
+	 * move constructor and move assignment only relink the tree,
+	 *   other is left empty. Iterators keep pointing to the nodes,
+	 *   but they still refer to other as their container.
+	 */
+	map(map &&other) noexcept(std::is_nothrow_copy_constructible<Compare>::value) : compare_holder<Compare>(other.comp()), alloc(std::move(other.alloc))
+	{
+		root = NULL;
+		init();
+		steal(other);
+	}
+	map & operator=(map &&other) noexcept(node_traits::propagate_on_container_move_assignment::value
+		&& std::is_nothrow_copy_assignable<Compare>::value)
+	{
+		if (this == &other)
+			return *this;
+		comp() = other.comp();
+		move_assign(other, typename node_traits::propagate_on_container_move_assignment());
 		return *this;
 	}
+	/**
+	 * exchange the contents of two maps in O(1).
+	 * references to the elements stay valid and refer to them in their new
+	 *   map, but iterators do not: they still name their old map as their
+	 *   container, so passing one to the other map throws `invalid_iterator'.
+	 */
+	void swap(map &other) noexcept(adl_swap::is_nothrow_swappable<Compare>::value)
+	{
+		if (this == &other)
+			return;
+		node *r = root, *l = header->left, *rr = header->right;
+		size_t n = node_count;
+		set_tree(other.root, other.header->left, other.header->right, other.node_count);
+		other.set_tree(r, l, rr, n);
+		swap_alloc(alloc, other.alloc, typename node_traits::propagate_on_container_swap());
+		using std::swap;
+		swap(comp(), other.comp());
+	}
 	/**
 	 * TODO Destructors
 	 */
 	~map()
 	{
 		clear();
-		operator delete (header);
 	}
 	/**
 	 * TODO
@@ -810,14 +1793,7 @@ public:
 	 */
 	T & at(const Key &key)
 	{
-		node *tmp = root;
-		while (tmp != NULL && (Compare()(tmp->data.first, key) || Compare()(key, tmp->data.first)))
-		{
-			if (Compare()(tmp->data.first, key))
-				tmp = tmp->right;
-			else
-				tmp = tmp->left;
-		}
+		node *tmp = find_node(key);
 		if (tmp == NULL)
 			throw index_out_of_bound();
 		else
@@ -825,19 +1801,34 @@ public:
 	}
 	const T & at(const Key &key) const
 	{
-		node *tmp = root;
-		while (tmp != NULL && (Compare()(tmp->data.first, key) || Compare()(key, tmp->data.first)))
-		{
-			if (Compare()(tmp->data.first, key))
-				tmp = tmp->right;
-			else
-				tmp = tmp->left;
-		}
+		node *tmp = find_node(key);
 		if (tmp == NULL)
 			throw index_out_of_bound();
 		else
 			return tmp->data.second;
 	}
+	/**
+	 * the overloads taking a template K (here and in count, contains, find,
+	 *   lower_bound, upper_bound, equal_range and erase) only exist when
+	 *   Compare::is_transparent is defined; key is then compared as it is,
+	 *   without building a Key from it.
+	 */
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	T & at(const K &key)
+	{
+		node *tmp = find_node(key);
+		if (tmp == NULL)
+			throw index_out_of_bound();
+		return tmp->data.second;
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	const T & at(const K &key) const
+	{
+		node *tmp = find_node(key);
+		if (tmp == NULL)
+			throw index_out_of_bound();
+		return tmp->data.second;
+	}
 	/**
 	 * TODO
 	 * access specified element
@@ -846,34 +1837,18 @@ public:
 	 */
 	T & operator[](const Key &key)
 	{
-		node *tmp = root;
-		while (tmp != NULL && (Compare()(tmp->data.first, key) || Compare()(key, tmp->data.first)))
-		{
-			if (Compare()(tmp->data.first, key))
-				tmp = tmp->right;
-			else
-				tmp = tmp->left;
-		}
-		if (tmp == NULL)
-		{
-			return((insert(value_type(key, T())).first.ptr->data).second);
-		}
-		else
-			return tmp->data.second;
+		return try_emplace(key).first.ptr->data.second;
+	}
+	T & operator[](Key &&key)
+	{
+		return try_emplace(std::move(key)).first.ptr->data.second;
 	}
 	/**
 	 * behave like at() throw index_out_of_bound if such key does not exist.
 	 */
 	const T & operator[](const Key &key) const
 	{
-		node *tmp = root;
-		while (tmp != NULL && (Compare()(tmp->data.first, key) || Compare()(key, tmp->data.first)))
-		{
-			if (Compare()(tmp->data.first, key))
-				tmp = tmp->right;
-			else
-				tmp = tmp->left;
-		}
+		node *tmp = find_node(key);
 		if (tmp == NULL)
 			throw index_out_of_bound();
 		else
@@ -921,6 +1896,13 @@ public:
 	{
 		return node_count;
 	}
+	/**
+	 * bytes taken by one element node (value plus links), not counting allocator overhead.
+	 */
+	static constexpr size_t node_size()
+	{
+		return sizeof(node);
+	}
 	/**
 	 * clears the contents
 	 */
@@ -929,9 +1911,47 @@ public:
 		clear(root);
 		header->left = header;
 		header->right = header;
-		header->parent = root = NULL;
+		root = NULL;
+		header->set_parent(NULL);
 		node_count = 0;
 	}
+	/**
+	 * replace the contents with [first, last) in O(n).
+	 *   the range must be sorted by Compare and must not contain equal keys.
+	 */
+	template<class ForwardIt>
+	void assign_sorted(ForwardIt first, ForwardIt last)
+	{
+		clear();
+		build_from_sorted(first, last);
+	}
+	/**
+	 * pre-grows the node storage so that the next n inserts do not allocate.
+	 * only has an effect when the allocator provides reserve(n), like pool_allocator.
+	 */
+	void reserve(size_t n)
+	{
+		reserve_nodes(alloc, n, 0);
+	}
+	/**
+	 * an immutable copy of the elements for a read-only phase, in O(n):
+	 *   lookups in it walk one contiguous array (see frozen_map).
+	 */
+	frozen_map<Key, T, Compare> freeze() const
+	{
+		return frozen_map<Key, T, Compare>(sorted_unique, cbegin(), node_count, comp());
+	}
+	/**
+	 * the comparator the map was constructed with.
+	 */
+	Compare key_comp() const
+	{
+		return comp();
+	}
+	allocator_type get_allocator() const
+	{
+		return allocator_type(alloc);
+	}
 	/**
 	 * insert an element.
 	 * return a pair, the first of the pair is
@@ -940,139 +1960,1178 @@ public:
 	 */
 	pair<iterator, bool> insert(const value_type &value)
 	{
-		node *y = header;
-		node *x = root;
-		bool comp = true;
-		while (x != NULL)
+		node *y;
+		bool to_left;
+		if (!get_insert_pos(value.first, y, to_left))
+			return pair<iterator, bool>(iterator(y, this), false);
+		return pair<iterator, bool>(insert_node(create_node(value), y, to_left), true);
+	}
+	pair<iterator, bool> insert(value_type &&value)
+	{
+		node *y;
+		bool to_left;
+		if (!get_insert_pos(value.first, y, to_left))
+			return pair<iterator, bool>(iterator(y, this), false);
+		return pair<iterator, bool>(insert_node(create_node(std::move(value)), y, to_left), true);
+	}
+	/**
+	 * construct the element in place from args.
+	 * the node is built before the lookup, and thrown away if the key already exists.
+	 */
+	template<class... Args>
+	pair<iterator, bool> emplace(Args&&... args)
+	{
+		node *z = create_node(std::forward<Args>(args)...);
+		node *y;
+		bool to_left;
+		try
 		{
-			y = x;
-			comp = Compare()(value.first, x->data.first);
-			x = comp ? x->left : x->right;
+			if (!get_insert_pos(z->data.first, y, to_left))
+			{
+				destroy_node(z);
+				return pair<iterator, bool>(iterator(y, this), false);
+			}
 		}
-		iterator j(y, this);
-		if (comp)
+		catch (...)
 		{
-			if (j == begin())
-				return pair<iterator, bool>(insert(value, x, y),true);
-			else
-				--j;
+			destroy_node(z);
+			throw;
+		}
+		return pair<iterator, bool>(insert_node(z, y, to_left), true);
+	}
+	/**
+	 * insert value using hint as a suggestion of where it goes.
+	 *   if value belongs right before hint (e.g. hint == end() for keys coming
+	 *   in increasing order), no search from the root is done.
+	 * return an iterator to the new element or to the one that prevented the insertion.
+	 */
+	iterator insert(const_iterator hint, const value_type &value)
+	{
+		if (hint.ptr == NULL || hint.container != this)
+			throw invalid_iterator();
+		node *y;
+		bool to_left;
+		if (!get_insert_hint_pos(hint.ptr, value.first, y, to_left))
+			return iterator(y, this);
+		return insert_node(create_node(value), y, to_left);
+	}
+	iterator insert(const_iterator hint, value_type &&value)
+	{
+		if (hint.ptr == NULL || hint.container != this)
+			throw invalid_iterator();
+		node *y;
+		bool to_left;
+		if (!get_insert_hint_pos(hint.ptr, value.first, y, to_left))
+			return iterator(y, this);
+		return insert_node(create_node(std::move(value)), y, to_left);
+	}
+	template<class... Args>
+	iterator emplace_hint(const_iterator hint, Args&&... args)
+	{
+		if (hint.ptr == NULL || hint.container != this)
+			throw invalid_iterator();
+		node *z = create_node(std::forward<Args>(args)...);
+		node *y;
+		bool to_left;
+		try
+		{
+			if (!get_insert_hint_pos(hint.ptr, z->data.first, y, to_left))
+			{
+				destroy_node(z);
+				return iterator(y, this);
+			}
+		}
+		catch (...)
+		{
+			destroy_node(z);
+			throw;
+		}
+		return insert_node(z, y, to_left);
+	}
+	/**
+	 * like emplace, but nothing is constructed (and args are not moved from)
+	 *   if key already exists; otherwise the mapped value is built from args.
+	 */
+	template<class... Args>
+	pair<iterator, bool> try_emplace(const Key &key, Args&&... args)
+	{
+		node *y;
+		bool to_left;
+		if (!get_insert_pos(key, y, to_left))
+			return pair<iterator, bool>(iterator(y, this), false);
+		node *z = create_node(std::piecewise_construct, std::forward_as_tuple(key),
+			std::forward_as_tuple(std::forward<Args>(args)...));
+		return pair<iterator, bool>(insert_node(z, y, to_left), true);
+	}
+	template<class... Args>
+	pair<iterator, bool> try_emplace(Key &&key, Args&&... args)
+	{
+		node *y;
+		bool to_left;
+		if (!get_insert_pos(key, y, to_left))
+			return pair<iterator, bool>(iterator(y, this), false);
+		node *z = create_node(std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+			std::forward_as_tuple(std::forward<Args>(args)...));
+		return pair<iterator, bool>(insert_node(z, y, to_left), true);
+	}
+	/**
+	 * insert (key, obj), or assign obj to the mapped value if key already exists.
+	 * the second of the returned pair is true if an insertion took place.
+	 */
+	template<class M>
+	pair<iterator, bool> insert_or_assign(const Key &key, M &&obj)
+	{
+		node *y;
+		bool to_left;
+		if (!get_insert_pos(key, y, to_left))
+		{
+			y->data.second = std::forward<M>(obj);
+			update_path(y);
+			return pair<iterator, bool>(iterator(y, this), false);
+		}
+		return pair<iterator, bool>(insert_node(create_node(key, std::forward<M>(obj)), y, to_left), true);
+	}
+	template<class M>
+	pair<iterator, bool> insert_or_assign(Key &&key, M &&obj)
+	{
+		node *y;
+		bool to_left;
+		if (!get_insert_pos(key, y, to_left))
+		{
+			y->data.second = std::forward<M>(obj);
+			update_path(y);
+			return pair<iterator, bool>(iterator(y, this), false);
 		}
-		if (Compare()(j.ptr->data.first, value.first))
-			return pair<iterator, bool>(insert(value, x, y), true);
-		return pair<iterator, bool>(j, false);
+		return pair<iterator, bool>(insert_node(create_node(std::move(key), std::forward<M>(obj)), y, to_left), true);
 	}
 	/**
 	 * erase the element at pos.
+	 * return an iterator to the element that followed it.
 	 *
 	 * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
 	 */
-	void erase(iterator pos)
+	iterator erase(iterator pos)
 	{
 		if (pos.ptr == NULL || pos.ptr == header || pos.container != this)
 			throw invalid_iterator();
 		else
 		{
+			iterator next(next_node(pos.ptr), this);
 			node* y = erase_rebalance(pos.ptr);
-			delete y;
+			destroy_node(y);
 			--node_count;
+			return next;
 		}
 	}
 	/**
-	 * Returns the number of elements with key
-	 *   that compares equivalent to the specified argument,
-	 *   which is either 1 or 0
-	 *     since this container does not allow duplicates.
-	 * The default method of check the equivalence is !(a < b || b > a)
+	 * unlink the element at pos without destroying it, and hand it over in a node_type.
+	 *
+	 * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
 	 */
-	size_t count(const Key &key) const
+	node_type extract(const_iterator pos)
 	{
-		node *tmp = root;
-		while (tmp != NULL && (Compare()(tmp->data.first, key) || Compare()(key, tmp->data.first)))
-		{
-			if (Compare()(tmp->data.first, key))
-				tmp = tmp->right;
-			else
-				tmp = tmp->left;
-		}
-		if (tmp == NULL)
-			return 0;
-		else
-			return 1;
+		if (pos.ptr == NULL || pos.ptr == header || pos.container != this)
+			throw invalid_iterator();
+		return node_type(unlink(pos.ptr), alloc);
 	}
 	/**
-	 * Finds an element with key equivalent to key.
-	 * key value of the element to search for.
-	 * Iterator to an element with key equivalent to key.
-	 *   If no such element is found, past-the-end (see end()) iterator is returned.
+	 * like extract(find(key)), but returns an empty node_type if key is not there.
 	 */
-	iterator find(const Key &key)
+	node_type extract(const Key &key)
 	{
-		node *tmp = root;
-		while (tmp != NULL && (Compare()(tmp->data.first, key) || Compare()(key, tmp->data.first)))
-		{
-			if (Compare()(tmp->data.first, key))
-				tmp = tmp->right;
-			else
-				tmp = tmp->left;
-		}
+		node *tmp = find_node(key);
 		if (tmp == NULL)
+			return node_type();
+		return node_type(unlink(tmp), alloc);
+	}
+	/**
+	 * link the node owned by nh back into the tree; nothing is allocated
+	 *   or copied. If its key is already there, nh keeps the node and is
+	 *   returned in the node member of the result.
+	 * a node from a map whose allocator compares unequal is moved into a
+	 *   freshly allocated node instead.
+	 */
+	insert_return_type insert(node_type &&nh)
+	{
+		insert_return_type res = {end(), false, node_type()};
+		if (nh.empty())
+			return res;
+		node *y;
+		bool to_left;
+		if (!get_insert_pos(nh.ptr->data.first, y, to_left))
 		{
-			iterator itr(header, this);
-			return itr;
+			res.position = iterator(y, this);
+			res.node = std::move(nh);
+			return res;
 		}
+		if (alloc == nh.node_alloc())
+			res.position = insert_node(nh.release(), y, to_left);
 		else
 		{
-			iterator itr(tmp, this);
-			return itr;
+			res.position = insert_node(create_node(std::move(nh.key()), std::move(nh.mapped())), y, to_left);
+			nh.reset();
 		}
+		res.inserted = true;
+		return res;
 	}
-	const_iterator find(const Key &key) const
+	iterator insert(const_iterator hint, node_type &&nh)
+	{
+		if (hint.ptr == NULL || hint.container != this)
+			throw invalid_iterator();
+		if (nh.empty())
+			return end();
+		node *y;
+		bool to_left;
+		if (!get_insert_hint_pos(hint.ptr, nh.ptr->data.first, y, to_left))
+			return iterator(y, this);
+		if (alloc == nh.node_alloc())
+			return insert_node(nh.release(), y, to_left);
+		iterator it = insert_node(create_node(std::move(nh.key()), std::move(nh.mapped())), y, to_left);
+		nh.reset();
+		return it;
+	}
+	/**
+	 * erase the elements in [first, last), return last.
+	 *   a range holding more than half of the map is removed by relinking
+	 *   the remaining nodes into a new balanced tree in one pass instead of
+	 *   rebalancing after every single erase.
+	 *
+	 * throw if first or last does not belong to this.
+	 */
+	iterator erase(const_iterator first, const_iterator last)
 	{
-		node *tmp = root;
-		while (tmp != NULL && (Compare()(tmp->data.first, key) || Compare()(key, tmp->data.first)))
+		if (first.ptr == NULL || last.ptr == NULL || first.container != this || last.container != this)
+			throw invalid_iterator();
+		if (first.ptr == header->left && last.ptr == header)
 		{
-			if (Compare()(tmp->data.first, key))
-				tmp = tmp->right;
-			else
-				tmp = tmp->left;
+			clear();
+			return end();
 		}
-		if (tmp == NULL)
+		size_t k = 0;
+		for (node *x = first.ptr; x != last.ptr; x = next_node(x))
 		{
-			const_iterator itr(header, this);
-			return itr;
+			if (x == header)
+				throw invalid_iterator();
+			++k;
 		}
-		else
+		if (k > node_count / 2)
 		{
-			const_iterator itr(tmp, this);
-			return itr;
+			erase_by_rebuild(first.ptr, last.ptr);
+			return iterator(last.ptr, this);
 		}
+		iterator it(first.ptr, this);
+		while (it.ptr != last.ptr)
+			it = erase(it);
+		return it;
 	}
-	private:
-		iterator insert(const Value &value, node* x, node* y)
-		{
-			node *z;
-			if (y == header || x != NULL || Compare()(value.first, y->data.first))
-			{
-				y->left = new node(value);
-				z = y->left;
-				if (y == header)
-				{
-					root = z;
-					y->right = z;
-					y->parent = z;
-					root->parent = header;
-				}
-				else if (y == header->left)
-					header->left = z;
-			}
-			else
-			{
-				y->right = new node(value);
-				z = y->right;
-				if (y == header->right)
-					header->right = z;
+	/**
+	 * erase the element with key equivalent to key, if any.
+	 * return the number of elements removed (0 or 1).
+	 */
+	size_t erase(const Key &key)
+	{
+		node *tmp = find_node(key);
+		if (tmp == NULL)
+			return 0;
+		erase(iterator(tmp, this));
+		return 1;
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent,
+		class = typename std::enable_if<!std::is_convertible<K, iterator>::value && !std::is_convertible<K, const_iterator>::value>::type>
+	size_t erase(const K &key)
+	{
+		node *tmp = find_node(key);
+		if (tmp == NULL)
+			return 0;
+		erase(iterator(tmp, this));
+		return 1;
+	}
+	/**
+	 * insert every value of [first, last) whose key is not there yet; when a
+	 *   key repeats in the batch the first value wins, as with a loop of insert.
+	 *   The elements may be of any pair type value_type can be built from.
+	 *   The batch is sorted (by iterator) and applied in key order, see
+	 *   insert_sorted_run. return the number of elements inserted.
+	 */
+	template<class ForwardIt>
+	size_t insert_batch(ForwardIt first, ForwardIt last)
+	{
+		std::vector<ForwardIt> run;
+		for (; first != last; ++first)
+			run.push_back(first);
+		std::stable_sort(run.begin(), run.end(), [this](const ForwardIt &a, const ForwardIt &b) {
+			return comp()((*a).first, (*b).first);
+		});
+		return insert_sorted_run(run.begin(), run.end(), run.size(),
+			[](typename std::vector<ForwardIt>::iterator it) -> decltype(**it) { return **it; });
+	}
+	/**
+	 * insert_batch for a batch already sorted by strictly increasing key.
+	 */
+	template<class ForwardIt>
+	size_t insert_batch(sorted_unique_t, ForwardIt first, ForwardIt last)
+	{
+		return insert_sorted_run(first, last, static_cast<size_t>(std::distance(first, last)),
+			[](ForwardIt it) -> decltype(*it) { return *it; });
+	}
+	/**
+	 * erase every key of [first, last) that is there, in key order; the keys
+	 *   may be of any type Compare takes alongside Key.
+	 *   return the number of elements erased.
+	 */
+	template<class ForwardIt>
+	size_t erase_batch(ForwardIt first, ForwardIt last)
+	{
+		std::vector<ForwardIt> run;
+		for (; first != last; ++first)
+			run.push_back(first);
+		std::sort(run.begin(), run.end(), [this](const ForwardIt &a, const ForwardIt &b) {
+			return comp()(*a, *b);
+		});
+		return erase_sorted_run(run.begin(), run.end(), run.size(),
+			[](typename std::vector<ForwardIt>::iterator it) -> decltype(**it) { return **it; });
+	}
+	/**
+	 * erase_batch for keys already sorted in increasing order.
+	 */
+	template<class ForwardIt>
+	size_t erase_batch(sorted_unique_t, ForwardIt first, ForwardIt last)
+	{
+		return erase_sorted_run(first, last, static_cast<size_t>(std::distance(first, last)),
+			[](ForwardIt it) -> decltype(*it) { return *it; });
+	}
+	/**
+	 * Returns the number of elements with key
+	 *   that compares equivalent to the specified argument,
+	 *   which is either 1 or 0
+	 *     since this container does not allow duplicates.
+	 * The default method of check the equivalence is !(a < b || b > a)
+	 */
+	size_t count(const Key &key) const
+	{
+		node *tmp = find_node(key);
+		if (tmp == NULL)
+			return 0;
+		else
+			return 1;
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	size_t count(const K &key) const
+	{
+		return find_node(key) == NULL ? 0 : 1;
+	}
+	/**
+	 * checks whether there is an element with key equivalent to key.
+	 */
+	bool contains(const Key &key) const
+	{
+		return find_node(key) != NULL;
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	bool contains(const K &key) const
+	{
+		return find_node(key) != NULL;
+	}
+	/**
+	 * Finds an element with key equivalent to key.
+	 * key value of the element to search for.
+	 * Iterator to an element with key equivalent to key.
+	 *   If no such element is found, past-the-end (see end()) iterator is returned.
+	 */
+	iterator find(const Key &key)
+	{
+		node *tmp = find_node(key);
+		if (tmp == NULL)
+		{
+			iterator itr(header, this);
+			return itr;
+		}
+		else
+		{
+			iterator itr(tmp, this);
+			return itr;
+		}
+	}
+	const_iterator find(const Key &key) const
+	{
+		node *tmp = find_node(key);
+		if (tmp == NULL)
+		{
+			const_iterator itr(header, this);
+			return itr;
+		}
+		else
+		{
+			const_iterator itr(tmp, this);
+			return itr;
+		}
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	iterator find(const K &key)
+	{
+		node *tmp = find_node(key);
+		return iterator(tmp == NULL ? header : tmp, this);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	const_iterator find(const K &key) const
+	{
+		node *tmp = find_node(key);
+		return const_iterator(tmp == NULL ? header : tmp, this);
+	}
+	/**
+	 * iterator to the first element whose key is not less than key,
+	 *   or end() if there is none.
+	 */
+	iterator lower_bound(const Key &key)
+	{
+		return iterator(lower_bound_node(key), this);
+	}
+	const_iterator lower_bound(const Key &key) const
+	{
+		return const_iterator(lower_bound_node(key), this);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	iterator lower_bound(const K &key)
+	{
+		return iterator(lower_bound_node(key), this);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	const_iterator lower_bound(const K &key) const
+	{
+		return const_iterator(lower_bound_node(key), this);
+	}
+	/**
+	 * iterator to the first element whose key is greater than key,
+	 *   or end() if there is none.
+	 */
+	iterator upper_bound(const Key &key)
+	{
+		return iterator(upper_bound_node(key), this);
+	}
+	const_iterator upper_bound(const Key &key) const
+	{
+		return const_iterator(upper_bound_node(key), this);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	iterator upper_bound(const K &key)
+	{
+		return iterator(upper_bound_node(key), this);
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	const_iterator upper_bound(const K &key) const
+	{
+		return const_iterator(upper_bound_node(key), this);
+	}
+	/**
+	 * the range of elements with key equivalent to key, i.e. [lower_bound, upper_bound).
+	 */
+	pair<iterator, iterator> equal_range(const Key &key)
+	{
+		return pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+	}
+	pair<const_iterator, const_iterator> equal_range(const Key &key) const
+	{
+		return pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	pair<iterator, iterator> equal_range(const K &key)
+	{
+		return pair<iterator, iterator>(lower_bound(key), upper_bound(key));
+	}
+	template<class K, class C = Compare, class = typename C::is_transparent>
+	pair<const_iterator, const_iterator> equal_range(const K &key) const
+	{
+		return pair<const_iterator, const_iterator>(lower_bound(key), upper_bound(key));
+	}
+	/**
+	 * call fn on every element with lo <= key < hi, in increasing order.
+	 *   both ends are located once, the walk in between needs no comparisons.
+	 *   nothing is visited unless lo < hi.
+	 */
+	template<class F>
+	F for_each_in_range(const Key &lo, const Key &hi, F fn)
+	{
+		if (!comp()(lo, hi))
+			return fn;
+		node *last = lower_bound_node(hi);
+		for (node *x = lower_bound_node(lo); x != last && x != header; x = next_node(x))
+			fn(x->data);
+		return fn;
+	}
+	template<class F>
+	F for_each_in_range(const Key &lo, const Key &hi, F fn) const
+	{
+		if (!comp()(lo, hi))
+			return fn;
+		node *last = lower_bound_node(hi);
+		for (node *x = lower_bound_node(lo); x != last && x != header; x = next_node(x))
+			fn(static_cast<const value_type &>(x->data));
+		return fn;
+	}
+	/**
+	 * find for every key in [first, last): writes an iterator per key to out
+	 *   (end() for a missing key) and returns the advanced out.
+	 *   the searches of neighbouring keys are interleaved, see find_node_batch.
+	 */
+	template<class ForwardIt, class OutputIt>
+	OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out)
+	{
+		find_node_batch(first, last, [&](node *x) { *out++ = iterator(x == NULL ? header : x, this); });
+		return out;
+	}
+	template<class ForwardIt, class OutputIt>
+	OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) const
+	{
+		find_node_batch(first, last, [&](node *x) { *out++ = const_iterator(x == NULL ? header : x, this); });
+		return out;
+	}
+	/**
+	 * count for every key in [first, last): writes 0 or 1 per key to out.
+	 */
+	template<class ForwardIt, class OutputIt>
+	OutputIt count_batch(ForwardIt first, ForwardIt last, OutputIt out) const
+	{
+		find_node_batch(first, last, [&](node *x) { *out++ = static_cast<size_t>(x == NULL ? 0 : 1); });
+		return out;
+	}
+	/**
+	 * the following need the order_statistic policy (Augment::has_size)
+	 *   and run in O(log n).
+	 * rank: the number of elements whose key is less than key.
+	 */
+	template<class A = Augment, class = typename std::enable_if<A::has_size>::type>
+	size_t rank(const Key &key) const
+	{
+		size_t r = 0;
+		node *x = root;
+		while (x != NULL)
+		{
+			if (comp()(x->data.first, key))
+			{
+				r += size_of(x->left) + 1;
+				x = x->right;
+			}
+			else
+				x = x->left;
+		}
+		return r;
+	}
+	/**
+	 * select: iterator to the k-th smallest element (counting from 0), end() if k >= size().
+	 */
+	template<class A = Augment, class = typename std::enable_if<A::has_size>::type>
+	iterator select(size_t k)
+	{
+		return iterator(k >= node_count ? header : node_at(k), this);
+	}
+	template<class A = Augment, class = typename std::enable_if<A::has_size>::type>
+	const_iterator select(size_t k) const
+	{
+		return const_iterator(k >= node_count ? header : node_at(k), this);
+	}
+	/**
+	 * distance: the number of increments needed to get from first to last
+	 *   (negative if last comes before first).
+	 */
+	template<class A = Augment, class = typename std::enable_if<A::has_size>::type>
+	ptrdiff_t distance(const_iterator first, const_iterator last) const
+	{
+		return index_of(last.ptr) - index_of(first.ptr);
+	}
+	/**
+	 * fold the elements with lo <= key < hi with the monoid of monoid_augment,
+	 *   in key order. Only the two boundary paths are walked, so this is O(log n).
+	 *   the identity is returned for an empty range.
+	 */
+	template<class A = Augment, class M = typename A::monoid>
+	typename M::value_type aggregate(const Key &lo, const Key &hi) const
+	{
+		node *x = root;
+		while (x != NULL)
+		{
+			if (comp()(x->data.first, lo))
+				x = x->right;
+			else if (!comp()(x->data.first, hi))
+				x = x->left;
+			else
+				break;
+		}
+		if (x == NULL)
+			return M::identity();
+		// x is the topmost node inside the range; its left subtree is cut by lo, its right one by hi.
+		typename M::value_type l = M::identity();
+		for (node *y = x->left; y != NULL; )
+		{
+			if (!comp()(y->data.first, lo))
+			{
+				if (y->right != NULL)
+					l = M::combine(summary_of(y->right)->value, l);
+				l = M::combine(M::lift(y->data.first, y->data.second), l);
+				y = y->left;
+			}
+			else
+				y = y->right;
+		}
+		typename M::value_type r = M::identity();
+		for (node *y = x->right; y != NULL; )
+		{
+			if (comp()(y->data.first, hi))
+			{
+				if (y->left != NULL)
+					r = M::combine(r, summary_of(y->left)->value);
+				r = M::combine(r, M::lift(y->data.first, y->data.second));
+				y = y->right;
+			}
+			else
+				y = y->left;
+		}
+		return M::combine(M::combine(l, M::lift(x->data.first, x->data.second)), r);
+	}
+	/**
+	 * recompute the summaries that depend on the element at pos,
+	 *   after its mapped value was changed in place. O(log n) with an
+	 *   augmenting policy, nothing otherwise.
+	 */
+	void refresh(const_iterator pos)
+	{
+		if (pos.ptr == NULL || pos.ptr == header || pos.container != this)
+			throw invalid_iterator();
+		update_path(pos.ptr);
+	}
+	/**
+	 * replace the contents with left, pivot and right, which must all be
+	 *   in order (keys of left < pivot.first < keys of right); left and
+	 *   right are emptied and their nodes are reused, only the pivot is
+	 *   allocated. O(log n).
+	 * if the order does not hold, or the allocators differ, the elements are
+	 *   merged one by one instead (and duplicates stay in left / right).
+	 */
+	void join(map &left, const value_type &pivot, map &right)
+	{
+		if (&left == &right)
+		{
+			if (this != &left)
+			{
+				clear();
+				merge(left);
+			}
+			insert(pivot);
+			return;
+		}
+		if (this != &left && this != &right)
+			clear();
+		bool in_order = (left.empty() || comp()(left.header->right->data.first, pivot.first))
+			&& (right.empty() || comp()(pivot.first, right.header->left->data.first));
+		if (!in_order || !(alloc == left.alloc) || !(alloc == right.alloc))
+		{
+			insert(pivot);
+			if (this != &left)
+				merge(left);
+			if (this != &right)
+				merge(right);
+			return;
+		}
+		size_t n = left.node_count + right.node_count + 1;
+		node *k = create_node(pivot);
+		node *l = left.detach(), *r = right.detach();
+		attach(join_trees(l, k, r), n);
+	}
+	/**
+	 * move all the elements of other into this, other is emptied.
+	 *   when all keys of other are greater (or all smaller) than those
+	 *   of this, the trees are joined in O(log n) without any allocation;
+	 *   otherwise this falls back to merge(other).
+	 */
+	void join(map &other)
+	{
+		if (this == &other || other.root == NULL)
+			return;
+		if (!(alloc == other.alloc))
+		{
+			merge(other);
+			return;
+		}
+		if (root == NULL)
+		{
+			steal(other);
+			return;
+		}
+		size_t n = node_count + other.node_count;
+		if (comp()(header->right->data.first, other.header->left->data.first))
+		{
+			node *k = other.unlink(other.header->left);
+			node *l = detach(), *r = other.detach();
+			attach(join_trees(l, k, r), n);
+		}
+		else if (comp()(other.header->right->data.first, header->left->data.first))
+		{
+			node *k = unlink(header->left);
+			node *r = detach(), *l = other.detach();
+			attach(join_trees(l, k, r), n);
+		}
+		else
+			merge(other);
+	}
+	/**
+	 * keep the elements with key < key and return a map holding the others;
+	 *   the nodes are reused, so the result shares this map's allocator.
+	 *   O(log n) with order_statistic. Other policies keep no sizes, so the
+	 *   smaller part is walked to count it: O(log n + size of the smaller part).
+	 */
+	map split(const Key &key)
+	{
+		map r(comp(), get_allocator());
+		if (root == NULL)
+			return r;
+		size_t n = node_count;
+		node *t = detach(), *lt, *rt;
+		int hl, hr;
+		split_tree(t, black_height(t), key, lt, hl, rt, hr);
+		attach(lt, 0);
+		r.attach(rt, 0);
+		node_count = left_part_size(*this, r, n, std::integral_constant<bool, Augment::has_size>());
+		r.node_count = n - node_count;
+		return r;
+	}
+	/**
+	 * move the elements of other whose keys are not in this yet into this,
+	 *   the others stay in other. Nodes are relinked, not copied, when the
+	 *   allocators compare equal; disjoint key ranges are joined in O(log n).
+	 */
+	void merge(map &other)
+	{
+		if (this == &other || other.root == NULL)
+			return;
+		if (!(alloc == other.alloc))
+		{
+			for (iterator it = other.begin(); it != other.end(); )
+			{
+				if (insert(std::move(*it)).second)
+					it = other.erase(it);
+				else
+					++it;
+			}
+			return;
+		}
+		if (root != NULL && (comp()(header->right->data.first, other.header->left->data.first)
+			|| comp()(other.header->right->data.first, header->left->data.first)))
+		{
+			join(other);
+			return;
+		}
+		for (node *x = other.header->left; x != other.header; )
+		{
+			node *next = other.next_node(x);
+			node *y;
+			bool to_left;
+			if (get_insert_pos(x->data.first, y, to_left))
+				insert_node(other.unlink(x), y, to_left);
+			x = next;
+		}
+	}
+	/**
+	 * check the structure in O(n): key order, parent links, no red node with
+	 *   a red child, equal black heights, the header links and the size.
+	 */
+	bool check_invariants() const
+	{
+		if (header->parent() != root)
+			return false;
+		if (root == NULL)
+			return node_count == 0 && header->left == header && header->right == header;
+		if (root->parent() != header || root->color() != 1)
+			return false;
+		if (header->left != const_cast<map*>(this)->minimum(root) || header->right != const_cast<map*>(this)->maximum(root))
+			return false;
+		size_t n = 0;
+		if (check_subtree(root, n) < 0 || n != node_count)
+			return false;
+		for (node *x = header->left; x != header->right; x = next_node(x))
+			if (!comp()(x->data.first, next_node(x)->data.first))
+				return false;
+		return true;
+	}
+	private:
+		// black height of x, -1 if the subtree is broken.
+		int check_subtree(node *x, size_t &n) const
+		{
+			if (x == NULL)
+				return 0;
+			++n;
+			if ((x->left != NULL && x->left->parent() != x) || (x->right != NULL && x->right->parent() != x))
+				return -1;
+			if (x->color() == 0 && ((x->left != NULL && x->left->color() == 0) || (x->right != NULL && x->right->color() == 0)))
+				return -1;
+			int l = check_subtree(x->left, n), r = check_subtree(x->right, n);
+			if (l < 0 || r < 0 || l != r)
+				return -1;
+			return l + x->color();
+		}
+
+		// position of x in the sorted order, size() for the header.
+		ptrdiff_t index_of(node *x) const
+		{
+			if (x == header)
+				return node_count;
+			ptrdiff_t i = size_of(x->left);
+			for (node *p = x->parent(); p != header; x = p, p = p->parent())
+			{
+				if (x == p->right)
+					i += size_of(p->left) + 1;
+			}
+			return i;
+		}
+
+		// the node at position i, clamped to begin() / end() when i is out of range.
+		node* node_at(ptrdiff_t i) const
+		{
+			if (i <= 0)
+				return header->left;
+			if (static_cast<size_t>(i) >= node_count)
+				return header;
+			size_t k = i;
+			node *x = root;
+			while (true)
+			{
+				size_t l = size_of(x->left);
+				if (k < l)
+					x = x->left;
+				else if (k == l)
+					return x;
+				else
+				{
+					k -= l + 1;
+					x = x->right;
+				}
+			}
+		}
+
+		/**
+		 * the node with key equivalent to key, NULL if there is none.
+		 *   the descent is the one of lower_bound_node (one comparison per level),
+		 *   equality is checked once at the end.
+		 */
+		template<class K>
+		node* find_node(const K &key) const
+		{
+			node *y = lower_bound_node(key);
+			if (y == header || comp()(key, y->data.first))
+				return NULL;
+			return y;
+		}
+
+		static void prefetch(const node *x)
+		{
+#if defined(__GNUC__)
+			__builtin_prefetch(x);
+			if (sizeof(node) > 64)
+				__builtin_prefetch(&x->left);
+#else
+			(void)x;
+#endif
+		}
+
+		/**
+		 * find_node for every key in [first, last), emit(node *) called in input order.
+		 *   batch_width searches descend in lockstep: each step advances all of
+		 *   them by one level and prefetches the child each goes to next, so the
+		 *   cache misses of different searches overlap.
+		 */
+		static const size_t batch_width = 8;
+		// a sorted run of more than node_count / batch_rebuild_ratio values is merged by a rebuild.
+		static const size_t batch_rebuild_ratio = 4;
+		template<class ForwardIt, class F>
+		void find_node_batch(ForwardIt first, ForwardIt last, F emit) const
+		{
+			const Key *keys[batch_width];
+			node *x[batch_width];
+			node *y[batch_width];
+			while (first != last)
+			{
+				size_t n = 0;
+				for (; n < batch_width && first != last; ++n, ++first)
+				{
+					keys[n] = &*first;
+					x[n] = root;
+					y[n] = header;
+				}
+				bool active = true;
+				while (active)
+				{
+					active = false;
+					for (size_t i = 0; i < n; ++i)
+					{
+						if (x[i] == NULL)
+							continue;
+						if (!comp()(x[i]->data.first, *keys[i]))
+						{
+							y[i] = x[i];
+							x[i] = x[i]->left;
+						}
+						else
+							x[i] = x[i]->right;
+						if (x[i] != NULL)
+						{
+							prefetch(x[i]);
+							active = true;
+						}
+					}
+				}
+				for (size_t i = 0; i < n; ++i)
+					emit((y[i] == header || comp()(*keys[i], y[i]->data.first)) ? NULL : y[i]);
+			}
+		}
+
+		template<class K>
+		node* lower_bound_node(const K &key) const
+		{
+			node *y = header;
+			node *x = root;
+			while (x != NULL)
+			{
+				if (!comp()(x->data.first, key))
+				{
+					y = x;
+					x = x->left;
+				}
+				else
+					x = x->right;
 			}
-			z->parent = y;
+			return y;
+		}
+
+		template<class K>
+		node* upper_bound_node(const K &key) const
+		{
+			node *y = header;
+			node *x = root;
+			while (x != NULL)
+			{
+				if (comp()(key, x->data.first))
+				{
+					y = x;
+					x = x->left;
+				}
+				else
+					x = x->right;
+			}
+			return y;
+		}
+
+		/**
+		 * lower_bound_node(key) for a key not less than the one of finger
+		 *   (header: no finger), found from finger instead of the root: climb
+		 *   while the subtree above cannot reach key, then descend. The cost
+		 *   grows with the log of the distance between the two, not of n.
+		 */
+		node* finger_lower_bound(node *finger, const Key &key) const
+		{
+			if (finger == header)
+				return lower_bound_node(key);
+			node *u = finger;
+			node *a;
+			while (true)
+			{
+				while (u != root && u == u->parent()->right)
+					u = u->parent();
+				a = (u == root) ? header : u->parent();
+				if (a == header || !comp()(a->data.first, key))
+					break;
+				u = a;
+			}
+			node *y = a;
+			for (node *x = u; x != NULL; )
+			{
+				if (!comp()(x->data.first, key))
+				{
+					y = x;
+					x = x->left;
+				}
+				else
+					x = x->right;
+			}
+			return y;
+		}
+
+		// in-order predecessor of x, which must not be the first element.
+		node* prev_node(node *x) const
+		{
+			if (x == header)
+				return header->right;
+			if (x->left != NULL)
+			{
+				x = x->left;
+				while (x->right != NULL)
+					x = x->right;
+				return x;
+			}
+			node *p = x->parent();
+			while (x == p->left)
+			{
+				x = p;
+				p = p->parent();
+			}
+			return p;
+		}
+
+		// attach z right before y (header: at the end), no comparisons needed.
+		node* insert_before(node *z, node *y)
+		{
+			if (node_count == 0)
+				insert_node(z, header, true);
+			else if (y == header)
+				insert_node(z, header->right, false);
+			else if (y->left == NULL)
+				insert_node(z, y, true);
+			else
+				insert_node(z, prev_node(y), false);
+			return z;
+		}
+
+		// in-order successor of x, header after the last element.
+		node* next_node(node *x) const
+		{
+			if (x->right != NULL)
+			{
+				x = x->right;
+				while (x->left != NULL)
+					x = x->left;
+				return x;
+			}
+			node *p = x->parent();
+			while (p != header && x == p->right)
+			{
+				x = p;
+				p = p->parent();
+			}
+			return p;
+		}
+
+		/**
+		 * find the node under which key has to be attached.
+		 * return false if key is already there, y is then the node holding it.
+		 */
+		bool get_insert_pos(const Key &key, node* &y, bool &to_left)
+		{
+			y = header;
+			node *x = root;
+			bool less = true;
+			while (x != NULL)
+			{
+				y = x;
+				less = comp()(key, x->data.first);
+				x = less ? x->left : x->right;
+			}
+			to_left = less;
+			iterator j(y, this);
+			if (less)
+			{
+				if (j == begin())
+					return true;
+				else
+					--j;
+			}
+			if (comp()(j.ptr->data.first, key))
+				return true;
+			y = j.ptr;
+			return false;
+		}
+
+		/**
+		 * like get_insert_pos, but first try to attach key right next to hint.
+		 *   a correct hint costs O(1) comparisons, otherwise we fall back to the descent.
+		 */
+		bool get_insert_hint_pos(node *hint, const Key &key, node* &y, bool &to_left)
+		{
+			if (hint == header)
+			{
+				if (node_count > 0 && comp()(header->right->data.first, key))
+				{
+					y = header->right;
+					to_left = false;
+					return true;
+				}
+				return get_insert_pos(key, y, to_left);
+			}
+			if (comp()(key, hint->data.first))
+			{
+				if (hint == header->left)
+				{
+					y = hint;
+					to_left = true;
+					return true;
+				}
+				iterator before(hint, this);
+				--before;
+				if (comp()(before.ptr->data.first, key))
+				{
+					if (before.ptr->right == NULL)
+					{
+						y = before.ptr;
+						to_left = false;
+					}
+					else
+					{
+						y = hint;
+						to_left = true;
+					}
+					return true;
+				}
+				return get_insert_pos(key, y, to_left);
+			}
+			if (comp()(hint->data.first, key))
+			{
+				if (hint == header->right)
+				{
+					y = hint;
+					to_left = false;
+					return true;
+				}
+				iterator after(hint, this);
+				++after;
+				if (comp()(key, after.ptr->data.first))
+				{
+					if (hint->right == NULL)
+					{
+						y = hint;
+						to_left = false;
+					}
+					else
+					{
+						y = after.ptr;
+						to_left = true;
+					}
+					return true;
+				}
+				return get_insert_pos(key, y, to_left);
+			}
+			y = hint;
+			return false;
+		}
+
+		iterator insert_node(node *z, node* y, bool to_left)
+		{
+			if (y == header || to_left)
+			{
+				y->left = z;
+				if (y == header)
+				{
+					root = z;
+					y->right = z;
+					y->set_parent(z);
+					root->set_parent(header);
+				}
+				else if (y == header->left)
+					header->left = z;
+			}
+			else
+			{
+				y->right = z;
+				if (y == header->right)
+					header->right = z;
+			}
+			z->set_parent(y);
+			update_path(z);
 			insert_rebalance(z);
 			++node_count;
 			return iterator(z, this);
@@ -1080,6 +3139,13 @@ public:
 
 };
 
+template<class Key, class T, class Compare, class Allocator, class Augment>
+void swap(map<Key, T, Compare, Allocator, Augment> &lhs, map<Key, T, Compare, Allocator, Augment> &rhs)
+	noexcept(noexcept(lhs.swap(rhs)))
+{
+	lhs.swap(rhs);
+}
+
 }
 
 #endif
@@ -0,0 +1,323 @@
+/**
+ * a map with O(1) copies and snapshots
+ */
+#ifndef SJTU_PERSISTENT_MAP_HPP
+#define SJTU_PERSISTENT_MAP_HPP
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "persistent_tree.hpp"
+
+namespace sjtu {
+
+template<class Key, class T, class Compare> class concurrent_map;
+
+/**
+ * persistent_map keeps its elements in a persistent_tree, so copying it (or
+ *   taking a snapshot()) only shares the root. The copies are independent
+ *   maps afterwards: a write copies the O(log n) nodes on its path that are
+ *   still shared, and changes the others in place.
+ *
+ * different persistent_map objects may be used from different threads even
+ *   when they share nodes; one object is not synchronised.
+ *
+ * any write invalidates the iterators of the written map, but not those of
+ *   its snapshots.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>
+> class persistent_map
+{
+	friend class concurrent_map<Key, T, Compare>;
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+
+private:
+	typedef persistent_tree<Key, T, Compare> tree_type;
+	typedef typename tree_type::node node;
+
+	tree_type tree;
+	node *root;
+	size_t count_;
+
+	// take over one reference to the version rooted at r.
+	persistent_map(const Compare &c, node *r, size_t n) : tree(c), root(r), count_(n) {}
+
+public:
+	/**
+	 * an in-order walk that keeps the nodes still to be visited above the
+	 *   current one on a stack, as there are no parent pointers to go back up.
+	 */
+	class const_iterator
+	{
+		friend class persistent_map;
+	private:
+		const node *stack[tree_type::max_height];
+		int depth;
+
+		void push_left(const node *x)
+		{
+			while (x != NULL)
+			{
+				stack[depth++] = x;
+				x = x->left;
+			}
+		}
+
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef typename persistent_map::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		const_iterator() : depth(0) {}
+		const_iterator(const const_iterator &other) : depth(other.depth)
+		{
+			for (int i = 0; i < depth; ++i)
+				stack[i] = other.stack[i];
+		}
+		const_iterator & operator=(const const_iterator &other)
+		{
+			depth = other.depth;
+			for (int i = 0; i < depth; ++i)
+				stack[i] = other.stack[i];
+			return *this;
+		}
+
+		const value_type & operator*() const
+		{
+			if (depth == 0)
+				throw invalid_iterator();
+			return stack[depth - 1]->data;
+		}
+		const value_type * operator->() const noexcept
+		{
+			return &stack[depth - 1]->data;
+		}
+		const_iterator & operator++()
+		{
+			if (depth == 0)
+				throw invalid_iterator();
+			const node *x = stack[--depth];
+			push_left(x->right);
+			return *this;
+		}
+		const_iterator operator++(int)
+		{
+			const_iterator tmp = *this;
+			++*this;
+			return tmp;
+		}
+		bool operator==(const const_iterator &rhs) const
+		{
+			if (depth == 0 || rhs.depth == 0)
+				return depth == rhs.depth;
+			return stack[depth - 1] == rhs.stack[rhs.depth - 1];
+		}
+		bool operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+
+	persistent_map() : tree(), root(NULL), count_(0) {}
+	explicit persistent_map(const Compare &c) : tree(c), root(NULL), count_(0) {}
+	/**
+	 * O(1): the copy shares every node with other.
+	 */
+	persistent_map(const persistent_map &other) : tree(other.tree.key_comp()), root(tree_type::share(other.root)), count_(other.count_) {}
+	persistent_map(persistent_map &&other) noexcept : tree(other.tree.key_comp()), root(other.root), count_(other.count_)
+	{
+		other.root = NULL;
+		other.count_ = 0;
+	}
+	persistent_map & operator=(const persistent_map &other)
+	{
+		if (this == &other)
+			return *this;
+		node *r = tree_type::share(other.root);
+		tree_type::release(root);
+		tree = tree_type(other.tree.key_comp());
+		root = r;
+		count_ = other.count_;
+		return *this;
+	}
+	persistent_map & operator=(persistent_map &&other) noexcept
+	{
+		if (this == &other)
+			return *this;
+		tree_type::release(root);
+		tree = tree_type(other.tree.key_comp());
+		root = other.root;
+		count_ = other.count_;
+		other.root = NULL;
+		other.count_ = 0;
+		return *this;
+	}
+	~persistent_map()
+	{
+		tree_type::release(root);
+	}
+
+	/**
+	 * a point-in-time copy in O(1); it can be read (or written) from another
+	 *   thread while this map keeps changing.
+	 */
+	persistent_map snapshot() const
+	{
+		return *this;
+	}
+
+	void swap(persistent_map &other)
+	{
+		persistent_map tmp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(tmp);
+	}
+
+	/**
+	 * access specified element with bounds checking
+	 * If no such element exists, an exception of type `index_out_of_bound'
+	 */
+	const T & at(const Key &key) const
+	{
+		node *x = tree.find(root, key);
+		if (x == NULL)
+			throw index_out_of_bound();
+		return x->data.second;
+	}
+
+	const_iterator begin() const
+	{
+		const_iterator it;
+		it.push_left(root);
+		return it;
+	}
+	const_iterator cbegin() const
+	{
+		return begin();
+	}
+	const_iterator end() const
+	{
+		return const_iterator();
+	}
+	const_iterator cend() const
+	{
+		return end();
+	}
+
+	bool empty() const
+	{
+		return count_ == 0;
+	}
+
+	size_t size() const
+	{
+		return count_;
+	}
+
+	void clear()
+	{
+		tree_type::release(root);
+		root = NULL;
+		count_ = 0;
+	}
+
+	/**
+	 * insert value unless its key is already there; true if it was inserted.
+	 */
+	bool insert(const value_type &value)
+	{
+		if (!tree.insert_into(root, false, value.first, value.second))
+			return false;
+		++count_;
+		return true;
+	}
+
+	/**
+	 * map key to obj, replacing the old value if any; true if key was not there.
+	 */
+	bool insert_or_assign(const Key &key, const T &obj)
+	{
+		if (!tree.insert_into(root, true, key, obj))
+			return false;
+		++count_;
+		return true;
+	}
+
+	/**
+	 * erase the element with key; the number of elements erased (0 or 1).
+	 */
+	size_t erase(const Key &key)
+	{
+		if (!tree.erase_from(root, key))
+			return 0;
+		--count_;
+		return 1;
+	}
+
+	size_t count(const Key &key) const
+	{
+		return tree.find(root, key) != NULL ? 1 : 0;
+	}
+
+	bool contains(const Key &key) const
+	{
+		return count(key) != 0;
+	}
+
+	/**
+	 * the iterator to the element with key, or end() if there is none.
+	 */
+	const_iterator find(const Key &key) const
+	{
+		const_iterator it = lower_bound(key);
+		if (it.depth != 0 && tree.key_comp()(key, it->first))
+			return end();
+		return it;
+	}
+
+	/**
+	 * the first element whose key is not less than key. The nodes where the
+	 *   descent turns left are exactly the ones an in-order walk has yet to visit.
+	 */
+	const_iterator lower_bound(const Key &key) const
+	{
+		const_iterator it;
+		const node *x = root;
+		while (x != NULL)
+		{
+			if (!tree.key_comp()(x->data.first, key))
+			{
+				it.stack[it.depth++] = x;
+				x = x->left;
+			}
+			else
+				x = x->right;
+		}
+		return it;
+	}
+
+	const Compare & key_comp() const
+	{
+		return tree.key_comp();
+	}
+};
+
+template<class Key, class T, class Compare>
+void swap(persistent_map<Key, T, Compare> &lhs, persistent_map<Key, T, Compare> &rhs)
+{
+	lhs.swap(rhs);
+}
+
+}
+
+#endif
@@ -0,0 +1,622 @@
+/**
+ * a red-black tree with path copying, the core of concurrent_map and persistent_map
+ */
+#ifndef SJTU_PERSISTENT_TREE_HPP
+#define SJTU_PERSISTENT_TREE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include "utility.hpp"
+
+namespace sjtu {
+
+/**
+ * persistent_tree never changes a node that may already be visible: every
+ *   write copies the nodes it touches (the search path, plus the siblings
+ *   that rebalancing recolors) and returns the root of a new version, the
+ *   old version stays intact. Versions share all the untouched subtrees.
+ *
+ * a node counts the links and root handles that point to it; a version is
+ *   owned through one reference to its root and given back with release().
+ *   Only the reference counts of published nodes are ever written, so any
+ *   number of threads may read a version while one thread writes.
+ *
+ * a write either keeps the old version (insert / erase) or gives it up
+ *   (insert_into / erase_from). In the second form a node is changed in
+ *   place instead of copied when no other version can reach it, that is
+ *   when it and all the nodes above it have a single reference.
+ *
+ * writes through one persistent_tree are not synchronised with each other:
+ *   one writer at a time.
+ *
+ * a write does everything that may throw (building the new element, and
+ *   copying each node it will change) before it changes anything. Those
+ *   copies leave a version with the old elements; if one throws, that
+ *   version is released again, or handed back when the write gives the old
+ *   one up. So a write that throws leaves the elements as they were.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>
+> class persistent_tree
+{
+public:
+	typedef pair<const Key, T> value_type;
+	struct node
+	{
+		value_type data;
+		node *left;
+		node *right;
+		std::atomic<size_t> refs;
+		size_t stamp; // the write that created (or took over) the node, it may be changed in place during that write only
+		int color; //red:0, black:1
+		template<class... Args>
+		node(size_t s, Args&&... args) : data(std::forward<Args>(args)...), left(NULL), right(NULL), refs(1), stamp(s), color(0) {}
+	};
+
+	// a red-black tree of n nodes is at most 2 * log2(n + 1) high.
+	static const int max_height = 2 * 8 * sizeof(size_t) + 2;
+
+private:
+	Compare comp;
+	size_t stamp;
+	bool reuse; // the version being written is given up, its unshared nodes may be changed in place
+
+	// stamps are unique over all trees of this type, since one version can be shared by several trees.
+	static size_t next_stamp()
+	{
+		static std::atomic<size_t> counter(0);
+		return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	static void retain(node *x)
+	{
+		if (x != NULL)
+			x->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// a fresh node of this write with the contents of x; x's children gain a link.
+	node* copy(node *x)
+	{
+		node *m = new node(stamp, x->data);
+		m->left = x->left;
+		m->right = x->right;
+		m->color = x->color;
+		retain(m->left);
+		retain(m->right);
+		return m;
+	}
+
+	/**
+	 * make the node behind link (owned by a fresh node, or the new root)
+	 *   writable in this write: a shared node is replaced by a copy.
+	 *   A copied owner gave its children a second reference, so only the
+	 *   children of a node changed in place can be taken over as well.
+	 */
+	node* make_fresh(node* &link)
+	{
+		node *x = link;
+		if (x->stamp == stamp)
+			return x;
+		if (reuse && x->refs.load(std::memory_order_acquire) == 1)
+		{
+			x->stamp = stamp;
+			return x;
+		}
+		node *m = copy(x);
+		link = m;
+		release(x);
+		return m;
+	}
+
+	// the link that holds path[i]: the root, or a child pointer of path[i - 1].
+	static node* & link_of(node **path, int i, node* &root)
+	{
+		if (i == 0)
+			return root;
+		node *p = path[i - 1];
+		return p->left == path[i] ? p->left : p->right;
+	}
+
+	static void rotate_left(node* &link)
+	{
+		node *x = link;
+		node *y = x->right;
+		x->right = y->left;
+		y->left = x;
+		link = y;
+	}
+
+	static void rotate_right(node* &link)
+	{
+		node *y = link;
+		node *x = y->left;
+		y->left = x->right;
+		x->right = y;
+		link = x;
+	}
+
+	static bool is_black(node *x)
+	{
+		return x == NULL || x->color == 1;
+	}
+
+	/**
+	 * make fresh the uncles insert_rebalance will recolor once a red node is
+	 *   put below path[d - 1], so that it does not copy anything. Recoloring
+	 *   does not change the colors the loop looks at further up.
+	 */
+	void prepare_insert_rebalance(node **path, int d)
+	{
+		for (int i = d; i >= 2 && path[i - 1]->color == 0; i -= 2)
+		{
+			node *g = path[i - 2];
+			node* &u = (path[i - 1] == g->left) ? g->right : g->left;
+			if (is_black(u))
+				return;
+			make_fresh(u);
+		}
+	}
+
+	/**
+	 * path[0 .. d - 1] are the fresh nodes from the root down to the new red node.
+	 */
+	void insert_rebalance(node **path, int d, node* &root)
+	{
+		int i = d - 1;
+		while (i >= 2 && path[i - 1]->color == 0)
+		{
+			node *x = path[i], *p = path[i - 1], *g = path[i - 2];
+			if (p == g->left)
+			{
+				if (!is_black(g->right))
+				{
+					node *u = make_fresh(g->right);
+					p->color = 1;
+					u->color = 1;
+					g->color = 0;
+					i -= 2;
+					continue;
+				}
+				if (x == p->right)
+				{
+					rotate_left(g->left);
+					path[i - 1] = x;
+					path[i] = p;
+					p = x;
+				}
+				p->color = 1;
+				g->color = 0;
+				rotate_right(link_of(path, i - 2, root));
+			}
+			else
+			{
+				if (!is_black(g->left))
+				{
+					node *u = make_fresh(g->left);
+					p->color = 1;
+					u->color = 1;
+					g->color = 0;
+					i -= 2;
+					continue;
+				}
+				if (x == p->left)
+				{
+					rotate_right(g->right);
+					path[i - 1] = x;
+					path[i] = p;
+					p = x;
+				}
+				p->color = 1;
+				g->color = 0;
+				rotate_left(link_of(path, i - 2, root));
+			}
+			break;
+		}
+		root->color = 1;
+	}
+
+	/**
+	 * make fresh the nodes erase_rebalance will change once the black node
+	 *   path[d - 1] is replaced by its only child (or NULL), so that it does
+	 *   not copy anything. The loop below follows the one there, reading the
+	 *   same colors: the recoloring it does further down is never read again.
+	 */
+	void prepare_erase_rebalance(node **path, int d)
+	{
+		node *y = path[d - 1];
+		node* &xl = (y->left != NULL) ? y->left : y->right;
+		if (xl != NULL && xl->color == 0)
+		{
+			make_fresh(xl);
+			return;
+		}
+		// x is black (or NULL) and sits where path[i + 1] is.
+		for (int i = d - 2; i >= 0; --i)
+		{
+			node *xp = path[i];
+			bool left = xp->left == path[i + 1];
+			node *w = make_fresh(left ? xp->right : xp->left);
+			bool terminal = false;
+			if (w->color == 0)
+			{
+				// rotated above xp, the near child of w becomes the sibling.
+				w = make_fresh(left ? w->left : w->right);
+				terminal = true;
+			}
+			node* &near = left ? w->left : w->right;
+			node* &far = left ? w->right : w->left;
+			if (is_black(near) && is_black(far))
+			{
+				if (terminal || xp->color == 0)
+					return;
+				continue;
+			}
+			if (is_black(far))
+				make_fresh(near);
+			else
+				make_fresh(far);
+			return;
+		}
+	}
+
+	/**
+	 * a black node was removed above x; path[0 .. d - 1] are its fresh
+	 *   ancestors, path[d - 1] is the parent of x (which may be NULL).
+	 */
+	void erase_rebalance(node **path, int d, node *x, node* &root)
+	{
+		int i = d - 1;
+		while (i >= 0 && is_black(x))
+		{
+			node *xp = path[i];
+			if (x == xp->left)
+			{
+				node *w = make_fresh(xp->right);
+				if (w->color == 0)
+				{
+					w->color = 1;
+					xp->color = 0;
+					rotate_left(link_of(path, i, root));
+					path[i] = w;
+					path[i + 1] = xp;
+					++i;
+					w = make_fresh(xp->right);
+				}
+				if (is_black(w->left) && is_black(w->right))
+				{
+					w->color = 0;
+					x = xp;
+					--i;
+				}
+				else
+				{
+					if (is_black(w->right))
+					{
+						make_fresh(w->left)->color = 1;
+						w->color = 0;
+						rotate_right(xp->right);
+						w = xp->right;
+					}
+					w->color = xp->color;
+					xp->color = 1;
+					if (w->right != NULL)
+						make_fresh(w->right)->color = 1;
+					rotate_left(link_of(path, i, root));
+					x = NULL;
+					i = -1;
+				}
+			}
+			else
+			{
+				node *w = make_fresh(xp->left);
+				if (w->color == 0)
+				{
+					w->color = 1;
+					xp->color = 0;
+					rotate_right(link_of(path, i, root));
+					path[i] = w;
+					path[i + 1] = xp;
+					++i;
+					w = make_fresh(xp->left);
+				}
+				if (is_black(w->right) && is_black(w->left))
+				{
+					w->color = 0;
+					x = xp;
+					--i;
+				}
+				else
+				{
+					if (is_black(w->left))
+					{
+						make_fresh(w->right)->color = 1;
+						w->color = 0;
+						rotate_left(xp->left);
+						w = xp->left;
+					}
+					w->color = xp->color;
+					xp->color = 1;
+					if (w->left != NULL)
+						make_fresh(w->left)->color = 1;
+					rotate_right(link_of(path, i, root));
+					x = NULL;
+					i = -1;
+				}
+			}
+		}
+		if (x != NULL && x->color == 0)
+		{
+			node* &link = (i < 0) ? root : (path[i]->left == x ? path[i]->left : path[i]->right);
+			make_fresh(link)->color = 1;
+		}
+		if (root != NULL && root->color == 0)
+			make_fresh(root)->color = 1;
+	}
+
+	/**
+	 * copy the search path for key from root; return the depth, path[d - 1] is
+	 *   the node holding key (found) or the one to attach it to.
+	 */
+	int copy_path(node* &root, const Key &key, node **path, bool &found)
+	{
+		if (reuse)
+			make_fresh(root);
+		else
+			root = copy(root);
+		int d = 0;
+		node *cur = root;
+		path[d++] = cur;
+		found = false;
+		while (true)
+		{
+			node **link;
+			if (comp(key, cur->data.first))
+				link = &cur->left;
+			else if (comp(cur->data.first, key))
+				link = &cur->right;
+			else
+			{
+				found = true;
+				return d;
+			}
+			if (*link == NULL)
+				return d;
+			cur = make_fresh(*link);
+			path[d++] = cur;
+		}
+	}
+
+	// put the fresh node m, holding a new value, in place of path[d - 1].
+	static void replace_node(node **path, int d, node* &root, node *m)
+	{
+		node *z = path[d - 1];
+		m->left = z->left;
+		m->right = z->right;
+		m->color = z->color;
+		link_of(path, d - 1, root) = m;
+		path[d - 1] = m;
+		delete z;
+	}
+
+public:
+	persistent_tree() : comp(), stamp(0), reuse(false) {}
+	explicit persistent_tree(const Compare &c) : comp(c), stamp(0), reuse(false) {}
+
+	const Compare & key_comp() const
+	{
+		return comp;
+	}
+
+	/**
+	 * give back one reference to the version rooted at x,
+	 *   freeing the nodes nobody else links to.
+	 */
+	static void release(node *x)
+	{
+		while (x != NULL && x->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			release(x->left);
+			node *r = x->right;
+			delete x;
+			x = r;
+		}
+	}
+
+	/**
+	 * take one more reference to the version rooted at x.
+	 */
+	static node* share(node *x)
+	{
+		retain(x);
+		return x;
+	}
+
+	// the node holding key in the version rooted at x, NULL if there is none.
+	node* find(node *x, const Key &key) const
+	{
+		node *y = NULL;
+		while (x != NULL)
+		{
+			if (!comp(x->data.first, key))
+			{
+				y = x;
+				x = x->left;
+			}
+			else
+				x = x->right;
+		}
+		if (y == NULL || comp(key, y->data.first))
+			return NULL;
+		return y;
+	}
+
+private:
+	/**
+	 * a write threw while r, the version it builds, still had the elements
+	 *   of root: give r back in place of root if the write gives root up,
+	 *   release it otherwise.
+	 */
+	void abandon(node *r, node* &root)
+	{
+		if (reuse)
+			root = r;
+		else if (r != root)
+			release(r);
+	}
+
+	/**
+	 * the version root as changed by the write; with reuse, root is given up,
+	 *   and if the write throws it is set to a version with the same elements.
+	 */
+	template<class... Args>
+	node* insert_impl(node* &root, bool assign, bool &inserted, const Key &key, Args&&... args)
+	{
+		inserted = false;
+		if (find(root, key) != NULL && !assign)
+			return root;
+		stamp = next_stamp();
+		node *z = new node(stamp, key, std::forward<Args>(args)...);
+		if (root == NULL)
+		{
+			z->color = 1;
+			inserted = true;
+			return z;
+		}
+		node *path[max_height];
+		bool found;
+		node *r = root;
+		int d;
+		try
+		{
+			d = copy_path(r, key, path, found);
+			if (!found)
+				prepare_insert_rebalance(path, d);
+		}
+		catch (...)
+		{
+			delete z;
+			abandon(r, root);
+			throw;
+		}
+		if (found)
+		{
+			replace_node(path, d, r, z);
+			return r;
+		}
+		node *p = path[d - 1];
+		if (comp(key, p->data.first))
+			p->left = z;
+		else
+			p->right = z;
+		path[d++] = z;
+		insert_rebalance(path, d, r);
+		inserted = true;
+		return r;
+	}
+
+	// see insert_impl.
+	node* erase_impl(node* &root, const Key &key, bool &erased)
+	{
+		erased = false;
+		if (find(root, key) == NULL)
+			return root;
+		stamp = next_stamp();
+		node *path[max_height];
+		bool found;
+		node *r = root;
+		int d;
+		try
+		{
+			d = copy_path(r, key, path, found);
+			node *z = path[d - 1];
+			int zi = d - 1;
+			if (z->left != NULL && z->right != NULL)
+			{
+				// the successor takes the place of z; its value goes into a fresh copy of z.
+				node *y = make_fresh(z->right);
+				path[d++] = y;
+				while (y->left != NULL)
+				{
+					y = make_fresh(y->left);
+					path[d++] = y;
+				}
+			}
+			if (path[d - 1]->color == 1)
+				prepare_erase_rebalance(path, d);
+			if (zi != d - 1)
+				replace_node(path, zi + 1, r, new node(stamp, path[d - 1]->data));
+		}
+		catch (...)
+		{
+			abandon(r, root);
+			throw;
+		}
+		node *y = path[d - 1];
+		node *x = (y->left != NULL) ? y->left : y->right;
+		link_of(path, d - 1, r) = x;
+		int color = y->color;
+		delete y;
+		--d;
+		if (color == 1)
+			erase_rebalance(path, d, x, r);
+		else if (r != NULL && r->color == 0)
+			make_fresh(r)->color = 1;
+		erased = true;
+		return r;
+	}
+
+public:
+	/**
+	 * the version root with the element built from (key, args...) added,
+	 *   or root itself (no new reference) if key is already there.
+	 *   with assign, an existing element gets the new value instead.
+	 */
+	template<class... Args>
+	node* insert(node *root, bool assign, bool &inserted, const Key &key, Args&&... args)
+	{
+		reuse = false;
+		return insert_impl(root, assign, inserted, key, std::forward<Args>(args)...);
+	}
+
+	/**
+	 * the version root without key, or root itself (no new reference) if key is not there.
+	 */
+	node* erase(node *root, const Key &key, bool &erased)
+	{
+		reuse = false;
+		return erase_impl(root, key, erased);
+	}
+
+	/**
+	 * like insert, but the reference held through root is given up and
+	 *   root becomes the new version.
+	 */
+	template<class... Args>
+	bool insert_into(node* &root, bool assign, const Key &key, Args&&... args)
+	{
+		reuse = true;
+		bool inserted;
+		root = insert_impl(root, assign, inserted, key, std::forward<Args>(args)...);
+		return inserted;
+	}
+
+	/**
+	 * like erase, but the reference held through root is given up and
+	 *   root becomes the new version.
+	 */
+	bool erase_from(node* &root, const Key &key)
+	{
+		reuse = true;
+		bool erased;
+		root = erase_impl(root, key, erased);
+		return erased;
+	}
+};
+
+}
+
+#endif
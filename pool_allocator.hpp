@@ -0,0 +1,277 @@
+/**
+ * a slab / free-list allocator for node based containers
+ */
+#ifndef SJTU_POOL_ALLOCATOR_HPP
+#define SJTU_POOL_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace sjtu {
+
+template<class T, size_t ChunkSize> class pool_allocator;
+
+/**
+ * the pools behind a family of pool_allocators, one pool per slot size.
+ *   Every copy and every rebind of an allocator refers to the same arena,
+ *   so they all compare equal and memory given out by one may be handed
+ *   back to another of the same type.
+ */
+class pool_arena
+{
+	template<class T, size_t N> friend class pool_allocator;
+private:
+	struct slot
+	{
+		slot *next;
+	};
+	struct chunk
+	{
+		chunk *next;
+	};
+	struct pool
+	{
+		slot *free_list;
+		chunk *chunks;
+		char *cur;
+		char *last;
+		size_t free_count;
+		size_t size;
+		size_t align;
+		pool *next;
+	};
+
+	pool *pools;
+	size_t refs;
+
+	pool_arena() : pools(NULL), refs(1) {}
+	pool_arena(const pool_arena &) = delete;
+	pool_arena & operator=(const pool_arena &) = delete;
+	~pool_arena()
+	{
+		while (pools != NULL)
+		{
+			pool *next = pools->next;
+			chunk *c = pools->chunks;
+			while (c != NULL)
+			{
+				chunk *tmp = c->next;
+				operator delete(c);
+				c = tmp;
+			}
+			delete pools;
+			pools = next;
+		}
+	}
+
+	/**
+	 * the pool for slots of this size and alignment, made on first use.
+	 *   An arena rarely has more than two or three of them.
+	 */
+	pool* pool_for(size_t size, size_t align)
+	{
+		for (pool *q = pools; q != NULL; q = q->next)
+			if (q->size == size && q->align == align)
+				return q;
+		pool *q = new pool;
+		q->free_list = NULL;
+		q->chunks = NULL;
+		q->cur = q->last = NULL;
+		q->free_count = 0;
+		q->size = size;
+		q->align = align;
+		q->next = pools;
+		pools = q;
+		return q;
+	}
+
+	void retain()
+	{
+		++refs;
+	}
+	void release()
+	{
+		if (--refs == 0)
+			delete this;
+	}
+};
+
+/**
+ * pool_allocator hands out single objects from contiguous chunks and keeps
+ * every deallocated object on a free list so that it can be reused by the
+ * next allocation. Chunks are only given back when the last allocator
+ * sharing the arena goes away.
+ *
+ * Requests for more than one object fall through to operator new.
+ * Copies and rebinds share one arena; the arena is not thread-safe.
+ */
+template<class T, size_t ChunkSize = 64>
+class pool_allocator
+{
+	template<class U, size_t N> friend class pool_allocator;
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	typedef std::false_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+	typedef std::false_type is_always_equal;
+
+	template<class U>
+	struct rebind
+	{
+		typedef pool_allocator<U, ChunkSize> other;
+	};
+
+private:
+	typedef pool_arena::slot slot;
+	typedef pool_arena::chunk chunk;
+	typedef pool_arena::pool pool;
+
+	static const size_t slot_align = alignof(T) > alignof(slot*) ? alignof(T) : alignof(slot*);
+	static const size_t slot_size = ((sizeof(T) > sizeof(slot) ? sizeof(T) : sizeof(slot)) + slot_align - 1) / slot_align * slot_align;
+	static const size_t chunk_head = (sizeof(chunk) + slot_align - 1) / slot_align * slot_align;
+
+	pool_arena *a;
+	pool *p; // a's pool for slot_size, looked up once
+
+	void grow(size_t n)
+	{
+		// slots left in the current chunk go to the free list, so that
+		// everything handed out afterwards comes from the new chunk.
+		while (p->cur != p->last)
+		{
+			slot *s = reinterpret_cast<slot*>(p->cur);
+			s->next = p->free_list;
+			p->free_list = s;
+			++p->free_count;
+			p->cur += slot_size;
+		}
+		char *mem = static_cast<char*>(operator new(chunk_head + n * slot_size));
+		chunk *c = reinterpret_cast<chunk*>(mem);
+		c->next = p->chunks;
+		p->chunks = c;
+		p->cur = mem + chunk_head;
+		p->last = p->cur + n * slot_size;
+	}
+
+public:
+	pool_allocator() : a(new pool_arena)
+	{
+		try
+		{
+			p = a->pool_for(slot_size, slot_align);
+		}
+		catch (...)
+		{
+			a->release();
+			throw;
+		}
+	}
+	pool_allocator(const pool_allocator &other) noexcept : a(other.a), p(other.p)
+	{
+		a->retain();
+	}
+	/**
+	 * a rebound allocator shares the arena, and so compares equal to other;
+	 *   it serves objects of another size from a pool of its own.
+	 */
+	template<class U>
+	pool_allocator(const pool_allocator<U, ChunkSize> &other) : a(other.a), p(other.a->pool_for(slot_size, slot_align))
+	{
+		a->retain();
+	}
+	~pool_allocator()
+	{
+		a->release();
+	}
+	pool_allocator & operator=(const pool_allocator &other) noexcept
+	{
+		if (a == other.a)
+			return *this;
+		other.a->retain();
+		a->release();
+		a = other.a;
+		p = other.p;
+		return *this;
+	}
+
+	/**
+	 * copying a container should not make it share (and grow) the arena of the original.
+	 */
+	pool_allocator select_on_container_copy_construction() const
+	{
+		return pool_allocator();
+	}
+
+	T* allocate(size_t n)
+	{
+		if (n != 1)
+			return static_cast<T*>(operator new(n * sizeof(T)));
+		if (p->free_list != NULL)
+		{
+			slot *s = p->free_list;
+			p->free_list = s->next;
+			--p->free_count;
+			return reinterpret_cast<T*>(s);
+		}
+		if (p->cur == p->last)
+			grow(ChunkSize);
+		T *tmp = reinterpret_cast<T*>(p->cur);
+		p->cur += slot_size;
+		return tmp;
+	}
+
+	void deallocate(T *ptr, size_t n) noexcept
+	{
+		if (n != 1)
+		{
+			operator delete(ptr);
+			return;
+		}
+		slot *s = reinterpret_cast<slot*>(ptr);
+		s->next = p->free_list;
+		p->free_list = s;
+		++p->free_count;
+	}
+
+	/**
+	 * make sure that the next n single-object allocations
+	 *   are served without going to operator new.
+	 */
+	void reserve(size_t n)
+	{
+		size_t avail = capacity();
+		if (avail < n)
+			grow(n - avail);
+	}
+
+	/**
+	 * number of objects that can be handed out before the pool has to grow.
+	 */
+	size_t capacity() const
+	{
+		return p->free_count + static_cast<size_t>(p->last - p->cur) / slot_size;
+	}
+
+	template<class U>
+	bool operator==(const pool_allocator<U, ChunkSize> &rhs) const
+	{
+		return a == rhs.a;
+	}
+	template<class U>
+	bool operator!=(const pool_allocator<U, ChunkSize> &rhs) const
+	{
+		return !(*this == rhs);
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,410 @@
+/**
+ * a map split by key range into independently locked shards
+ */
+#ifndef SJTU_SHARDED_MAP_HPP
+#define SJTU_SHARDED_MAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * sharded_map spreads its elements over N sjtu::map trees, each behind a
+ *   mutex of its own, so that writers working on different shards do not
+ *   wait for each other.
+ *
+ * the shards are cut by N - 1 ascending bound keys given at construction:
+ *   shard i holds the keys k with bound[i - 1] <= k < bound[i]. Without
+ *   bounds every key goes to shard 0.
+ *
+ * size() is kept in an atomic counter and takes no lock. Ordered iteration
+ *   goes through a view, which locks every shard for its lifetime and
+ *   merges the shards by key.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>,
+	size_t N = 16
+> class sharded_map
+{
+	static_assert(N > 0, "sharded_map needs at least one shard");
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef map<Key, T, Compare> shard_type;
+
+private:
+	// every shard is a separate allocation, so the locks do not share a cache line.
+	struct shard
+	{
+		std::mutex lock;
+		shard_type tree;
+		explicit shard(const Compare &c) : lock(), tree(c) {}
+	};
+
+	Compare comp;
+	std::vector<Key> bounds;
+	shard *shards[N];
+	std::atomic<size_t> elements;
+
+	void init()
+	{
+		size_t i = 0;
+		try
+		{
+			for (; i < N; ++i)
+				shards[i] = new shard(comp);
+		}
+		catch (...)
+		{
+			while (i > 0)
+				delete shards[--i];
+			throw;
+		}
+	}
+
+public:
+	/**
+	 * the view of all elements in key order; every shard stays locked until it is destroyed.
+	 */
+	class view;
+	/**
+	 * a k-way merge over the shards of a view; a forward iterator.
+	 */
+	class const_iterator
+	{
+		friend class view;
+	private:
+		typedef typename shard_type::const_iterator shard_iterator;
+
+		shard_iterator cur[N];
+		shard_iterator last[N];
+		// a min-heap of the shards that are not exhausted, by the key at cur.
+		size_t heap[N];
+		size_t heap_size;
+		Compare comp;
+
+		bool less(size_t a, size_t b) const
+		{
+			return comp(cur[a]->first, cur[b]->first);
+		}
+
+		void sift_down(size_t i)
+		{
+			while (true)
+			{
+				size_t m = i, l = 2 * i + 1, r = 2 * i + 2;
+				if (l < heap_size && less(heap[l], heap[m]))
+					m = l;
+				if (r < heap_size && less(heap[r], heap[m]))
+					m = r;
+				if (m == i)
+					return;
+				size_t tmp = heap[i];
+				heap[i] = heap[m];
+				heap[m] = tmp;
+				i = m;
+			}
+		}
+
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef typename sharded_map::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		const_iterator() : heap_size(0), comp() {}
+
+		const value_type & operator*() const
+		{
+			if (heap_size == 0)
+				throw invalid_iterator();
+			return *cur[heap[0]];
+		}
+		const value_type * operator->() const noexcept
+		{
+			return &*cur[heap[0]];
+		}
+		const_iterator & operator++()
+		{
+			if (heap_size == 0)
+				throw invalid_iterator();
+			size_t s = heap[0];
+			++cur[s];
+			if (cur[s] == last[s])
+				heap[0] = heap[--heap_size];
+			sift_down(0);
+			return *this;
+		}
+		const_iterator operator++(int)
+		{
+			const_iterator tmp = *this;
+			++*this;
+			return tmp;
+		}
+		/**
+		 * two iterators of the same view are equal when they are both at the
+		 *   end, or both at the same element.
+		 */
+		bool operator==(const const_iterator &rhs) const
+		{
+			if (heap_size == 0 || rhs.heap_size == 0)
+				return heap_size == rhs.heap_size;
+			return cur[heap[0]] == rhs.cur[rhs.heap[0]];
+		}
+		bool operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+
+	class view
+	{
+		friend class sharded_map;
+	private:
+		const sharded_map *m;
+
+		explicit view(const sharded_map &owner) : m(&owner)
+		{
+			// always in shard order, so two views (or a view and clear()) cannot deadlock.
+			for (size_t i = 0; i < N; ++i)
+				m->shards[i]->lock.lock();
+		}
+
+	public:
+		view(view &&other) noexcept : m(other.m)
+		{
+			other.m = NULL;
+		}
+		view(const view &) = delete;
+		view & operator=(const view &) = delete;
+		view & operator=(view &&) = delete;
+		~view()
+		{
+			if (m == NULL)
+				return;
+			for (size_t i = N; i > 0; --i)
+				m->shards[i - 1]->lock.unlock();
+		}
+
+		const_iterator begin() const
+		{
+			const_iterator it;
+			it.comp = m->comp;
+			for (size_t i = 0; i < N; ++i)
+			{
+				it.cur[i] = m->shards[i]->tree.cbegin();
+				it.last[i] = m->shards[i]->tree.cend();
+				if (it.cur[i] != it.last[i])
+					it.heap[it.heap_size++] = i;
+			}
+			for (size_t i = it.heap_size / 2; i > 0; --i)
+				it.sift_down(i - 1);
+			return it;
+		}
+		const_iterator end() const
+		{
+			return const_iterator();
+		}
+		size_t size() const
+		{
+			size_t n = 0;
+			for (size_t i = 0; i < N; ++i)
+				n += m->shards[i]->tree.size();
+			return n;
+		}
+	};
+
+	sharded_map() : comp(), bounds(), elements(0)
+	{
+		init();
+	}
+	/**
+	 * cut the shards at the N - 1 keys in [first, last), which must be ascending.
+	 * Otherwise, an exception of type `runtime_error'
+	 */
+	template<class InputIt>
+	sharded_map(InputIt first, InputIt last, const Compare &c = Compare()) : comp(c), bounds(first, last), elements(0)
+	{
+		if (bounds.size() != N - 1)
+			throw runtime_error("sharded_map needs N - 1 bounds");
+		for (size_t i = 1; i < bounds.size(); ++i)
+			if (!comp(bounds[i - 1], bounds[i]))
+				throw runtime_error("sharded_map bounds must be ascending");
+		init();
+	}
+	sharded_map(const sharded_map &) = delete;
+	sharded_map & operator=(const sharded_map &) = delete;
+	/**
+	 * no other thread may still be using the map.
+	 */
+	~sharded_map()
+	{
+		for (size_t i = 0; i < N; ++i)
+			delete shards[i];
+	}
+
+	/**
+	 * the shard that holds key.
+	 */
+	size_t shard_of(const Key &key) const
+	{
+		size_t lo = 0, hi = bounds.size();
+		while (lo < hi)
+		{
+			size_t mid = lo + (hi - lo) / 2;
+			if (comp(key, bounds[mid]))
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		return lo;
+	}
+
+	/**
+	 * insert value unless its key is already there; true if it was inserted.
+	 */
+	bool insert(const value_type &value)
+	{
+		shard &s = *shards[shard_of(value.first)];
+		std::lock_guard<std::mutex> lock(s.lock);
+		if (!s.tree.insert(value).second)
+			return false;
+		elements.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/**
+	 * map key to obj, replacing the old value if any; true if key was not there.
+	 */
+	template<class M>
+	bool insert_or_assign(const Key &key, M &&obj)
+	{
+		shard &s = *shards[shard_of(key)];
+		std::lock_guard<std::mutex> lock(s.lock);
+		if (!s.tree.insert_or_assign(key, std::forward<M>(obj)).second)
+			return false;
+		elements.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/**
+	 * erase the element with key; the number of elements erased (0 or 1).
+	 */
+	size_t erase(const Key &key)
+	{
+		shard &s = *shards[shard_of(key)];
+		std::lock_guard<std::mutex> lock(s.lock);
+		size_t n = s.tree.erase(key);
+		if (n != 0)
+			elements.fetch_sub(n, std::memory_order_relaxed);
+		return n;
+	}
+
+	/**
+	 * a copy of the value mapped to key.
+	 * If no such element exists, an exception of type `index_out_of_bound'
+	 */
+	T at(const Key &key) const
+	{
+		shard &s = *shards[shard_of(key)];
+		std::lock_guard<std::mutex> lock(s.lock);
+		return s.tree.at(key);
+	}
+
+	/**
+	 * copy the value mapped to key into value; false (value untouched) if key is not there.
+	 */
+	bool find(const Key &key, T &value) const
+	{
+		shard &s = *shards[shard_of(key)];
+		std::lock_guard<std::mutex> lock(s.lock);
+		typename shard_type::const_iterator it = s.tree.find(key);
+		if (it == s.tree.cend())
+			return false;
+		value = it->second;
+		return true;
+	}
+
+	/**
+	 * call fn(value_type &) on the element with key, if there is one, with its
+	 *   shard locked. fn must not use this map.
+	 */
+	template<class F>
+	bool visit(const Key &key, F fn)
+	{
+		shard &s = *shards[shard_of(key)];
+		std::lock_guard<std::mutex> lock(s.lock);
+		typename shard_type::iterator it = s.tree.find(key);
+		if (it == s.tree.end())
+			return false;
+		fn(*it);
+		return true;
+	}
+
+	size_t count(const Key &key) const
+	{
+		shard &s = *shards[shard_of(key)];
+		std::lock_guard<std::mutex> lock(s.lock);
+		return s.tree.count(key);
+	}
+
+	bool contains(const Key &key) const
+	{
+		return count(key) != 0;
+	}
+
+	/**
+	 * the number of elements, without locking: with concurrent writers the
+	 *   result is only a recent value.
+	 */
+	size_t size() const
+	{
+		return elements.load(std::memory_order_relaxed);
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	/**
+	 * clear the shards one after another; not atomic with respect to other writers.
+	 */
+	void clear()
+	{
+		for (size_t i = 0; i < N; ++i)
+		{
+			std::lock_guard<std::mutex> lock(shards[i]->lock);
+			elements.fetch_sub(shards[i]->tree.size(), std::memory_order_relaxed);
+			shards[i]->tree.clear();
+		}
+	}
+
+	/**
+	 * lock every shard and return the ordered view of all elements.
+	 */
+	view lock_all() const
+	{
+		return view(*this);
+	}
+
+	const Compare & key_comp() const
+	{
+		return comp;
+	}
+};
+
+}
+
+#endif
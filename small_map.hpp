@@ -0,0 +1,747 @@
+/**
+ * a map that keeps its first few elements inside the object
+ */
+#ifndef SJTU_SMALL_MAP_HPP
+#define SJTU_SMALL_MAP_HPP
+
+#include <functional>
+#include <iterator>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "map.hpp"
+#include "key_rank.hpp"
+
+namespace sjtu {
+
+/**
+ * small_map has the interface of map. Up to N elements live in a sorted
+ *   array inside the object, so creating, filling and destroying a map of
+ *   at most N elements never touches the heap (the header of the map it
+ *   spills into is inline as well).
+ *
+ * the insert that would make it N + 1 elements moves them all into a map
+ *   and the small_map stays there, however small it gets again, until
+ *   clear(). A spilled small_map costs what the map does, plus the unused
+ *   inline slots.
+ *
+ * inline elements move on insert and erase, so those invalidate all
+ *   iterators and references while the map has not spilled, unlike map.
+ *
+ * they are kept as pair<Key, T>, so moving one moves its key. When that
+ *   move may throw, a shift could fail halfway; such elements are not kept
+ *   inline at all and the map starts out spilled.
+ */
+template<
+	class Key,
+	class T,
+	class Compare = std::less<Key>,
+	size_t N = 8,
+	class Allocator = std::allocator<pair<const Key, T> >
+> class small_map
+{
+	static_assert(N > 0, "small_map needs at least one inline slot");
+	friend class iterator;
+	friend class const_iterator;
+public:
+	typedef Key key_type;
+	typedef T mapped_type;
+	typedef pair<const Key, T> value_type;
+	typedef map<Key, T, Compare, Allocator> tree_type;
+
+private:
+	typedef pair<const Key, T> Value;
+	// what a slot holds; it is handed out as a Value (as_const_key).
+	typedef pair<Key, T> Stored;
+
+	static const bool inline_values = std::is_nothrow_move_constructible<Stored>::value;
+
+	tree_type tree; // also holds the comparator
+	typename std::aligned_storage<sizeof(Stored), alignof(Stored)>::type slots[N];
+	size_t count_; // inline elements; 0 once spilled
+	bool spilled;
+
+	const Compare & comp() const
+	{
+		return tree.comp();
+	}
+
+	Stored & stored(size_t i)
+	{
+		return *stored_slot(i);
+	}
+	Value & value(size_t i)
+	{
+		return as_const_key(stored(i));
+	}
+	const Value & value(size_t i) const
+	{
+		return *slot(i);
+	}
+	// the slot i, with or without an element, as the iterators see it.
+	Value * slot(size_t i)
+	{
+		return as_const_key(stored_slot(i));
+	}
+	const Value * slot(size_t i) const
+	{
+		return as_const_key(reinterpret_cast<const Stored*>(&slots[i]));
+	}
+	Stored * stored_slot(size_t i)
+	{
+		return reinterpret_cast<Stored*>(&slots[i]);
+	}
+
+	// build an element in the raw slot i.
+	template<class... Args>
+	void construct(size_t i, Args&&... args)
+	{
+		::new (static_cast<void*>(&slots[i])) Stored(std::forward<Args>(args)...);
+	}
+
+	// move the element in slot si into the raw slot di, leaving si raw.
+	void relocate(size_t di, size_t si) noexcept
+	{
+		construct(di, std::move(stored(si)));
+		stored(si).~Stored();
+	}
+
+	void destroy_inline()
+	{
+		for (size_t i = 0; i < count_; ++i)
+			stored(i).~Stored();
+		count_ = 0;
+	}
+
+	/**
+	 * the first inline element whose key is not less than key, count_ if
+	 *   there is none. Like a btree_map node: arithmetic keys are all counted
+	 *   by key_rank without a branch; otherwise binary search.
+	 */
+	size_t lower_bound_inline(const Key &key) const
+	{
+		return lower_bound_inline(key, std::is_arithmetic<Key>());
+	}
+	size_t lower_bound_inline(const Key &key, std::true_type) const
+	{
+		const char *first = reinterpret_cast<const char*>(&value(0).first);
+		return key_rank<Key, Compare, sizeof(Stored)>::count_less(first, count_, key, comp());
+	}
+	size_t lower_bound_inline(const Key &key, std::false_type) const
+	{
+		size_t lo = 0, hi = count_;
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			if (comp()(value(mid).first, key))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+	size_t upper_bound_inline(const Key &key) const
+	{
+		size_t lo = 0, hi = count_;
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			if (comp()(key, value(mid).first))
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		return lo;
+	}
+	// the inline index of key, or count_.
+	size_t find_inline(const Key &key) const
+	{
+		size_t i = lower_bound_inline(key);
+		if (i < count_ && comp()(key, value(i).first))
+			return count_;
+		return i;
+	}
+
+	/**
+	 * move the inline elements into the tree, in order, each at the end.
+	 *   Moving a key or a value cannot throw (inline_values), allocating a
+	 *   node can: then the elements moved so far are taken back out of
+	 *   their nodes into their slots, so the map is as it was.
+	 */
+	void spill()
+	{
+		size_t i = 0;
+		try
+		{
+			for (; i < count_; ++i)
+			{
+				Stored &s = stored(i);
+				tree.emplace_hint(tree.cend(), std::move(s.first), std::move(s.second));
+				s.~Stored();
+			}
+		}
+		catch (...)
+		{
+			// slots 0 .. i - 1 are raw, the tree holds their elements in order.
+			while (i > 0)
+			{
+				typename tree_type::const_iterator last = tree.cend();
+				--last;
+				typename tree_type::node_type nh = tree.extract(last);
+				construct(--i, std::move(nh.key()), std::move(nh.mapped()));
+			}
+			throw;
+		}
+		count_ = 0;
+		spilled = true;
+	}
+
+	/**
+	 * put a value built from args at inline index i, where it keeps the
+	 *   order; there must be a free slot. The shifts cannot throw, so if
+	 *   building the value does, they are undone and the map is as it was.
+	 */
+	template<class... Args>
+	void insert_inline(size_t i, Args&&... args)
+	{
+		for (size_t j = count_; j > i; --j)
+			relocate(j, j - 1);
+		try
+		{
+			construct(i, std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			for (size_t j = i; j < count_; ++j)
+				relocate(j, j + 1);
+			throw;
+		}
+		++count_;
+	}
+
+	void erase_inline(size_t i)
+	{
+		stored(i).~Stored();
+		for (size_t j = i + 1; j < count_; ++j)
+			relocate(j - 1, j);
+		--count_;
+	}
+
+	// take over the inline elements of other (which must not have spilled) and its tree.
+	void take(small_map &other)
+	{
+		tree = std::move(other.tree);
+		for (; count_ < other.count_; ++count_)
+			construct(count_, std::move(other.stored(count_)));
+		spilled = other.spilled;
+		other.destroy_inline();
+		other.spilled = !inline_values;
+	}
+
+public:
+	class const_iterator;
+	/**
+	 * an inline element (ptr) before the map spills, an element of the tree (it) after.
+	 */
+	class iterator {
+		friend class small_map;
+		friend class const_iterator;
+	private:
+		Value *ptr; // NULL once spilled
+		typename tree_type::iterator it;
+		const small_map *container;
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef typename small_map::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef value_type* pointer;
+		typedef value_type& reference;
+
+		iterator(Value *p = NULL, const small_map *c = NULL) : ptr(p), it(), container(c) {}
+		iterator(typename tree_type::iterator i, const small_map *c) : ptr(NULL), it(i), container(c) {}
+		iterator(const iterator &other) = default;
+		iterator & operator=(const iterator &rhs) = default;
+		iterator operator++(int)
+		{
+			iterator itr(*this);
+			++*this;
+			return itr;
+		}
+		iterator & operator++()
+		{
+			if (ptr == NULL)
+				++it;
+			else if (ptr == container->slot(container->count_))
+				throw invalid_iterator();
+			else
+				++ptr;
+			return *this;
+		}
+		iterator operator--(int)
+		{
+			iterator itr(*this);
+			--*this;
+			return itr;
+		}
+		iterator & operator--()
+		{
+			if (ptr == NULL)
+				--it;
+			else if (ptr == container->slot(0))
+				throw invalid_iterator();
+			else
+				--ptr;
+			return *this;
+		}
+		value_type & operator*() const
+		{
+			if (ptr == NULL)
+				return *it;
+			if (ptr == container->slot(container->count_))
+				throw invalid_iterator();
+			return *ptr;
+		}
+		value_type* operator->() const noexcept
+		{
+			return ptr != NULL ? ptr : &*it;
+		}
+		bool operator==(const iterator &rhs) const
+		{
+			return ptr == rhs.ptr && container == rhs.container && (ptr != NULL || it == rhs.it);
+		}
+		bool operator==(const const_iterator &rhs) const
+		{
+			return ptr == rhs.ptr && container == rhs.container && (ptr != NULL || it == rhs.it);
+		}
+		bool operator!=(const iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+		bool operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+	class const_iterator {
+		friend class small_map;
+		friend class iterator;
+	private:
+		const Value *ptr;
+		typename tree_type::const_iterator it;
+		const small_map *container;
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef typename small_map::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		const_iterator(const Value *p = NULL, const small_map *c = NULL) : ptr(p), it(), container(c) {}
+		const_iterator(typename tree_type::const_iterator i, const small_map *c) : ptr(NULL), it(i), container(c) {}
+		const_iterator(const const_iterator &other) = default;
+		const_iterator(const iterator &other) : ptr(other.ptr), it(other.it), container(other.container) {}
+		const_iterator & operator=(const const_iterator &rhs) = default;
+		const_iterator operator++(int)
+		{
+			const_iterator itr(*this);
+			++*this;
+			return itr;
+		}
+		const_iterator & operator++()
+		{
+			if (ptr == NULL)
+				++it;
+			else if (ptr == container->slot(container->count_))
+				throw invalid_iterator();
+			else
+				++ptr;
+			return *this;
+		}
+		const_iterator operator--(int)
+		{
+			const_iterator itr(*this);
+			--*this;
+			return itr;
+		}
+		const_iterator & operator--()
+		{
+			if (ptr == NULL)
+				--it;
+			else if (ptr == container->slot(0))
+				throw invalid_iterator();
+			else
+				--ptr;
+			return *this;
+		}
+		const value_type & operator*() const
+		{
+			if (ptr == NULL)
+				return *it;
+			if (ptr == container->slot(container->count_))
+				throw invalid_iterator();
+			return *ptr;
+		}
+		const value_type* operator->() const noexcept
+		{
+			return ptr != NULL ? ptr : &*it;
+		}
+		bool operator==(const iterator &rhs) const
+		{
+			return ptr == rhs.ptr && container == rhs.container && (ptr != NULL || it == rhs.it);
+		}
+		bool operator==(const const_iterator &rhs) const
+		{
+			return ptr == rhs.ptr && container == rhs.container && (ptr != NULL || it == rhs.it);
+		}
+		bool operator!=(const iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+		bool operator!=(const const_iterator &rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+
+	small_map() : tree(), count_(0), spilled(!inline_values) {}
+	explicit small_map(const Compare &c, const Allocator &a = Allocator())
+		: tree(c, a), count_(0), spilled(!inline_values) {}
+	explicit small_map(const Allocator &a) : tree(a), count_(0), spilled(!inline_values) {}
+	small_map(const small_map &other)
+		: tree(other.tree), count_(0), spilled(other.spilled)
+	{
+		try
+		{
+			for (; count_ < other.count_; ++count_)
+				construct(count_, other.value(count_));
+		}
+		catch (...)
+		{
+			destroy_inline();
+			throw;
+		}
+	}
+	small_map & operator=(const small_map &other)
+	{
+		if (this == &other)
+			return *this;
+		small_map tmp(other);
+		*this = std::move(tmp);
+		return *this;
+	}
+	/**
+	 * the inline elements are moved one by one, the tree is relinked;
+	 *   other is left empty.
+	 */
+	small_map(small_map &&other) noexcept(std::is_nothrow_move_constructible<tree_type>::value)
+		: tree(std::move(other.tree)), count_(0), spilled(other.spilled)
+	{
+		for (; count_ < other.count_; ++count_)
+			construct(count_, std::move(other.stored(count_)));
+		other.destroy_inline();
+		other.spilled = !inline_values;
+	}
+	small_map & operator=(small_map &&other) noexcept(std::is_nothrow_move_assignable<tree_type>::value)
+	{
+		if (this == &other)
+			return *this;
+		clear();
+		take(other);
+		return *this;
+	}
+	void swap(small_map &other) noexcept(std::is_nothrow_move_constructible<tree_type>::value
+		&& std::is_nothrow_move_assignable<tree_type>::value)
+	{
+		small_map tmp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(tmp);
+	}
+	~small_map()
+	{
+		destroy_inline();
+	}
+
+	/**
+	 * whether the elements have moved into the tree.
+	 */
+	bool is_spilled() const
+	{
+		return spilled;
+	}
+
+	/**
+	 * access specified element with bounds checking
+	 * Returns a reference to the mapped value of the element with key equivalent to key.
+	 * If no such element exists, an exception of type `index_out_of_bound'
+	 */
+	T & at(const Key &key)
+	{
+		if (spilled)
+			return tree.at(key);
+		size_t i = find_inline(key);
+		if (i == count_)
+			throw index_out_of_bound();
+		return value(i).second;
+	}
+	const T & at(const Key &key) const
+	{
+		if (spilled)
+			return tree.at(key);
+		size_t i = find_inline(key);
+		if (i == count_)
+			throw index_out_of_bound();
+		return value(i).second;
+	}
+	/**
+	 * access specified element
+	 * Returns a reference to the value that is mapped to a key equivalent to key,
+	 *   performing an insertion if such key does not already exist.
+	 */
+	T & operator[](const Key &key)
+	{
+		return try_emplace(key).first->second;
+	}
+	T & operator[](Key &&key)
+	{
+		return try_emplace(std::move(key)).first->second;
+	}
+
+	iterator begin()
+	{
+		return spilled ? iterator(tree.begin(), this) : iterator(slot(0), this);
+	}
+	const_iterator cbegin() const
+	{
+		return spilled ? const_iterator(tree.cbegin(), this) : const_iterator(slot(0), this);
+	}
+	iterator end()
+	{
+		return spilled ? iterator(tree.end(), this) : iterator(slot(count_), this);
+	}
+	const_iterator cend() const
+	{
+		return spilled ? const_iterator(tree.cend(), this) : const_iterator(slot(count_), this);
+	}
+	bool empty() const
+	{
+		return size() == 0;
+	}
+	size_t size() const
+	{
+		return spilled ? tree.size() : count_;
+	}
+	/**
+	 * clears the contents; the map keeps its elements inline again.
+	 */
+	void clear()
+	{
+		destroy_inline();
+		tree.clear();
+		spilled = !inline_values;
+	}
+
+	/**
+	 * insert an element.
+	 * return a pair, the first of the pair is
+	 *   the iterator to the new element (or the element that prevented the insertion),
+	 *   the second one is true if insert successfully, or false.
+	 */
+	pair<iterator, bool> insert(const value_type &value)
+	{
+		return try_emplace(value.first, value.second);
+	}
+	pair<iterator, bool> insert(value_type &&v)
+	{
+		if (!spilled)
+		{
+			size_t i = lower_bound_inline(v.first);
+			if (i < count_ && !comp()(v.first, value(i).first))
+				return pair<iterator, bool>(iterator(slot(i), this), false);
+			if (count_ < N)
+			{
+				insert_inline(i, std::move(v));
+				return pair<iterator, bool>(iterator(slot(i), this), true);
+			}
+			spill();
+		}
+		pair<typename tree_type::iterator, bool> r = tree.insert(std::move(v));
+		return pair<iterator, bool>(iterator(r.first, this), r.second);
+	}
+	template<class... Args>
+	pair<iterator, bool> emplace(Args&&... args)
+	{
+		Value tmp(std::forward<Args>(args)...);
+		return insert(std::move(tmp));
+	}
+	template<class... Args>
+	pair<iterator, bool> try_emplace(const Key &key, Args&&... args)
+	{
+		if (!spilled)
+		{
+			size_t i = lower_bound_inline(key);
+			if (i < count_ && !comp()(key, value(i).first))
+				return pair<iterator, bool>(iterator(slot(i), this), false);
+			if (count_ < N)
+			{
+				insert_inline(i, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+				return pair<iterator, bool>(iterator(slot(i), this), true);
+			}
+			spill();
+		}
+		pair<typename tree_type::iterator, bool> r = tree.try_emplace(key, std::forward<Args>(args)...);
+		return pair<iterator, bool>(iterator(r.first, this), r.second);
+	}
+	template<class... Args>
+	pair<iterator, bool> try_emplace(Key &&key, Args&&... args)
+	{
+		if (!spilled)
+		{
+			size_t i = lower_bound_inline(key);
+			if (i < count_ && !comp()(key, value(i).first))
+				return pair<iterator, bool>(iterator(slot(i), this), false);
+			if (count_ < N)
+			{
+				insert_inline(i, std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+				return pair<iterator, bool>(iterator(slot(i), this), true);
+			}
+			spill();
+		}
+		pair<typename tree_type::iterator, bool> r = tree.try_emplace(std::move(key), std::forward<Args>(args)...);
+		return pair<iterator, bool>(iterator(r.first, this), r.second);
+	}
+	template<class M>
+	pair<iterator, bool> insert_or_assign(const Key &key, M &&obj)
+	{
+		if (!spilled)
+		{
+			size_t i = lower_bound_inline(key);
+			if (i < count_ && !comp()(key, value(i).first))
+			{
+				value(i).second = std::forward<M>(obj);
+				return pair<iterator, bool>(iterator(slot(i), this), false);
+			}
+			if (count_ < N)
+			{
+				insert_inline(i, key, std::forward<M>(obj));
+				return pair<iterator, bool>(iterator(slot(i), this), true);
+			}
+			spill();
+		}
+		pair<typename tree_type::iterator, bool> r = tree.insert_or_assign(key, std::forward<M>(obj));
+		return pair<iterator, bool>(iterator(r.first, this), r.second);
+	}
+
+	/**
+	 * erase the element at pos and return the iterator to the one after it.
+	 *
+	 * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+	 */
+	iterator erase(iterator pos)
+	{
+		if (pos.container != this)
+			throw invalid_iterator();
+		if (pos.ptr == NULL)
+			return iterator(tree.erase(pos.it), this);
+		if (pos.ptr == slot(count_))
+			throw invalid_iterator();
+		size_t i = pos.ptr - slot(0);
+		erase_inline(i);
+		return iterator(slot(i), this);
+	}
+	/**
+	 * erase the element with key equivalent to key, if any.
+	 * return the number of elements removed (0 or 1).
+	 */
+	size_t erase(const Key &key)
+	{
+		if (spilled)
+			return tree.erase(key);
+		size_t i = find_inline(key);
+		if (i == count_)
+			return 0;
+		erase_inline(i);
+		return 1;
+	}
+
+	/**
+	 * Returns the number of elements with key
+	 *   that compares equivalent to the specified argument,
+	 *   which is either 1 or 0
+	 *     since this container does not allow duplicates.
+	 */
+	size_t count(const Key &key) const
+	{
+		if (spilled)
+			return tree.count(key);
+		return find_inline(key) != count_ ? 1 : 0;
+	}
+	bool contains(const Key &key) const
+	{
+		return count(key) != 0;
+	}
+	/**
+	 * Finds an element with key equivalent to key.
+	 *   If no such element is found, past-the-end (see end()) iterator is returned.
+	 */
+	iterator find(const Key &key)
+	{
+		if (spilled)
+			return iterator(tree.find(key), this);
+		return iterator(slot(find_inline(key)), this);
+	}
+	const_iterator find(const Key &key) const
+	{
+		if (spilled)
+			return const_iterator(tree.find(key), this);
+		return const_iterator(slot(find_inline(key)), this);
+	}
+	iterator lower_bound(const Key &key)
+	{
+		if (spilled)
+			return iterator(tree.lower_bound(key), this);
+		return iterator(slot(lower_bound_inline(key)), this);
+	}
+	const_iterator lower_bound(const Key &key) const
+	{
+		if (spilled)
+			return const_iterator(tree.lower_bound(key), this);
+		return const_iterator(slot(lower_bound_inline(key)), this);
+	}
+	iterator upper_bound(const Key &key)
+	{
+		if (spilled)
+			return iterator(tree.upper_bound(key), this);
+		return iterator(slot(upper_bound_inline(key)), this);
+	}
+	const_iterator upper_bound(const Key &key) const
+	{
+		if (spilled)
+			return const_iterator(tree.upper_bound(key), this);
+		return const_iterator(slot(upper_bound_inline(key)), this);
+	}
+
+	Compare key_comp() const
+	{
+		return tree.key_comp();
+	}
+	Allocator get_allocator() const
+	{
+		return tree.get_allocator();
+	}
+};
+
+template<class Key, class T, class Compare, size_t N, class Allocator>
+void swap(small_map<Key, T, Compare, N, Allocator> &lhs, small_map<Key, T, Compare, N, Allocator> &rhs)
+	noexcept(noexcept(lhs.swap(rhs)))
+{
+	lhs.swap(rhs);
+}
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+/**
+ * inserts into and erases from btree_maps whose key and mapped types throw
+ *   from their copy constructors at random, with and without a nothrow
+ *   move, and checks that a failed insert leaves the map as it was.
+ *   erase(iterator) must return the element after the erased one, also
+ *   for keys that cannot be copied at all.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include "check.hpp"
+#include "../btree_map.hpp"
+
+static int budget = -1; // copies left before one throws, -1 for never
+
+static void copied()
+{
+	if (budget >= 0 && budget-- == 0)
+		throw 7;
+}
+
+// a string key whose copy may throw; its move cannot.
+struct movable_key
+{
+	std::string s;
+	movable_key(int x) : s(std::to_string(x)) {}
+	movable_key(const movable_key &o) : s(o.s)
+	{
+		copied();
+	}
+	movable_key(movable_key &&o) noexcept : s(std::move(o.s)) {}
+	movable_key & operator=(const movable_key &) = default;
+	bool operator<(const movable_key &o) const
+	{
+		return s.size() != o.s.size() ? s.size() < o.s.size() : s < o.s;
+	}
+};
+
+// a key with no move constructor, so every move is a copy that may throw.
+struct copy_only_key
+{
+	std::string s;
+	copy_only_key(int x) : s(std::to_string(x)) {}
+	copy_only_key(const copy_only_key &o) : s(o.s)
+	{
+		copied();
+	}
+	copy_only_key & operator=(const copy_only_key &o)
+	{
+		s = o.s;
+		return *this;
+	}
+	bool operator<(const copy_only_key &o) const
+	{
+		return s.size() != o.s.size() ? s.size() < o.s.size() : s < o.s;
+	}
+};
+
+struct movable_value
+{
+	int v;
+	movable_value(int x = 0) : v(x) {}
+	movable_value(const movable_value &o) : v(o.v)
+	{
+		copied();
+	}
+	movable_value(movable_value &&o) noexcept : v(o.v) {}
+	movable_value & operator=(const movable_value &) = default;
+};
+
+struct copy_only_value
+{
+	int v;
+	copy_only_value(int x = 0) : v(x) {}
+	copy_only_value(const copy_only_value &o) : v(o.v)
+	{
+		copied();
+	}
+	copy_only_value & operator=(const copy_only_value &o)
+	{
+		v = o.v;
+		return *this;
+	}
+};
+
+template<class K, class V>
+static void run(int ops, int range)
+{
+	typedef sjtu::btree_map<K, V> map_type;
+	map_type m;
+	std::map<int, int> o;
+	for (int step = 0; step < ops; ++step)
+	{
+		int k = std::rand() % range;
+		int op = std::rand() % 5;
+		try
+		{
+			if (op < 2)
+			{
+				K key(k);
+				V value(step);
+				typename map_type::value_type v(key, value);
+				budget = std::rand() % 4;
+				bool inserted = m.insert(v).second;
+				budget = -1;
+				if (inserted)
+					o[k] = step;
+			}
+			else if (op == 2)
+			{
+				K key(k);
+				V value(step);
+				budget = std::rand() % 4;
+				bool inserted = m.try_emplace(key, value).second;
+				budget = -1;
+				if (inserted)
+					o[k] = step;
+			}
+			else if (op == 3)
+			{
+				CHECK(m.erase(K(k)) == o.erase(k));
+			}
+			else
+			{
+				typename map_type::iterator it = m.find(K(k));
+				if (it != m.end())
+				{
+					typename map_type::iterator next = m.erase(it);
+					std::map<int, int>::iterator onext = o.erase(o.find(k));
+					if (onext == o.end())
+						CHECK(next == m.end());
+					else
+						CHECK(next != m.end() && next->first.s == std::to_string(onext->first));
+				}
+			}
+		}
+		catch (int)
+		{
+		}
+		budget = -1;
+		m.check_invariants();
+		CHECK(m.size() == o.size());
+		if (step % 499 == 0)
+		{
+			std::map<int, int>::const_iterator ot = o.begin();
+			for (typename map_type::const_iterator it = m.cbegin(); it != m.cend(); ++it, ++ot)
+				CHECK(it->first.s == std::to_string(ot->first) && it->second.v == ot->second);
+			// a copy that fails halfway frees what it built.
+			budget = std::rand() % (2 * static_cast<int>(o.size()) + 1);
+			try
+			{
+				map_type c(m);
+				budget = -1;
+				c.check_invariants();
+				CHECK(c.size() == m.size());
+			}
+			catch (int)
+			{
+			}
+			budget = -1;
+		}
+	}
+}
+
+struct move_only_key
+{
+	std::unique_ptr<int> p;
+	move_only_key(int x) : p(new int(x)) {}
+	bool operator<(const move_only_key &o) const
+	{
+		return *p < *o.p;
+	}
+};
+
+// empty a map by erasing through the returned iterators, from every other element.
+static void erase_move_only(int n)
+{
+	sjtu::btree_map<move_only_key, int> m;
+	for (int i = 0; i < n; ++i)
+		m.try_emplace(move_only_key(i), i);
+	sjtu::btree_map<move_only_key, int>::iterator it = m.begin();
+	for (int i = 0; it != m.end(); ++i)
+	{
+		CHECK(*it->first.p == i && it->second == i);
+		it = m.erase(it);
+		m.check_invariants();
+		if (it != m.end())
+			++it;
+		++i;
+	}
+	CHECK(m.size() == static_cast<size_t>(n / 2));
+	int i = 1;
+	for (it = m.begin(); it != m.end(); i += 2)
+	{
+		CHECK(*it->first.p == i);
+		it = m.erase(it);
+	}
+	CHECK(m.empty() && i == 1 + 2 * (n / 2));
+}
+
+int main()
+{
+	std::srand(21);
+	run<movable_key, movable_value>(30000, 600);
+	run<copy_only_key, movable_value>(30000, 600);
+	run<movable_key, copy_only_value>(30000, 600);
+	run<copy_only_key, copy_only_value>(30000, 600);
+	erase_move_only(5000);
+	std::puts("btree_map_exception_test: ok");
+	return 0;
+}
@@ -0,0 +1,26 @@
+/**
+ * the check macro shared by the tests in this directory
+ *
+ * each test is one program that includes the headers from the parent
+ *   directory and exits with 0 when every check holds, e.g.
+ *     g++ -std=c++14 -O1 -I.. -fsanitize=address,undefined map_emplace_test.cpp && ./a.out
+ *   concurrent_map_stress_test.cpp is meant for -fsanitize=thread -pthread.
+ */
+#ifndef SJTU_TESTS_CHECK_HPP
+#define SJTU_TESTS_CHECK_HPP
+
+#include <cstdio>
+#include <cstdlib>
+
+// unlike assert, stays on under NDEBUG.
+#define CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			std::exit(1); \
+		} \
+	} while (0)
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * readers hammer a concurrent_map while writers insert, overwrite and
+ *   erase; meant to be built with -fsanitize=thread -pthread, where any
+ *   race or early reclamation shows up as a report.
+ *
+ * writer w owns the keys k with k % writers == w and mirrors them in a
+ *   std::map, so the final contents are known. Every value is "k:version",
+ *   so a reader can tell a torn or freed value from a good one.
+ *
+ * the values throw from their copy constructor when the writing thread
+ *   runs out of its budget; a write that throws must leave the map as it
+ *   was and leak nothing (LeakSanitizer, or the count of live values).
+ */
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "check.hpp"
+#include "../concurrent_map.hpp"
+
+static thread_local int budget = -1; // copies left before one throws, -1 for never
+static std::atomic<long> live(0);
+
+struct value
+{
+	std::string s;
+	value() : s()
+	{
+		++live;
+	}
+	explicit value(const std::string &x) : s(x)
+	{
+		++live;
+	}
+	value(const value &o) : s(o.s)
+	{
+		if (budget >= 0 && budget-- == 0)
+			throw 7;
+		++live;
+	}
+	value & operator=(const value &) = default;
+	~value()
+	{
+		--live;
+	}
+	bool operator==(const value &o) const
+	{
+		return s == o.s;
+	}
+};
+
+typedef sjtu::concurrent_map<int, value> map_type;
+
+static const int key_range = 512;
+static const int writer_ops = 20000;
+
+static value make_value(int key, int version)
+{
+	return value(std::to_string(key) + ":" + std::to_string(version));
+}
+
+static bool good_value(int key, const value &v)
+{
+	std::string prefix = std::to_string(key) + ":";
+	return v.s.compare(0, prefix.size(), prefix) == 0 && v.s.size() > prefix.size();
+}
+
+static void writer(map_type &m, int w, int writers, std::map<int, value> &mine)
+{
+	std::minstd_rand rng(1234 + w);
+	for (int step = 0; step < writer_ops; ++step)
+	{
+		int key = static_cast<int>(rng() % (key_range / writers)) * writers + w;
+		value v = make_value(key, step);
+		map_type::value_type kv(key, v);
+		bool fresh = mine.find(key) == mine.end();
+		int op = rng() % 4;
+		// one write in eight may fail: the copies a write makes are the new value and the copied path.
+		budget = rng() % 8 == 0 ? static_cast<int>(rng() % 8) : -1;
+		try
+		{
+			switch (op)
+			{
+			case 0:
+				CHECK(m.insert(kv) == fresh);
+				budget = -1;
+				if (fresh)
+					mine.insert(std::make_pair(key, v));
+				break;
+			case 1:
+				CHECK(m.insert_or_assign(key, v) == fresh);
+				budget = -1;
+				mine[key] = v;
+				break;
+			default:
+				CHECK(m.erase(key) == (fresh ? 0u : 1u));
+				budget = -1;
+				mine.erase(key);
+				break;
+			}
+		}
+		catch (int)
+		{
+			budget = -1;
+			value now;
+			CHECK(m.find(key, now) == !fresh);
+			if (!fresh)
+				CHECK(now == mine[key]);
+		}
+	}
+}
+
+static void reader(const map_type &m, int r, const std::atomic<bool> &done, std::atomic<long> &reads)
+{
+	std::minstd_rand rng(99 + r);
+	long n = 0;
+	while (!done.load())
+	{
+		int key = static_cast<int>(rng() % key_range);
+		value v;
+		switch (rng() % 5)
+		{
+		case 0:
+			if (m.find(key, v))
+				CHECK(good_value(key, v));
+			break;
+		case 1:
+			try
+			{
+				CHECK(good_value(key, m.at(key)));
+			}
+			catch (sjtu::index_out_of_bound &)
+			{
+			}
+			break;
+		case 2:
+			m.visit(key, [&](const map_type::value_type &x) { CHECK(x.first == key && good_value(key, x.second)); });
+			break;
+		case 3:
+			CHECK(m.count(key) <= 1);
+			m.contains(key);
+			break;
+		default:
+			if (rng() % 64 == 0)
+			{
+				// a snapshot stays whole and sorted while the writers go on.
+				sjtu::persistent_map<int, value> s = m.snapshot();
+				size_t count = 0;
+				int last = -1;
+				for (sjtu::persistent_map<int, value>::const_iterator it = s.cbegin(); it != s.cend(); ++it)
+				{
+					CHECK(it->first > last && good_value(it->first, it->second));
+					last = it->first;
+					++count;
+				}
+				CHECK(count == s.size());
+			}
+			break;
+		}
+		++n;
+	}
+	reads += n;
+}
+
+static long run(int readers, int writers)
+{
+	map_type m;
+	std::vector<std::map<int, value> > mine(writers);
+	std::atomic<bool> done(false);
+	std::atomic<long> reads(0);
+	std::vector<std::thread> rs, ws;
+	for (int r = 0; r < readers; ++r)
+		rs.push_back(std::thread(reader, std::cref(m), r, std::cref(done), std::ref(reads)));
+	for (int w = 0; w < writers; ++w)
+		ws.push_back(std::thread(writer, std::ref(m), w, writers, std::ref(mine[w])));
+	for (size_t i = 0; i < ws.size(); ++i)
+		ws[i].join();
+	done.store(true);
+	for (size_t i = 0; i < rs.size(); ++i)
+		rs[i].join();
+
+	size_t total = 0;
+	for (int w = 0; w < writers; ++w)
+	{
+		total += mine[w].size();
+		for (std::map<int, value>::const_iterator it = mine[w].begin(); it != mine[w].end(); ++it)
+			CHECK(m.at(it->first) == it->second);
+	}
+	CHECK(m.size() == total);
+	m.clear();
+	CHECK(m.empty() && m.count(0) == 0);
+	return reads.load();
+}
+
+int main(int argc, char **argv)
+{
+	int readers = argc > 1 ? std::atoi(argv[1]) : 4;
+	int writers = argc > 2 ? std::atoi(argv[2]) : 2;
+	long reads = run(readers, writers);
+	CHECK(live.load() == 0);
+	std::printf("concurrent_map_stress_test: ok (%d readers, %d writers, %ld reads)\n", readers, writers, reads);
+	return 0;
+}
@@ -0,0 +1,217 @@
+/**
+ * inserts into and erases from flat_maps, one element and batches at a
+ *   time, whose key and mapped types throw from their copy constructors at
+ *   random, with and without a nothrow move, and checks that a failed
+ *   operation leaves the map as it was.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+#include "check.hpp"
+#include "../flat_map.hpp"
+
+static int budget = -1; // copies left before one throws, -1 for never
+
+static void copied()
+{
+	if (budget >= 0 && budget-- == 0)
+		throw 7;
+}
+
+// a string key whose copy may throw; its move cannot.
+struct movable_key
+{
+	std::string s;
+	movable_key(int x) : s(std::to_string(x)) {}
+	movable_key(const movable_key &o) : s(o.s)
+	{
+		copied();
+	}
+	movable_key(movable_key &&o) noexcept : s(std::move(o.s)) {}
+	movable_key & operator=(const movable_key &) = default;
+	bool operator<(const movable_key &o) const
+	{
+		return s.size() != o.s.size() ? s.size() < o.s.size() : s < o.s;
+	}
+};
+
+// a key with no move constructor, so every move is a copy that may throw.
+struct copy_only_key
+{
+	std::string s;
+	copy_only_key(int x) : s(std::to_string(x)) {}
+	copy_only_key(const copy_only_key &o) : s(o.s)
+	{
+		copied();
+	}
+	copy_only_key & operator=(const copy_only_key &o)
+	{
+		s = o.s;
+		return *this;
+	}
+	bool operator<(const copy_only_key &o) const
+	{
+		return s.size() != o.s.size() ? s.size() < o.s.size() : s < o.s;
+	}
+};
+
+struct movable_value
+{
+	int v;
+	movable_value(int x = 0) : v(x) {}
+	movable_value(const movable_value &o) : v(o.v)
+	{
+		copied();
+	}
+	movable_value(movable_value &&o) noexcept : v(o.v) {}
+	movable_value & operator=(const movable_value &) = default;
+};
+
+struct copy_only_value
+{
+	int v;
+	copy_only_value(int x = 0) : v(x) {}
+	copy_only_value(const copy_only_value &o) : v(o.v)
+	{
+		copied();
+	}
+	copy_only_value & operator=(const copy_only_value &o)
+	{
+		v = o.v;
+		return *this;
+	}
+};
+
+template<class M>
+static void same(const M &m, const std::map<int, int> &o)
+{
+	CHECK(m.size() == o.size());
+	std::map<int, int>::const_iterator ot = o.begin();
+	for (typename M::const_iterator it = m.cbegin(); it != m.cend(); ++it, ++ot)
+		CHECK(it->first.s == std::to_string(ot->first) && it->second.v == ot->second);
+}
+
+template<class K, class V>
+static void run(int ops, int range)
+{
+	typedef sjtu::flat_map<K, V> map_type;
+	typedef typename map_type::value_type value_type;
+	map_type m;
+	std::map<int, int> o;
+	for (int step = 0; step < ops; ++step)
+	{
+		int k = std::rand() % range;
+		int op = std::rand() % 7;
+		std::map<int, int> before = o;
+		try
+		{
+			if (op < 2)
+			{
+				K key(k);
+				V value(step);
+				value_type v(key, value);
+				budget = std::rand() % 4;
+				bool inserted = m.insert(v).second;
+				budget = -1;
+				if (inserted)
+					o[k] = step;
+			}
+			else if (op == 2)
+			{
+				K key(k);
+				V value(step);
+				budget = std::rand() % 4;
+				bool inserted = m.try_emplace(key, value).second;
+				budget = -1;
+				if (inserted)
+					o[k] = step;
+			}
+			else if (op == 3)
+			{
+				budget = std::rand() % 8;
+				size_t erased = m.erase(K(k));
+				budget = -1;
+				CHECK(erased == o.erase(k));
+			}
+			else if (op == 4)
+			{
+				std::vector<value_type> batch;
+				for (int j = std::rand() % 12; j > 0; --j)
+				{
+					K key(std::rand() % range);
+					V value(step);
+					batch.push_back(value_type(key, value));
+				}
+				budget = std::rand() % (4 * static_cast<int>(batch.size()) + 1);
+				size_t inserted = m.insert_batch(batch.begin(), batch.end());
+				budget = -1;
+				size_t expected = 0;
+				for (size_t j = 0; j < batch.size(); ++j)
+					expected += o.insert(std::make_pair(std::stoi(batch[j].first.s), step)).second ? 1 : 0;
+				CHECK(inserted == expected);
+			}
+			else if (op == 5)
+			{
+				std::vector<K> batch;
+				for (int j = std::rand() % 12; j > 0; --j)
+					batch.push_back(K(std::rand() % range));
+				budget = std::rand() % 8;
+				size_t erased = m.erase_batch(batch.begin(), batch.end());
+				budget = -1;
+				size_t expected = 0;
+				for (size_t j = 0; j < batch.size(); ++j)
+					expected += o.erase(std::stoi(batch[j].s));
+				CHECK(erased == expected);
+			}
+			else if (m.size() > 1)
+			{
+				size_t a = std::rand() % m.size();
+				size_t b = a + std::rand() % (m.size() - a);
+				budget = std::rand() % 8;
+				m.erase(m.cbegin() + a, m.cbegin() + b);
+				budget = -1;
+				std::map<int, int>::iterator oa = o.begin(), ob;
+				std::advance(oa, a);
+				ob = oa;
+				std::advance(ob, b - a);
+				o.erase(oa, ob);
+			}
+		}
+		catch (int)
+		{
+			budget = -1;
+			CHECK(o == before);
+		}
+		budget = -1;
+		if (step % 97 == 0 || op >= 3)
+			same(m, o);
+		if (step % 499 == 0)
+		{
+			// a copy that fails halfway frees what it built.
+			budget = std::rand() % (2 * static_cast<int>(o.size()) + 1);
+			try
+			{
+				map_type c(m);
+				budget = -1;
+				same(c, o);
+			}
+			catch (int)
+			{
+			}
+			budget = -1;
+		}
+	}
+}
+
+int main()
+{
+	std::srand(24);
+	run<movable_key, movable_value>(20000, 400);
+	run<copy_only_key, movable_value>(20000, 400);
+	run<movable_key, copy_only_value>(20000, 400);
+	run<copy_only_key, copy_only_value>(20000, 400);
+	std::puts("flat_map_exception_test: ok");
+	return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * compares key_rank::count_less with a plain count for every n from 0 to
+ *   17 (empty, below, at and past one and two vectors, and the masked
+ *   tail) and for signed, unsigned and floating point keys of 4 and 8
+ *   bytes, including the extremes, unsigned values with the top bit set,
+ *   -0.0 and NaN, and search keys equal to each stored one and next to it.
+ *
+ * the keys past the n-th are set to values that would change the count,
+ *   so reading them shows up. On a CPU without AVX2 only the scalar loop
+ *   runs.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "check.hpp"
+#include "../key_rank.hpp"
+
+template<class Key>
+static size_t plain_count(const std::vector<Key> &keys, size_t n, const Key &key)
+{
+	size_t r = 0;
+	for (size_t i = 0; i < n; ++i)
+		r += (keys[i] < key) ? 1 : 0;
+	return r;
+}
+
+template<class Key>
+static void check_counts(const std::vector<Key> &pool, Key low, Key high)
+{
+	typedef sjtu::key_rank<Key, std::less<Key> > rank;
+	CHECK(rank::vectorized);
+	for (size_t n = 0; n <= 17; ++n)
+	{
+		for (int round = 0; round < 40; ++round)
+		{
+			// 8 more keys than counted: the lowest value, which every search key but one is greater than.
+			std::vector<Key> keys(n + 8, low);
+			for (size_t i = 0; i < n; ++i)
+				keys[i] = pool[std::rand() % pool.size()];
+			std::vector<Key> probes(pool);
+			for (size_t i = 0; i < n; ++i)
+				probes.push_back(keys[i]);
+			probes.push_back(low);
+			probes.push_back(high);
+			for (size_t i = 0; i < probes.size(); ++i)
+			{
+				const char *first = reinterpret_cast<const char*>(keys.data());
+				CHECK(rank::count_less(first, n, probes[i], std::less<Key>()) == plain_count(keys, n, probes[i]));
+			}
+		}
+	}
+	// keys lying between other data go through the scalar loop.
+	typedef sjtu::key_rank<Key, std::less<Key>, 2 * sizeof(Key)> strided;
+	CHECK(!strided::vectorized);
+	std::vector<Key> spread(34, high);
+	std::vector<Key> dense(17);
+	for (size_t i = 0; i < 17; ++i)
+		dense[i] = spread[2 * i] = pool[std::rand() % pool.size()];
+	for (size_t n = 0; n <= 17; ++n)
+		for (size_t i = 0; i < pool.size(); ++i)
+			CHECK(strided::count_less(reinterpret_cast<const char*>(spread.data()), n, pool[i], std::less<Key>()) == plain_count(dense, n, pool[i]));
+}
+
+template<class Key>
+static void integers()
+{
+	typedef std::numeric_limits<Key> lim;
+	std::vector<Key> pool;
+	pool.push_back(lim::min());
+	pool.push_back(static_cast<Key>(lim::min() + 1));
+	pool.push_back(lim::max());
+	pool.push_back(static_cast<Key>(lim::max() - 1));
+	pool.push_back(0);
+	pool.push_back(1);
+	pool.push_back(static_cast<Key>(-1)); // the largest value when unsigned
+	// around the top bit, where signed and unsigned order differ.
+	typedef typename std::make_unsigned<Key>::type bits;
+	bits top = static_cast<bits>(1) << (8 * sizeof(Key) - 1);
+	pool.push_back(static_cast<Key>(top));
+	pool.push_back(static_cast<Key>(top + 1));
+	pool.push_back(static_cast<Key>(top - 1));
+	for (int i = 0; i < 8; ++i)
+		pool.push_back(static_cast<Key>(std::rand() % 2000 - 1000));
+	check_counts<Key>(pool, lim::min(), lim::max());
+}
+
+template<class Key>
+static void floats()
+{
+	typedef std::numeric_limits<Key> lim;
+	std::vector<Key> pool;
+	pool.push_back(-lim::infinity());
+	pool.push_back(lim::infinity());
+	pool.push_back(lim::lowest());
+	pool.push_back(lim::max());
+	pool.push_back(lim::denorm_min());
+	pool.push_back(-lim::denorm_min());
+	pool.push_back(static_cast<Key>(0.0));
+	pool.push_back(static_cast<Key>(-0.0));
+	pool.push_back(lim::quiet_NaN()); // less than nothing, and nothing is less than it
+	for (int i = 0; i < 8; ++i)
+		pool.push_back(static_cast<Key>(std::rand() % 2000 - 1000) / 8);
+	check_counts<Key>(pool, -lim::infinity(), lim::infinity());
+}
+
+int main()
+{
+	std::srand(22);
+	integers<int32_t>();
+	integers<uint32_t>();
+	integers<int64_t>();
+	integers<uint64_t>();
+	floats<float>();
+	floats<double>();
+	std::puts("key_rank_test: ok");
+	return 0;
+}
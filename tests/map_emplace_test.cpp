@@ -0,0 +1,198 @@
+/**
+ * counts the constructions, copies and moves of keys and values made by
+ *   insert, emplace, try_emplace, insert_or_assign and operator[].
+ */
+#include <cstdio>
+#include <functional>
+#include <tuple>
+#include <utility>
+#include "check.hpp"
+#include "../map.hpp"
+
+struct counts
+{
+	int made, copies, moves, assigns;
+};
+static counts cnt;
+
+static void reset()
+{
+	cnt.made = cnt.copies = cnt.moves = cnt.assigns = 0;
+}
+
+/**
+ * an int that records what happens to it.
+ */
+struct counted
+{
+	int v;
+	counted() : v(0)
+	{
+		++cnt.made;
+	}
+	counted(int x) : v(x)
+	{
+		++cnt.made;
+	}
+	counted(const counted &o) : v(o.v)
+	{
+		++cnt.copies;
+	}
+	counted(counted &&o) noexcept : v(o.v)
+	{
+		o.v = -1;
+		++cnt.moves;
+	}
+	counted & operator=(const counted &o)
+	{
+		v = o.v;
+		++cnt.assigns;
+		return *this;
+	}
+	counted & operator=(counted &&o) noexcept
+	{
+		v = o.v;
+		o.v = -1;
+		++cnt.assigns;
+		return *this;
+	}
+	bool operator<(const counted &o) const
+	{
+		return v < o.v;
+	}
+};
+
+typedef sjtu::map<counted, counted> map_type;
+typedef map_type::value_type value_type;
+
+static void check(int made, int copies, int moves, int assigns)
+{
+	CHECK(cnt.made == made);
+	CHECK(cnt.copies == copies);
+	CHECK(cnt.moves == moves);
+	CHECK(cnt.assigns == assigns);
+}
+
+static void test_pair_forwards()
+{
+	counted a(1), b(2);
+	reset();
+	sjtu::pair<counted, counted> p(std::move(a), std::move(b));
+	check(0, 0, 2, 0);
+	reset();
+	sjtu::pair<counted, counted> q(p.first, p.second);
+	check(0, 2, 0, 0);
+	reset();
+	sjtu::pair<counted, counted> r(3, 4);
+	check(2, 0, 0, 0);
+	reset();
+	sjtu::pair<counted, counted> s(std::piecewise_construct, std::forward_as_tuple(5), std::forward_as_tuple());
+	check(2, 0, 0, 0);
+	CHECK(s.first.v == 5 && s.second.v == 0);
+}
+
+static void test_insert()
+{
+	map_type m;
+	value_type v(1, 10);
+	reset();
+	CHECK(m.insert(v).second);
+	check(0, 2, 0, 0);
+	// the key is const, so it is copied even from an rvalue; the value is moved.
+	value_type w(2, 20);
+	reset();
+	CHECK(m.insert(std::move(w)).second);
+	check(0, 1, 1, 0);
+	// a key that is already there builds nothing.
+	value_type x(2, 30);
+	reset();
+	CHECK(!m.insert(std::move(x)).second);
+	check(0, 0, 0, 0);
+	CHECK(x.second.v == 30);
+	CHECK(m.at(2).v == 20);
+}
+
+static void test_emplace()
+{
+	map_type m;
+	reset();
+	CHECK(m.emplace(1, 10).second);
+	check(2, 0, 0, 0);
+	counted k(2), t(20);
+	reset();
+	CHECK(m.emplace(std::move(k), std::move(t)).second);
+	check(0, 0, 2, 0);
+	reset();
+	CHECK(m.emplace(std::piecewise_construct, std::forward_as_tuple(3), std::forward_as_tuple(30)).second);
+	check(2, 0, 0, 0);
+	// emplace builds the node first and drops it when the key exists.
+	reset();
+	CHECK(!m.emplace(1, 11).second);
+	check(2, 0, 0, 0);
+	CHECK(m.at(1).v == 10 && m.at(2).v == 20 && m.at(3).v == 30);
+}
+
+static void test_try_emplace()
+{
+	map_type m;
+	counted k(1);
+	reset();
+	CHECK(m.try_emplace(k, 10).second);
+	check(1, 1, 0, 0);
+	counted k2(2);
+	reset();
+	CHECK(m.try_emplace(std::move(k2), 20).second);
+	check(1, 0, 1, 0);
+	// nothing is built, and the arguments are left alone, when the key exists.
+	counted k3(2), t(21);
+	reset();
+	CHECK(!m.try_emplace(std::move(k3), std::move(t)).second);
+	check(0, 0, 0, 0);
+	CHECK(k3.v == 2 && t.v == 21);
+	CHECK(m.at(2).v == 20);
+}
+
+static void test_insert_or_assign()
+{
+	map_type m;
+	counted k(1), t(10);
+	reset();
+	CHECK(m.insert_or_assign(k, std::move(t)).second);
+	check(0, 1, 1, 0);
+	counted u(11);
+	reset();
+	CHECK(!m.insert_or_assign(k, std::move(u)).second);
+	check(0, 0, 0, 1);
+	CHECK(m.at(1).v == 11);
+	counted k2(2);
+	reset();
+	CHECK(m.insert_or_assign(std::move(k2), 20).second);
+	check(1, 0, 1, 0);
+}
+
+static void test_subscript()
+{
+	map_type m;
+	counted k(1);
+	reset();
+	m[k].v = 10;
+	check(1, 1, 0, 0);
+	reset();
+	m[counted(2)].v = 20;
+	check(2, 0, 1, 0);
+	reset();
+	CHECK(m[k].v == 10);
+	check(0, 0, 0, 0);
+}
+
+int main()
+{
+	test_pair_forwards();
+	test_insert();
+	test_emplace();
+	test_try_emplace();
+	test_insert_or_assign();
+	test_subscript();
+	std::puts("map_emplace_test: ok");
+	return 0;
+}
@@ -0,0 +1,171 @@
+/**
+ * copies and clears maps of 50M nodes (or argv[1]) on a thread with a
+ *   64 KiB stack, to show that copy_tree() and clear() need no stack per
+ *   level. Build it with optimization and without sanitizers; it needs
+ *   about 4 GiB of memory at the default size.
+ *
+ * a red-black tree is too shallow to show that (one of 50M nodes is at
+ *   most 51 levels deep), so the same is done to trees relinked into a
+ *   single chain of a million nodes, hanging to the right and to the left:
+ *   a walk that recursed once per level would overflow the stack there.
+ */
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+#include "check.hpp"
+#include "../map.hpp"
+#include "../pool_allocator.hpp"
+
+typedef sjtu::map<int, int> plain_map;
+typedef sjtu::map<int, int, std::less<int>, sjtu::pool_allocator<sjtu::pair<const int, int> > > pool_map;
+
+static const size_t small_stack = 64 * 1024;
+static const int chain_length = 1 << 20;
+
+namespace sjtu {
+
+struct map_test_access
+{
+	/**
+	 * relink the nodes of m, in order, into one chain going down to the
+	 *   right (each node is the left child of the next one with to_left).
+	 *   The colors are left as they were, so the tree is no longer a
+	 *   red-black tree and must only be copied, walked or cleared.
+	 */
+	template<class Map>
+	static void make_chain(Map &m, bool to_left)
+	{
+		typedef typename Map::node node;
+		std::vector<node*> nodes;
+		for (node *x = m.header->left; x != m.header; )
+		{
+			nodes.push_back(x);
+			if (x->right != NULL)
+			{
+				x = x->right;
+				while (x->left != NULL)
+					x = x->left;
+			}
+			else
+			{
+				node *p = x->parent();
+				while (x == p->right)
+				{
+					x = p;
+					p = p->parent();
+				}
+				x = p;
+			}
+		}
+		CHECK(nodes.size() == m.size());
+		size_t n = nodes.size();
+		for (size_t i = 0; i < n; ++i)
+		{
+			node *prev = i > 0 ? nodes[i - 1] : NULL, *next = i + 1 < n ? nodes[i + 1] : NULL;
+			nodes[i]->left = to_left ? prev : NULL;
+			nodes[i]->right = to_left ? NULL : next;
+			nodes[i]->set_parent(to_left ? next : prev);
+		}
+		node *r = to_left ? nodes[n - 1] : nodes[0];
+		r->set_parent(m.header);
+		m.root = r;
+		m.header->set_parent(r);
+	}
+};
+
+}
+
+template<class F>
+static void *call(void *f)
+{
+	(*static_cast<F*>(f))();
+	return NULL;
+}
+
+/**
+ * run f on a new thread whose stack is small_stack bytes.
+ */
+template<class F>
+static void on_small_stack(F f)
+{
+	pthread_attr_t attr;
+	CHECK(pthread_attr_init(&attr) == 0);
+	CHECK(pthread_attr_setstacksize(&attr, small_stack) == 0);
+	pthread_t t;
+	CHECK(pthread_create(&t, &attr, call<F>, &f) == 0);
+	CHECK(pthread_join(t, NULL) == 0);
+	pthread_attr_destroy(&attr);
+}
+
+// keys inserted in increasing order, the workload that skews a tree the most.
+template<class Map>
+static void fill(Map &m, int n)
+{
+	for (int i = 0; i < n; ++i)
+		m.insert(m.cend(), typename Map::value_type(i, 2 * i));
+	CHECK(m.size() == static_cast<size_t>(n));
+}
+
+static void test_pool(int n)
+{
+	pool_map a;
+	a.reserve(n);
+	fill(a, n);
+	pool_map *b = NULL;
+	on_small_stack([&]() { b = new pool_map(a); });
+	CHECK(b->size() == a.size());
+	CHECK(b->check_invariants());
+	pool_map::const_iterator x = a.cbegin();
+	for (pool_map::const_iterator y = b->cbegin(); y != b->cend(); ++x, ++y)
+		CHECK(x->first == y->first && x->second == y->second && &*x != &*y);
+	CHECK(x == a.cend());
+	on_small_stack([&]() { a.clear(); });
+	CHECK(a.empty() && a.check_invariants());
+	fill(a, 1000);
+	CHECK(a.check_invariants());
+	on_small_stack([&]() { delete b; });
+}
+
+static void test_plain(int n)
+{
+	plain_map a;
+	fill(a, n);
+	CHECK(a.check_invariants());
+	on_small_stack([&]() { a.clear(); });
+	CHECK(a.empty() && a.begin() == a.end());
+	fill(a, 1000);
+	CHECK(a.check_invariants());
+}
+
+template<class Map>
+static void test_chain(bool to_left)
+{
+	Map a;
+	fill(a, chain_length);
+	sjtu::map_test_access::make_chain(a, to_left);
+	Map *b = NULL;
+	on_small_stack([&]() { b = new Map(a); });
+	CHECK(b->size() == a.size());
+	int i = 0;
+	for (typename Map::const_iterator y = b->cbegin(); y != b->cend(); ++y, ++i)
+		CHECK(y->first == i && y->second == 2 * i);
+	CHECK(i == chain_length);
+	on_small_stack([&]() { a.clear(); });
+	CHECK(a.empty() && a.begin() == a.end());
+	on_small_stack([&]() { delete b; });
+}
+
+int main(int argc, char **argv)
+{
+	int n = argc > 1 ? std::atoi(argv[1]) : 50000000;
+	test_pool(n);
+	test_plain(n);
+	test_chain<plain_map>(false);
+	test_chain<plain_map>(true);
+	test_chain<pool_map>(false);
+	test_chain<pool_map>(true);
+	std::printf("map_large_test: ok (%d nodes)\n", n);
+	return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * checks rank, select, distance and iterator +/- n of the order_statistic
+ *   policy against std::map under random inserts and erases.
+ */
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include "check.hpp"
+#include "../map.hpp"
+
+typedef sjtu::map<int, int, std::less<int>, std::allocator<sjtu::pair<const int, int> >, sjtu::order_statistic> os_map;
+typedef std::map<int, int> oracle;
+
+static int rnd(int n)
+{
+	return std::rand() % n;
+}
+
+static size_t oracle_rank(const oracle &o, int key)
+{
+	size_t r = 0;
+	for (oracle::const_iterator it = o.begin(); it != o.end() && it->first < key; ++it)
+		++r;
+	return r;
+}
+
+static void check_same(const os_map &m, const oracle &o, int range)
+{
+	CHECK(m.size() == o.size());
+	CHECK(m.check_invariants());
+	std::vector<int> keys;
+	for (oracle::const_iterator it = o.begin(); it != o.end(); ++it)
+		keys.push_back(it->first);
+	ptrdiff_t n = static_cast<ptrdiff_t>(keys.size());
+
+	for (ptrdiff_t i = 0; i < n; ++i)
+		CHECK(m.select(i)->first == keys[i]);
+	CHECK(m.select(n) == m.cend());
+	CHECK(m.select(n + 5) == m.cend());
+
+	for (int k = -1; k <= range; ++k)
+		CHECK(m.rank(k) == oracle_rank(o, k));
+
+	for (int t = 0; t < 50; ++t)
+	{
+		ptrdiff_t i = rnd(static_cast<int>(n) + 1), j = rnd(static_cast<int>(n) + 1);
+		os_map::const_iterator a = m.select(i), b = m.select(j);
+		CHECK(m.distance(a, b) == j - i);
+		CHECK(m.distance(b, a) == i - j);
+
+		// + and - stop at begin() and end().
+		ptrdiff_t d = rnd(2 * static_cast<int>(n) + 5) - static_cast<int>(n) - 2;
+		ptrdiff_t to = i + d;
+		to = to < 0 ? 0 : (to > n ? n : to);
+		CHECK((a + d) == m.select(to));
+		CHECK((a - (-d)) == m.select(to));
+	}
+}
+
+static void run(int ops, int range)
+{
+	os_map m;
+	oracle o;
+	for (int step = 0; step < ops; ++step)
+	{
+		int k = rnd(range);
+		switch (rnd(7))
+		{
+		case 0:
+		case 1:
+			CHECK(m.insert(os_map::value_type(k, step)).second == o.insert(std::make_pair(k, step)).second);
+			break;
+		case 2:
+			m.insert(m.select(m.rank(k)), os_map::value_type(k, step));
+			o.insert(std::make_pair(k, step));
+			break;
+		case 3:
+			CHECK(m.erase(k) == o.erase(k));
+			break;
+		case 4:
+			if (!o.empty())
+			{
+				// erase by position, chosen through select.
+				size_t i = rnd(static_cast<int>(o.size()));
+				os_map::iterator it = m.select(i);
+				oracle::iterator ot = o.begin();
+				std::advance(ot, i);
+				CHECK(it->first == ot->first);
+				m.erase(it);
+				o.erase(ot);
+			}
+			break;
+		case 5:
+			m[k] = step;
+			o[k] = step;
+			break;
+		default:
+			if (!o.empty() && rnd(8) == 0)
+			{
+				// erase a short range [select(i), select(j)).
+				size_t i = rnd(static_cast<int>(o.size()) + 1);
+				size_t j = std::min(o.size(), i + rnd(8));
+				m.erase(m.select(i), m.select(j));
+				oracle::iterator a = o.begin(), b = o.begin();
+				std::advance(a, i);
+				std::advance(b, j);
+				o.erase(a, b);
+			}
+			break;
+		}
+		if (step % 211 == 0)
+			check_same(m, o, range);
+	}
+	check_same(m, o, range);
+}
+
+int main()
+{
+	std::srand(12);
+	run(20000, 40);
+	run(20000, 400);
+	run(20000, 4000);
+	std::puts("map_order_statistic_test: ok");
+	return 0;
+}
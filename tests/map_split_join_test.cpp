@@ -0,0 +1,108 @@
+/**
+ * splits, joins and merges random maps and checks the red-black
+ *   invariants (check_invariants) and the contents after every step.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include "check.hpp"
+#include "../map.hpp"
+#include "../pool_allocator.hpp"
+
+static int rnd(int n)
+{
+	return std::rand() % n;
+}
+
+template<class Map>
+static void check_same(const Map &m, const std::map<int, int> &o)
+{
+	CHECK(m.check_invariants());
+	CHECK(m.size() == o.size());
+	typename Map::const_iterator it = m.cbegin();
+	for (std::map<int, int>::const_iterator ot = o.begin(); ot != o.end(); ++ot, ++it)
+		CHECK(it->first == ot->first && it->second == ot->second);
+	CHECK(it == m.cend());
+}
+
+template<class Map>
+static void fill(Map &m, std::map<int, int> &o, int n, int lo, int range)
+{
+	for (int i = 0; i < n; ++i)
+	{
+		int k = lo + rnd(range);
+		m.insert(typename Map::value_type(k, i));
+		o.insert(std::make_pair(k, i));
+	}
+}
+
+/**
+ * split at a random key, check both halves, and put them back together
+ *   with join(other) or join(left, pivot, right).
+ */
+template<class Map>
+static void split_and_join(Map &m, std::map<int, int> &o, int range)
+{
+	int key = rnd(range + 2) - 1;
+	Map r = m.split(key);
+	std::map<int, int> ol(o.begin(), o.lower_bound(key)), orr(o.lower_bound(key), o.end());
+	check_same(m, ol);
+	check_same(r, orr);
+	if (rnd(2) == 0 || r.empty())
+		m.join(r);
+	else
+	{
+		// take the smallest element of r out and use it as the pivot.
+		typename Map::value_type pivot = *r.cbegin();
+		r.erase(r.begin());
+		Map whole;
+		whole.join(m, pivot, r);
+		CHECK(m.empty() && r.empty());
+		m = std::move(whole);
+	}
+	check_same(m, o);
+}
+
+template<class Map>
+static void run(int rounds, int n, int range)
+{
+	for (int round = 0; round < rounds; ++round)
+	{
+		Map a, b;
+		std::map<int, int> oa, ob;
+		fill(a, oa, rnd(n + 1), 0, range);
+		check_same(a, oa);
+		for (int i = 0; i < 5; ++i)
+			split_and_join(a, oa, range);
+
+		// disjoint ranges are joined, overlapping ones merged.
+		int lo = rnd(2) == 0 ? range : rnd(range);
+		fill(b, ob, rnd(n + 1), lo, range);
+		a.merge(b);
+		for (std::map<int, int>::iterator it = ob.begin(); it != ob.end(); )
+		{
+			if (oa.insert(*it).second)
+				it = ob.erase(it);
+			else
+				++it;
+		}
+		check_same(a, oa);
+		check_same(b, ob);
+	}
+}
+
+typedef std::allocator<sjtu::pair<const int, int> > plain_alloc;
+typedef sjtu::pool_allocator<sjtu::pair<const int, int> > pool_alloc;
+
+int main()
+{
+	std::srand(14);
+	run<sjtu::map<int, int> >(300, 300, 1000);
+	run<sjtu::map<int, int, std::less<int>, plain_alloc, sjtu::order_statistic> >(300, 300, 1000);
+	run<sjtu::map<int, int, std::less<int>, pool_alloc> >(100, 300, 1000);
+	run<sjtu::map<int, int> >(10, 20000, 100000);
+	std::puts("map_split_join_test: ok");
+	return 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * inserts into, assigns in and erases from a persistent_map whose mapped
+ *   type throws from its copy constructor at random, with and without live
+ *   snapshots, and checks that a failed write leaves the map and every
+ *   snapshot as they were, and frees what it built.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include "check.hpp"
+#include "../persistent_map.hpp"
+
+static int budget = -1; // copies left before one throws, -1 for never
+static int live = 0; // values alive, so a leak shows up without LeakSanitizer too
+
+static void copied()
+{
+	if (budget >= 0 && budget-- == 0)
+		throw 7;
+}
+
+struct value
+{
+	int v;
+	value(int x = 0) : v(x)
+	{
+		++live;
+	}
+	value(const value &o) : v(o.v)
+	{
+		copied();
+		++live;
+	}
+	value & operator=(const value &) = default;
+	~value()
+	{
+		--live;
+	}
+};
+
+typedef sjtu::persistent_map<int, value> map_type;
+
+static void check_same(const map_type &m, const std::map<int, int> &o)
+{
+	CHECK(m.size() == o.size());
+	std::map<int, int>::const_iterator ot = o.begin();
+	for (map_type::const_iterator it = m.cbegin(); it != m.cend(); ++it, ++ot)
+		CHECK(ot != o.end() && it->first == ot->first && it->second.v == ot->second);
+	CHECK(ot == o.end());
+}
+
+static void run(int ops, int range)
+{
+	map_type m;
+	std::map<int, int> o;
+	// snapshots taken along the way, with what they held then.
+	std::vector<map_type> shots;
+	std::vector<std::map<int, int> > shot_contents;
+	for (int step = 0; step < ops; ++step)
+	{
+		int k = std::rand() % range;
+		int op = std::rand() % 5;
+		try
+		{
+			if (op < 2)
+			{
+				map_type::value_type v(k, value(step));
+				budget = std::rand() % 8;
+				bool inserted = m.insert(v);
+				budget = -1;
+				CHECK(inserted == (o.count(k) == 0));
+				if (inserted)
+					o[k] = step;
+			}
+			else if (op == 2)
+			{
+				value v(step);
+				budget = std::rand() % 8;
+				bool inserted = m.insert_or_assign(k, v);
+				budget = -1;
+				CHECK(inserted == (o.count(k) == 0));
+				o[k] = step;
+			}
+			else
+			{
+				budget = std::rand() % 8;
+				size_t erased = m.erase(k);
+				budget = -1;
+				CHECK(erased == o.erase(k));
+			}
+		}
+		catch (int)
+		{
+		}
+		budget = -1;
+		check_same(m, o);
+		if (step % 37 == 0)
+		{
+			if (shots.size() < 3)
+			{
+				shots.push_back(m.snapshot());
+				shot_contents.push_back(o);
+			}
+			else
+			{
+				size_t i = std::rand() % shots.size();
+				check_same(shots[i], shot_contents[i]);
+				shots.erase(shots.begin() + i);
+				shot_contents.erase(shot_contents.begin() + i);
+			}
+		}
+	}
+	for (size_t i = 0; i < shots.size(); ++i)
+		check_same(shots[i], shot_contents[i]);
+}
+
+int main()
+{
+	std::srand(18);
+	run(30000, 16);
+	run(30000, 200);
+	CHECK(live == 0);
+	std::puts("persistent_map_exception_test: ok");
+	return 0;
+}
@@ -0,0 +1,250 @@
+/**
+ * inserts into and erases from small_maps, inline and spilled, whose key
+ *   and mapped types throw from their copy constructors at random, with
+ *   and without a nothrow move, and checks that a failed insert leaves the
+ *   map as it was. Spilling into the tree must move the elements, so that
+ *   it works for mapped types that cannot be copied, and must put them
+ *   back when a node cannot be allocated.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include "check.hpp"
+#include "../small_map.hpp"
+
+static int budget = -1; // copies left before one throws, -1 for never
+
+static void copied()
+{
+	if (budget >= 0 && budget-- == 0)
+		throw 7;
+}
+
+// a string key whose copy may throw; its move cannot.
+struct movable_key
+{
+	std::string s;
+	movable_key(int x) : s(std::to_string(x)) {}
+	movable_key(const movable_key &o) : s(o.s)
+	{
+		copied();
+	}
+	movable_key(movable_key &&o) noexcept : s(std::move(o.s)) {}
+	movable_key & operator=(const movable_key &) = default;
+	bool operator<(const movable_key &o) const
+	{
+		return s.size() != o.s.size() ? s.size() < o.s.size() : s < o.s;
+	}
+};
+
+// a key with no move constructor, so every move is a copy that may throw.
+struct copy_only_key
+{
+	std::string s;
+	copy_only_key(int x) : s(std::to_string(x)) {}
+	copy_only_key(const copy_only_key &o) : s(o.s)
+	{
+		copied();
+	}
+	copy_only_key & operator=(const copy_only_key &o)
+	{
+		s = o.s;
+		return *this;
+	}
+	bool operator<(const copy_only_key &o) const
+	{
+		return s.size() != o.s.size() ? s.size() < o.s.size() : s < o.s;
+	}
+};
+
+struct movable_value
+{
+	int v;
+	movable_value(int x = 0) : v(x) {}
+	movable_value(const movable_value &o) : v(o.v)
+	{
+		copied();
+	}
+	movable_value(movable_value &&o) noexcept : v(o.v) {}
+	movable_value & operator=(const movable_value &) = default;
+};
+
+struct copy_only_value
+{
+	int v;
+	copy_only_value(int x = 0) : v(x) {}
+	copy_only_value(const copy_only_value &o) : v(o.v)
+	{
+		copied();
+	}
+	copy_only_value & operator=(const copy_only_value &o)
+	{
+		v = o.v;
+		return *this;
+	}
+};
+
+template<class K, class V>
+static void run(int ops, int range)
+{
+	typedef sjtu::small_map<K, V, std::less<K>, 8> map_type;
+	map_type m;
+	std::map<int, int> o;
+	for (int step = 0; step < ops; ++step)
+	{
+		int k = std::rand() % range;
+		int op = std::rand() % 6;
+		try
+		{
+			if (op < 2)
+			{
+				K key(k);
+				V value(step);
+				typename map_type::value_type v(key, value);
+				budget = std::rand() % 4;
+				bool inserted = m.insert(v).second;
+				budget = -1;
+				if (inserted)
+					o[k] = step;
+			}
+			else if (op == 2)
+			{
+				K key(k);
+				V value(step);
+				budget = std::rand() % 4;
+				bool inserted = m.try_emplace(key, value).second;
+				budget = -1;
+				if (inserted)
+					o[k] = step;
+			}
+			else if (op == 3)
+			{
+				CHECK(m.erase(K(k)) == o.erase(k));
+			}
+			else if (op == 4)
+			{
+				typename map_type::iterator it = m.find(K(k));
+				if (it != m.end())
+				{
+					m.erase(it);
+					o.erase(k);
+				}
+			}
+			else if (std::rand() % 16 == 0)
+			{
+				// back to the inline slots.
+				m.clear();
+				o.clear();
+			}
+		}
+		catch (int)
+		{
+		}
+		budget = -1;
+		CHECK(m.size() == o.size());
+		std::map<int, int>::const_iterator ot = o.begin();
+		for (typename map_type::const_iterator it = m.cbegin(); it != m.cend(); ++it, ++ot)
+			CHECK(it->first.s == std::to_string(ot->first) && it->second.v == ot->second);
+		if (step % 97 == 0)
+		{
+			// a copy that fails halfway frees what it built.
+			budget = std::rand() % (2 * static_cast<int>(o.size()) + 1);
+			try
+			{
+				map_type c(m);
+				budget = -1;
+				CHECK(c.size() == m.size());
+			}
+			catch (int)
+			{
+			}
+			budget = -1;
+		}
+	}
+}
+
+static int allocations = -1; // nodes left to allocate before one fails, -1 for never
+
+template<class U>
+struct limited_allocator
+{
+	typedef U value_type;
+	limited_allocator() {}
+	template<class V>
+	limited_allocator(const limited_allocator<V> &) {}
+	U * allocate(size_t n)
+	{
+		if (allocations >= 0 && allocations-- == 0)
+			throw std::bad_alloc();
+		return std::allocator<U>().allocate(n);
+	}
+	void deallocate(U *p, size_t n)
+	{
+		std::allocator<U>().deallocate(p, n);
+	}
+	template<class V>
+	bool operator==(const limited_allocator<V> &) const
+	{
+		return true;
+	}
+	template<class V>
+	bool operator!=(const limited_allocator<V> &) const
+	{
+		return false;
+	}
+};
+
+struct move_only_key
+{
+	std::unique_ptr<int> p;
+	move_only_key(int x) : p(new int(x)) {}
+	bool operator<(const move_only_key &o) const
+	{
+		return *p < *o.p;
+	}
+};
+
+// fill the inline slots with move-only elements and spill, failing at every node in turn first.
+static void spill_move_only()
+{
+	typedef std::unique_ptr<int> ptr;
+	typedef sjtu::small_map<move_only_key, ptr, std::less<move_only_key>, 8, limited_allocator<sjtu::pair<const move_only_key, ptr> > > map_type;
+	for (int fail = 0; fail <= 9; ++fail)
+	{
+		map_type m;
+		for (int i = 0; i < 8; ++i)
+			CHECK(m.try_emplace(move_only_key(i), ptr(new int(i))).second);
+		// 8 nodes for the spilled elements, then the new one.
+		allocations = fail;
+		try
+		{
+			m.try_emplace(move_only_key(8), ptr(new int(8)));
+			allocations = -1;
+			CHECK(fail == 9 && m.size() == 9);
+		}
+		catch (std::bad_alloc &)
+		{
+			allocations = -1;
+			CHECK(fail < 9 && m.size() == 8);
+		}
+		int i = 0;
+		for (map_type::const_iterator it = m.cbegin(); it != m.cend(); ++it, ++i)
+			CHECK(*it->first.p == i && *it->second == i);
+		CHECK(i == static_cast<int>(m.size()));
+	}
+}
+
+int main()
+{
+	std::srand(25);
+	run<movable_key, movable_value>(20000, 12);
+	run<copy_only_key, movable_value>(20000, 12);
+	run<movable_key, copy_only_value>(20000, 12);
+	run<copy_only_key, copy_only_value>(20000, 12);
+	spill_move_only();
+	std::puts("small_map_exception_test: ok");
+	return 0;
+}
@@ -1,6 +1,9 @@
 #ifndef SJTU_UTILITY_HPP
 #define SJTU_UTILITY_HPP
 
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
 namespace sjtu {
@@ -15,13 +18,92 @@ namespace sjtu {
         pair(pair &&other) = default;
         pair(const T1 &x, const T2 &y) : first(x), second(y) {}
         template<class U1, class U2>
-        pair(U1 &&x, U2 &&y) : first(x), second(y) {}
+        pair(U1 &&x, U2 &&y) : first(std::forward<U1>(x)), second(std::forward<U2>(y)) {}
         template<class U1, class U2>
         pair(const pair<U1, U2> &other) : first(other.first), second(other.second) {}
         template<class U1, class U2>
-        pair(pair<U1, U2> &&other) : first(other.first), second(other.second) {}
+        pair(pair<U1, U2> &&other) : first(std::forward<U1>(other.first)), second(std::forward<U2>(other.second)) {}
+        // build both members in place from the two argument tuples, like std::pair.
+        template<class... Args1, class... Args2>
+        pair(std::piecewise_construct_t, std::tuple<Args1...> a, std::tuple<Args2...> b)
+            : pair(a, b, std::index_sequence_for<Args1...>(), std::index_sequence_for<Args2...>()) {}
+    private:
+        template<class Tuple1, class Tuple2, std::size_t... I1, std::size_t... I2>
+        pair(Tuple1 &a, Tuple2 &b, std::index_sequence<I1...>, std::index_sequence<I2...>)
+            : first(std::get<I1>(std::move(a))...), second(std::get<I2>(std::move(b))...) {}
     };
     
+    /**
+     * btree_map, flat_map and small_map keep their elements as pair<Key, T>, so
+     *   that shifting one moves (or assigns) its key, and hand them out as the
+     *   pair<const Key, T> of their interface. These two are read through each
+     *   other's type, which relies on them having the same layout: their members
+     *   differ only in a const, and a const type has the size and alignment of
+     *   the plain one, so every ABI puts first and second at the same offsets.
+     *   That is checked below: size and alignment always, and the offsets
+     *   wherever offsetof is defined (standard layout, so not for a member
+     *   such as std::function).
+     */
+    template<class A, class B, bool = std::is_standard_layout<A>::value && std::is_standard_layout<B>::value>
+    struct same_member_offsets
+        : std::integral_constant<bool, offsetof(A, first) == offsetof(B, first) && offsetof(A, second) == offsetof(B, second)> {};
+    template<class A, class B>
+    struct same_member_offsets<A, B, false> : std::true_type {};
+    
+    template<class Key, class T>
+    struct same_pair_layout
+    {
+        typedef pair<Key, T> stored;
+        typedef pair<const Key, T> value;
+        static_assert(sizeof(stored) == sizeof(value) && alignof(stored) == alignof(value), "pair<Key, T> and pair<const Key, T> differ in size");
+        static_assert(std::is_standard_layout<stored>::value == std::is_standard_layout<value>::value, "pair<Key, T> and pair<const Key, T> differ in layout");
+        static_assert(same_member_offsets<stored, value>::value, "pair<Key, T> and pair<const Key, T> place their members differently");
+        static const bool checked = true;
+    };
+    
+    // the element p as handed out.
+    template<class Key, class T>
+    pair<const Key, T> & as_const_key(pair<Key, T> &p) noexcept
+    {
+        static_assert(same_pair_layout<Key, T>::checked, "");
+        return reinterpret_cast<pair<const Key, T>&>(p);
+    }
+    template<class Key, class T>
+    const pair<const Key, T> & as_const_key(const pair<Key, T> &p) noexcept
+    {
+        static_assert(same_pair_layout<Key, T>::checked, "");
+        return reinterpret_cast<const pair<const Key, T>&>(p);
+    }
+    // the same for a slot, which may not hold an element yet.
+    template<class Key, class T>
+    pair<const Key, T> * as_const_key(pair<Key, T> *p) noexcept
+    {
+        static_assert(same_pair_layout<Key, T>::checked, "");
+        return reinterpret_cast<pair<const Key, T>*>(p);
+    }
+    template<class Key, class T>
+    const pair<const Key, T> * as_const_key(const pair<Key, T> *p) noexcept
+    {
+        static_assert(same_pair_layout<Key, T>::checked, "");
+        return reinterpret_cast<const pair<const Key, T>*>(p);
+    }
+    // the element v as stored, so that it can be moved.
+    template<class Key, class T>
+    pair<Key, T> & as_mutable_key(pair<const Key, T> &v) noexcept
+    {
+        static_assert(same_pair_layout<Key, T>::checked, "");
+        return reinterpret_cast<pair<Key, T>&>(v);
+    }
+    
+    /**
+     * tag telling a container that the given range is already sorted and free of duplicates.
+     */
+    struct sorted_unique_t
+    {
+        explicit sorted_unique_t() = default;
+    };
+    constexpr sorted_unique_t sorted_unique{};
+    
 }
 
 #endif